@@ -0,0 +1,10 @@
+// mirrors VKHBindlessDescriptors, storage buffer blocks are declared per shader against binding 2.
+#extension GL_EXT_nonuniform_qualifier : require
+
+#define BINDLESS_SAMPLED_IMAGE_BINDING 0
+#define BINDLESS_SAMPLER_BINDING 1
+#define BINDLESS_STORAGE_BUFFER_BINDING 2
+#define BINDLESS_STORAGE_IMAGE_BINDING 3
+
+layout(set = 0, binding = BINDLESS_SAMPLED_IMAGE_BINDING) uniform texture2D bindless_textures[];
+layout(set = 0, binding = BINDLESS_SAMPLER_BINDING) uniform sampler bindless_samplers[];
@@ -0,0 +1,31 @@
+#version 460
+
+layout(location = 0) in vec2 in_uv;
+layout(location = 1) in float in_ao;
+layout(location = 2) flat in uint in_face;
+layout(location = 3) flat in uint in_block;
+
+layout(location = 0) out vec4 out_color;
+
+// flat colors per Block until there is a texture atlas.
+const vec3 BLOCK_COLORS[10] = vec3[](
+    vec3(0.0, 0.0, 0.0),
+    vec3(0.5, 0.5, 0.5),
+    vec3(0.45, 0.3, 0.2),
+    vec3(0.3, 0.6, 0.2),
+    vec3(0.85, 0.8, 0.55),
+    vec3(0.55, 0.5, 0.5),
+    vec3(0.2, 0.35, 0.8),
+    vec3(0.15, 0.15, 0.15),
+    vec3(0.4, 0.3, 0.15),
+    vec3(0.2, 0.45, 0.15));
+
+// +x, -x, +y, -y, +z, -z.
+const float FACE_SHADES[6] = float[](0.8, 0.8, 1.0, 0.5, 0.9, 0.9);
+
+void main()
+{
+    vec3 color = BLOCK_COLORS[min(in_block, 9u)];
+    float ao = mix(0.4, 1.0, in_ao);
+    out_color = vec4(color * FACE_SHADES[in_face] * ao, 1.0);
+}
@@ -0,0 +1,87 @@
+#version 460
+#extension GL_GOOGLE_include_directive : require
+
+#include "bindless.glsl"
+
+// ChunkQuad, see chunk_mesher.h for the bit layout.
+struct ChunkQuad {
+    uint geometry;
+    uint material;
+};
+
+layout(set = 0, binding = BINDLESS_STORAGE_BUFFER_BINDING, std430) readonly buffer ChunkQuads {
+    ChunkQuad quads[];
+} quad_buffers[];
+
+// ChunkDrawRecord, picked by the draw's first instance.
+struct ChunkDrawRecord {
+    ivec4 section_origin;
+    uint quads_index;
+    uint scale;
+};
+
+layout(set = 0, binding = BINDLESS_STORAGE_BUFFER_BINDING, std430) readonly buffer ChunkDrawRecords {
+    ChunkDrawRecord records[];
+} record_buffers[];
+
+// ChunkDrawConstants
+layout(push_constant) uniform PushConstants {
+    mat4 view_projection;
+    uint records_index;
+} pc;
+
+layout(location = 0) out vec2 out_uv;
+layout(location = 1) out float out_ao;
+layout(location = 2) flat out uint out_face;
+layout(location = 3) flat out uint out_block;
+
+// corners 0..3 run counter-clockwise around the positive face normal.
+const uvec2 CORNERS[4] = uvec2[](uvec2(0, 0), uvec2(1, 0), uvec2(1, 1), uvec2(0, 1));
+
+const uint POSITIVE_ORDER[6] = uint[](0, 1, 2, 0, 2, 3);
+const uint NEGATIVE_ORDER[6] = uint[](0, 2, 1, 0, 3, 2);
+const uint POSITIVE_FLIPPED_ORDER[6] = uint[](1, 2, 3, 1, 3, 0);
+const uint NEGATIVE_FLIPPED_ORDER[6] = uint[](1, 3, 2, 1, 0, 3);
+
+void main()
+{
+    ChunkDrawRecord record = record_buffers[pc.records_index].records[gl_InstanceIndex];
+    ChunkQuad quad = quad_buffers[nonuniformEXT(record.quads_index)].quads[gl_VertexIndex / 6];
+    uint vertex = gl_VertexIndex % 6;
+
+    uvec3 position = uvec3(quad.geometry & 15u, (quad.geometry >> 4) & 15u, (quad.geometry >> 8) & 15u);
+    uint face = (quad.geometry >> 12) & 7u;
+    uvec2 size = uvec2((quad.geometry >> 15) & 15u, (quad.geometry >> 19) & 15u) + 1u;
+    uint ao = (quad.geometry >> 23) & 255u;
+
+    uint axis = face / 2u;
+    bool positive = (face & 1u) == 0u;
+
+    // split along the brighter diagonal so occlusion interpolates without a visible seam.
+    uint ao0 = ao & 3u;
+    uint ao1 = (ao >> 2) & 3u;
+    uint ao2 = (ao >> 4) & 3u;
+    uint ao3 = (ao >> 6) & 3u;
+    bool flipped = ao0 + ao2 < ao1 + ao3;
+
+    uint corner;
+    if (positive)
+        corner = flipped ? POSITIVE_FLIPPED_ORDER[vertex] : POSITIVE_ORDER[vertex];
+    else
+        corner = flipped ? NEGATIVE_FLIPPED_ORDER[vertex] : NEGATIVE_ORDER[vertex];
+
+    uvec2 uv = CORNERS[corner] * size;
+
+    if (positive)
+        position[axis] += 1u;
+    position[(axis + 1u) % 3u] += uv.x;
+    position[(axis + 2u) % 3u] += uv.y;
+
+    vec3 world_position = vec3(record.section_origin.xyz + ivec3(position) * int(record.scale));
+    gl_Position = pc.view_projection * vec4(world_position, 1.0);
+
+    out_uv = vec2(uv * record.scale);
+    out_ao = float((ao >> (corner * 2u)) & 3u) / 3.0;
+    out_face = face;
+    out_block = quad.material & 0xffffu;
+}
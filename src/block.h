@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+
+// ids are dense, so per-block tables can be indexed by them directly.
+enum class Block : uint16_t {
+    Air,
+    Stone,
+    Dirt,
+    Grass,
+    Sand,
+    Gravel,
+    Water,
+    Bedrock,
+    Log,
+    Leaves,
+    Count,
+};
+
+#define BLOCK_COUNT static_cast<uint32_t>(Block::Count)
+
+// blocks that can not be seen through. the mesher still culls faces between any two non-air blocks.
+inline bool is_block_opaque(Block block)
+{
+    return block != Block::Air && block != Block::Water && block != Block::Leaves;
+}
@@ -0,0 +1,323 @@
+#include <algorithm>
+#include <cstring>
+
+#include "chunk.h"
+
+#define CHUNK_SECTION_INVALID_SLOT UINT16_MAX
+
+ChunkSection::ChunkSection()
+{
+    fill(Block::Air);
+}
+
+void ChunkSection::set(uint32_t x, uint32_t y, uint32_t z, Block block)
+{
+    if (m_bits == 0) {
+        if (m_palette[0] == block)
+            return;
+        repack(1);
+    }
+
+    auto index = get_block_index(x, y, z);
+    if (m_palette[read(index)] == block)
+        return;
+
+    // adding may widen the indices, so the old one is read afterwards.
+    auto slot = find_or_add(block);
+    auto old_slot = read(index);
+    write(index, slot);
+    m_counts[slot]++;
+
+    if (--m_counts[old_slot] == 0)
+        release(old_slot);
+}
+
+void ChunkSection::fill(Block block)
+{
+    m_bits = 0;
+    m_live_count = 1;
+    m_palette = { block };
+    m_counts = { CHUNK_SECTION_VOLUME };
+    m_free = {};
+    m_data = {};
+    m_lookup.reset();
+}
+
+void ChunkSection::assign(std::span<Block const, CHUNK_SECTION_VOLUME> blocks)
+{
+    std::array<uint16_t, BLOCK_COUNT> slots;
+    slots.fill(CHUNK_SECTION_INVALID_SLOT);
+
+    std::vector<Block> palette;
+    std::vector<uint16_t> counts;
+    for (auto block : blocks) {
+        auto& slot = slots[static_cast<uint32_t>(block)];
+        if (slot == CHUNK_SECTION_INVALID_SLOT) {
+            slot = palette.size();
+            palette.push_back(block);
+            counts.push_back(0);
+        }
+        counts[slot]++;
+    }
+
+    if (palette.size() == 1) {
+        fill(palette[0]);
+        return;
+    }
+
+    auto bits { 1u };
+    while ((1u << bits) < palette.size())
+        bits *= 2;
+
+    std::vector<uint64_t> data(CHUNK_SECTION_VOLUME * bits / 64);
+    for (auto i { 0u }; i < CHUNK_SECTION_VOLUME; i++) {
+        auto bit = i * bits;
+        data[bit >> 6] |= static_cast<uint64_t>(slots[static_cast<uint32_t>(blocks[i])]) << (bit & 63);
+    }
+
+    m_bits = bits;
+    m_live_count = palette.size();
+    m_palette = std::move(palette);
+    m_counts = std::move(counts);
+    m_free = {};
+    m_data = std::move(data);
+
+    rebuild_lookup();
+}
+
+size_t ChunkSection::get_memory_usage() const
+{
+    auto size = sizeof(ChunkSection);
+    size += m_palette.capacity() * sizeof(Block);
+    size += m_counts.capacity() * sizeof(uint16_t);
+    size += m_free.capacity() * sizeof(uint16_t);
+    size += m_data.capacity() * sizeof(uint64_t);
+    if (m_lookup)
+        size += BLOCK_COUNT * sizeof(uint16_t);
+    return size;
+}
+
+uint32_t ChunkSection::find_or_add(Block block)
+{
+    if (m_lookup) {
+        auto slot = m_lookup[static_cast<uint32_t>(block)];
+        if (slot != CHUNK_SECTION_INVALID_SLOT)
+            return slot;
+    } else {
+        // at most 16 entries, released ones hold Block::Count and never match.
+        auto it = std::find(m_palette.begin(), m_palette.end(), block);
+        if (it != m_palette.end())
+            return it - m_palette.begin();
+    }
+
+    uint32_t slot;
+    if (!m_free.empty()) {
+        slot = m_free.back();
+        m_free.pop_back();
+        m_palette[slot] = block;
+    } else {
+        // a full palette without free entries only holds live blocks, so it has to widen.
+        if (m_palette.size() == (1u << m_bits))
+            repack(m_bits * 2);
+
+        slot = m_palette.size();
+        m_palette.push_back(block);
+        m_counts.push_back(0);
+    }
+
+    if (m_lookup)
+        m_lookup[static_cast<uint32_t>(block)] = slot;
+
+    m_live_count++;
+    return slot;
+}
+
+void ChunkSection::release(uint32_t palette_index)
+{
+    if (m_lookup)
+        m_lookup[static_cast<uint32_t>(m_palette[palette_index])] = CHUNK_SECTION_INVALID_SLOT;
+
+    m_palette[palette_index] = Block::Count;
+    m_free.push_back(palette_index);
+    m_live_count--;
+
+    if (m_live_count == 1) {
+        repack(0);
+        return;
+    }
+
+    // shrinks only once the palette fits half the narrower width, so a palette hovering around a
+    // width boundary does not repack on every set.
+    auto narrower = m_bits / 2;
+    if (narrower > 0 && m_live_count <= (1u << narrower) / 2)
+        repack(narrower);
+}
+
+void ChunkSection::repack(uint32_t bits)
+{
+    std::vector<uint16_t> remap(m_palette.size(), CHUNK_SECTION_INVALID_SLOT);
+    std::vector<Block> palette;
+    std::vector<uint16_t> counts;
+    palette.reserve(m_live_count);
+    counts.reserve(m_live_count);
+
+    for (auto i { 0u }; i < m_palette.size(); i++) {
+        if (m_counts[i] == 0)
+            continue;
+
+        remap[i] = palette.size();
+        palette.push_back(m_palette[i]);
+        counts.push_back(m_counts[i]);
+    }
+
+    std::vector<uint64_t> data;
+    if (bits > 0) {
+        data.resize(CHUNK_SECTION_VOLUME * bits / 64);
+
+        // a uniform section has no indices yet, every block refers to entry 0.
+        if (m_bits > 0) {
+            for (auto i { 0u }; i < CHUNK_SECTION_VOLUME; i++) {
+                auto bit = i * bits;
+                data[bit >> 6] |= static_cast<uint64_t>(remap[read(i)]) << (bit & 63);
+            }
+        }
+    }
+
+    m_bits = bits;
+    m_palette = std::move(palette);
+    m_counts = std::move(counts);
+    m_free = {};
+    m_data = std::move(data);
+
+    rebuild_lookup();
+}
+
+void ChunkSection::rebuild_lookup()
+{
+    if (m_bits < CHUNK_SECTION_LOOKUP_BITS) {
+        m_lookup.reset();
+        return;
+    }
+
+    if (!m_lookup)
+        m_lookup = std::make_unique<uint16_t[]>(BLOCK_COUNT);
+
+    std::fill_n(m_lookup.get(), BLOCK_COUNT, CHUNK_SECTION_INVALID_SLOT);
+    for (auto i { 0u }; i < m_palette.size(); i++) {
+        if (m_counts[i] > 0)
+            m_lookup[static_cast<uint32_t>(m_palette[i])] = i;
+    }
+}
+
+void ChunkSection::serialize(std::vector<uint8_t>& out) const
+{
+    auto bits = static_cast<uint8_t>(m_bits);
+    auto palette_size = static_cast<uint16_t>(m_palette.size());
+
+    auto offset = out.size();
+    out.resize(offset + 1 + sizeof(uint16_t) + m_palette.size() * sizeof(Block) + m_data.size() * sizeof(uint64_t));
+
+    auto dst = out.data() + offset;
+    *dst++ = bits;
+    std::memcpy(dst, &palette_size, sizeof(palette_size));
+    dst += sizeof(palette_size);
+    std::memcpy(dst, m_palette.data(), m_palette.size() * sizeof(Block));
+    dst += m_palette.size() * sizeof(Block);
+    if (!m_data.empty())
+        std::memcpy(dst, m_data.data(), m_data.size() * sizeof(uint64_t));
+}
+
+bool ChunkSection::deserialize(uint8_t const*& data, uint8_t const* end)
+{
+    fill(Block::Air);
+
+    if (end - data < 3)
+        return false;
+
+    uint32_t bits = *data++;
+    uint16_t palette_size;
+    std::memcpy(&palette_size, data, sizeof(palette_size));
+    data += sizeof(palette_size);
+
+    auto valid_bits = bits == 0 || bits == 1 || bits == 2 || bits == 4 || bits == 8 || bits == 16;
+    if (!valid_bits || palette_size == 0 || palette_size > (1u << bits))
+        return false;
+
+    auto word_count = static_cast<size_t>(CHUNK_SECTION_VOLUME) * bits / 64;
+    auto size = palette_size * sizeof(Block) + word_count * sizeof(uint64_t);
+    if (static_cast<size_t>(end - data) < size)
+        return false;
+
+    std::vector<Block> palette(palette_size);
+    std::memcpy(palette.data(), data, palette_size * sizeof(Block));
+    data += palette_size * sizeof(Block);
+
+    // released entries are stored as Block::Count and must not be referenced.
+    for (auto block : palette) {
+        if (static_cast<uint32_t>(block) > BLOCK_COUNT)
+            return false;
+    }
+
+    if (bits == 0) {
+        if (palette[0] == Block::Count)
+            return false;
+        fill(palette[0]);
+        return true;
+    }
+
+    std::vector<uint64_t> words(word_count);
+    std::memcpy(words.data(), data, word_count * sizeof(uint64_t));
+    data += word_count * sizeof(uint64_t);
+
+    m_bits = bits;
+    m_palette = std::move(palette);
+    m_data = std::move(words);
+    m_counts.assign(m_palette.size(), 0);
+
+    // counts are not stored, every index is visited once to rebuild them.
+    for (auto i { 0u }; i < CHUNK_SECTION_VOLUME; i++) {
+        auto slot = read(i);
+        if (slot >= m_palette.size() || m_palette[slot] == Block::Count) {
+            fill(Block::Air);
+            return false;
+        }
+        m_counts[slot]++;
+    }
+
+    m_live_count = 0;
+    for (auto i { 0u }; i < m_palette.size(); i++) {
+        if (m_counts[i] > 0) {
+            m_live_count++;
+        } else {
+            m_palette[i] = Block::Count;
+            m_free.push_back(i);
+        }
+    }
+
+    rebuild_lookup();
+    return true;
+}
+
+size_t Chunk::get_memory_usage() const
+{
+    auto size = sizeof(Chunk) - sizeof(m_sections);
+    for (auto const& section : m_sections)
+        size += section.get_memory_usage();
+    return size;
+}
+
+void Chunk::serialize(std::vector<uint8_t>& out) const
+{
+    for (auto const& section : m_sections)
+        section.serialize(out);
+}
+
+bool Chunk::deserialize(uint8_t const* data, size_t size)
+{
+    auto end = data + size;
+    for (auto& section : m_sections) {
+        if (!section.deserialize(data, end))
+            return false;
+    }
+    return data == end;
+}
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <array>
+#include <compare>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include "block.h"
+#include "helper.h"
+
+#define CHUNK_SECTION_SIZE 16
+#define CHUNK_SECTION_VOLUME (CHUNK_SECTION_SIZE * CHUNK_SECTION_SIZE * CHUNK_SECTION_SIZE)
+#define CHUNK_SECTION_COUNT 16
+#define CHUNK_HEIGHT (CHUNK_SECTION_SIZE * CHUNK_SECTION_COUNT)
+
+// the most ChunkSection::serialize() and Chunk::serialize() can write: bits, palette size, the widest
+// palette and 16 bit indices. sizes read from disk are rejected above it before anything is allocated.
+#define CHUNK_SECTION_MAX_SERIALIZED_SIZE (1 + sizeof(uint16_t) + UINT16_MAX * sizeof(Block) + CHUNK_SECTION_VOLUME * 16 / 8)
+#define CHUNK_MAX_SERIALIZED_SIZE (CHUNK_SECTION_COUNT * CHUNK_SECTION_MAX_SERIALIZED_SIZE)
+
+// palettes at least this wide keep a block -> palette index table, narrower ones are scanned.
+#define CHUNK_SECTION_LOOKUP_BITS 8
+
+// a 16x16x16 cube of blocks stored as a palette of the distinct blocks it holds plus one packed
+// palette index per block. index widths are powers of two so an index never straddles two words,
+// and a section holding a single block (all air, all stone) stores no indices at all.
+// not synchronized, readers and writers of one section must be serialized by the caller.
+class ChunkSection {
+public:
+    ChunkSection();
+
+    Block get(uint32_t x, uint32_t y, uint32_t z) const
+    {
+        if (m_bits == 0)
+            return m_palette[0];
+        return m_palette[read(get_block_index(x, y, z))];
+    }
+
+    void set(uint32_t x, uint32_t y, uint32_t z, Block block);
+
+    void fill(Block block);
+
+    // replaces every block at once, indexed by get_block_index(). builds the palette and the packed
+    // indices directly instead of growing them set by set.
+    void assign(std::span<Block const, CHUNK_SECTION_VOLUME> blocks);
+
+    bool is_uniform() const { return m_bits == 0; }
+
+    // only meaningful for uniform sections.
+    Block get_uniform_block() const { return m_palette[0]; }
+
+    bool is_empty() const { return m_bits == 0 && m_palette[0] == Block::Air; }
+
+    uint32_t get_palette_size() const { return m_live_count; }
+
+    uint32_t get_bits_per_block() const { return m_bits; }
+
+    size_t get_memory_usage() const;
+
+    // appends the palette and the packed indices as they are in memory, byte order is the host's.
+    void serialize(std::vector<uint8_t>& out) const;
+
+    // consumes what serialize() wrote. false when the data is truncated or malformed, the section is air then.
+    bool deserialize(uint8_t const*& data, uint8_t const* end);
+
+    // y major, so a horizontal layer is contiguous.
+    static uint32_t get_block_index(uint32_t x, uint32_t y, uint32_t z)
+    {
+        return (y << 8) | (z << 4) | x;
+    }
+
+private:
+    uint32_t read(uint32_t index) const
+    {
+        auto bit = index * m_bits;
+        return (m_data[bit >> 6] >> (bit & 63)) & ((1ull << m_bits) - 1);
+    }
+
+    void write(uint32_t index, uint32_t value)
+    {
+        auto bit = index * m_bits;
+        auto mask = ((1ull << m_bits) - 1) << (bit & 63);
+        auto& word = m_data[bit >> 6];
+        word = (word & ~mask) | (static_cast<uint64_t>(value) << (bit & 63));
+    }
+
+    uint32_t find_or_add(Block block);
+
+    void release(uint32_t palette_index);
+
+    // drops unused palette entries and rewrites every index at the new width, 0 collapses to one block.
+    void repack(uint32_t bits);
+
+    void rebuild_lookup();
+
+private:
+    uint32_t m_bits {};
+    uint32_t m_live_count {};
+
+    // entries whose count dropped to zero hold Block::Count and are listed in m_free.
+    std::vector<Block> m_palette;
+    std::vector<uint16_t> m_counts;
+    std::vector<uint16_t> m_free;
+    std::vector<uint64_t> m_data;
+    std::unique_ptr<uint16_t[]> m_lookup;
+};
+
+struct ChunkPosition {
+    int32_t x;
+    int32_t z;
+
+    auto operator<=>(ChunkPosition const&) const = default;
+};
+
+struct ChunkPositionHash {
+    size_t operator()(ChunkPosition position) const
+    {
+        auto key = (static_cast<uint64_t>(static_cast<uint32_t>(position.x)) << 32) | static_cast<uint32_t>(position.z);
+        return std::hash<uint64_t>()(key);
+    }
+};
+
+// a column of sections, x and z are local to the chunk.
+class Chunk {
+    MAKE_NON_COPYABLE(Chunk);
+    MAKE_NON_MOVABLE(Chunk);
+
+public:
+    explicit Chunk(ChunkPosition position)
+        : m_position(position)
+    {
+    }
+
+    // y outside the column reads as air.
+    Block get(uint32_t x, int32_t y, uint32_t z) const
+    {
+        if (y < 0 || y >= CHUNK_HEIGHT)
+            return Block::Air;
+        return m_sections[y >> 4].get(x, y & 15, z);
+    }
+
+    // writes outside the column are dropped.
+    void set(uint32_t x, int32_t y, uint32_t z, Block block)
+    {
+        if (y < 0 || y >= CHUNK_HEIGHT)
+            return;
+        m_sections[y >> 4].set(x, y & 15, z, block);
+    }
+
+    ChunkSection& get_section(uint32_t index) { return m_sections[index]; }
+
+    ChunkSection const& get_section(uint32_t index) const { return m_sections[index]; }
+
+    ChunkPosition get_position() const { return m_position; }
+
+    size_t get_memory_usage() const;
+
+    void serialize(std::vector<uint8_t>& out) const;
+
+    bool deserialize(uint8_t const* data, size_t size);
+
+private:
+    ChunkPosition m_position;
+    std::array<ChunkSection, CHUNK_SECTION_COUNT> m_sections;
+};
@@ -0,0 +1,472 @@
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstring>
+
+#include <fmt/format.h>
+
+#include "chunk_mesher.h"
+
+// bit 0 and 17 of a column are the neighboring blocks, 1..16 the section itself.
+#define CHUNK_MESHER_INNER_MASK 0x1fffeu
+#define CHUNK_MESHER_PADDED_SIZE (CHUNK_SECTION_SIZE + 2)
+
+namespace {
+
+struct MeshScratch {
+    Block blocks[CHUNK_SECTION_VOLUME];
+
+    // occupancy[y + 1][z + 1] holds x + 1 in its bits, the section padded by one block on every side.
+    uint32_t occupancy[CHUNK_MESHER_PADDED_SIZE][CHUNK_MESHER_PADDED_SIZE];
+
+    // columns[axis][a][b] runs along axis, a and b are the u and v coordinates of its faces.
+    uint32_t columns[3][CHUNK_SECTION_SIZE][CHUNK_SECTION_SIZE];
+
+    // faces of one direction, split by block and depth. rows are v, bits are u.
+    uint16_t planes[BLOCK_COUNT][CHUNK_SECTION_SIZE][CHUNK_SECTION_SIZE];
+    uint16_t plane_depths[BLOCK_COUNT];
+
+    // faces of one direction without any occlusion, and the ambient occlusion of every face, [depth][v][u].
+    uint16_t unoccluded[CHUNK_SECTION_SIZE][CHUNK_SECTION_SIZE];
+    uint8_t ao[CHUNK_SECTION_SIZE][CHUNK_SECTION_SIZE][CHUNK_SECTION_SIZE];
+
+    std::vector<ChunkQuad> quads;
+};
+
+thread_local MeshScratch t_scratch;
+
+bool is_solid(Block block)
+{
+    return block != Block::Air;
+}
+
+bool is_solid_at(ChunkNeighborhood const& neighborhood, int32_t x, int32_t y, int32_t z)
+{
+    if (y < 0)
+        return true;
+    if (y >= CHUNK_HEIGHT)
+        return false;
+
+    auto side_x = x < 0 ? -1 : x >= CHUNK_SECTION_SIZE ? 1 : 0;
+    auto side_z = z < 0 ? -1 : z >= CHUNK_SECTION_SIZE ? 1 : 0;
+
+    Chunk const* chunks[3][3] = {
+        { neighborhood.neg_x_neg_z, neighborhood.neg_z, neighborhood.pos_x_neg_z },
+        { neighborhood.neg_x, neighborhood.center, neighborhood.pos_x },
+        { neighborhood.neg_x_pos_z, neighborhood.pos_z, neighborhood.pos_x_pos_z },
+    };
+
+    auto chunk = chunks[side_z + 1][side_x + 1];
+    if (!chunk)
+        return true;
+    return is_solid(chunk->get(x - side_x * CHUNK_SECTION_SIZE, y, z - side_z * CHUNK_SECTION_SIZE));
+}
+
+// coordinates are local to the section and may be one block outside of it.
+bool is_occupied(MeshScratch const& scratch, int32_t x, int32_t y, int32_t z)
+{
+    return (scratch.occupancy[y + 1][z + 1] >> (x + 1)) & 1;
+}
+
+bool is_occupied_on_axis(MeshScratch const& scratch, uint32_t axis, int32_t depth, int32_t u, int32_t v)
+{
+    int32_t position[3];
+    position[axis] = depth;
+    position[(axis + 1) % 3] = u;
+    position[(axis + 2) % 3] = v;
+    return is_occupied(scratch, position[0], position[1], position[2]);
+}
+
+// samples the layer in front of the face. a corner is darkened by the two blocks along its edges and
+// the one diagonal to it, and fully dark when both edges are covered.
+uint32_t get_face_ao(MeshScratch const& scratch, uint32_t axis, int32_t layer, int32_t u, int32_t v)
+{
+    static constexpr int32_t directions[4][2] = { { -1, -1 }, { 1, -1 }, { 1, 1 }, { -1, 1 } };
+
+    uint32_t ao {};
+    for (auto i { 0 }; i < 4; i++) {
+        auto du = directions[i][0];
+        auto dv = directions[i][1];
+
+        uint32_t side_u = is_occupied_on_axis(scratch, axis, layer, u + du, v);
+        uint32_t side_v = is_occupied_on_axis(scratch, axis, layer, u, v + dv);
+        uint32_t corner = is_occupied_on_axis(scratch, axis, layer, u + du, v + dv);
+
+        auto value = side_u && side_v ? 0 : 3 - (side_u + side_v + corner);
+        ao |= value << (i * 2);
+    }
+    return ao;
+}
+
+void emit_quad(
+    std::vector<ChunkQuad>& quads,
+    uint32_t face,
+    uint32_t depth,
+    uint32_t u,
+    uint32_t v,
+    uint32_t width,
+    uint32_t height,
+    uint32_t ao,
+    Block block)
+{
+    auto axis = face / 2;
+
+    uint32_t position[3];
+    position[axis] = depth;
+    position[(axis + 1) % 3] = u;
+    position[(axis + 2) % 3] = v;
+
+    ChunkQuad quad;
+    quad.geometry = position[0] | (position[1] << 4) | (position[2] << 8) | (face << 12)
+        | ((width - 1) << 15) | ((height - 1) << 19) | (ao << 23);
+    quad.material = static_cast<uint32_t>(block);
+    quads.push_back(quad);
+}
+
+bool has_uniform_ao(uint8_t const (&ao)[CHUNK_SECTION_SIZE], uint32_t u, uint32_t width, uint32_t value)
+{
+    for (auto i { u }; i < u + width; i++) {
+        if (ao[i] != value)
+            return false;
+    }
+    return true;
+}
+
+// merges runs along u first, then grows each run along v while the rows below hold the same run.
+// faces only merge with faces of the same occlusion, unoccluded ones stay on pure bitmask operations.
+void merge_plane(
+    std::vector<ChunkQuad>& quads,
+    MeshScratch const& scratch,
+    uint16_t (&rows)[CHUNK_SECTION_SIZE],
+    uint32_t face,
+    uint32_t depth,
+    Block block)
+{
+    auto const& unoccluded = scratch.unoccluded[depth];
+    auto const& ao = scratch.ao[depth];
+
+    for (auto v { 0u }; v < CHUNK_SECTION_SIZE; v++) {
+        uint32_t row = rows[v];
+        while (row) {
+            auto u = std::countr_zero(row);
+            uint32_t value = ao[v][u];
+            auto height { 1u };
+
+            uint32_t width;
+            uint32_t run;
+            if (value == CHUNK_QUAD_AO_UNOCCLUDED) {
+                width = std::countr_one((row & unoccluded[v]) >> u);
+                run = ((1u << width) - 1) << u;
+
+                while (v + height < CHUNK_SECTION_SIZE && (rows[v + height] & unoccluded[v + height] & run) == run) {
+                    rows[v + height] &= ~run;
+                    height++;
+                }
+            } else {
+                width = 1;
+                while (u + width < CHUNK_SECTION_SIZE && ((row >> (u + width)) & 1) && ao[v][u + width] == value)
+                    width++;
+                run = ((1u << width) - 1) << u;
+
+                while (v + height < CHUNK_SECTION_SIZE && (rows[v + height] & run) == run
+                    && has_uniform_ao(ao[v + height], u, width, value)) {
+                    rows[v + height] &= ~run;
+                    height++;
+                }
+            }
+
+            row &= ~run;
+            emit_quad(quads, face, depth, u, v, width, height, value, block);
+        }
+        rows[v] = 0;
+    }
+}
+
+void build_occupancy(MeshScratch& scratch, ChunkNeighborhood const& neighborhood, uint32_t section_index)
+{
+    auto const& section = neighborhood.center->get_section(section_index);
+    std::memset(scratch.occupancy, 0, sizeof(scratch.occupancy));
+
+    if (section.is_uniform()) {
+        std::fill_n(scratch.blocks, CHUNK_SECTION_VOLUME, section.get_uniform_block());
+        for (auto y { 0 }; y < CHUNK_SECTION_SIZE; y++) {
+            for (auto z { 0 }; z < CHUNK_SECTION_SIZE; z++)
+                scratch.occupancy[y + 1][z + 1] = CHUNK_MESHER_INNER_MASK;
+        }
+    } else {
+        for (auto y { 0u }; y < CHUNK_SECTION_SIZE; y++) {
+            for (auto z { 0u }; z < CHUNK_SECTION_SIZE; z++) {
+                for (auto x { 0u }; x < CHUNK_SECTION_SIZE; x++) {
+                    auto block = section.get(x, y, z);
+                    scratch.blocks[ChunkSection::get_block_index(x, y, z)] = block;
+                    if (is_solid(block))
+                        scratch.occupancy[y + 1][z + 1] |= 1u << (x + 1);
+                }
+            }
+        }
+    }
+
+    // the shell around the section, edges and corners included for ambient occlusion.
+    auto base_y = static_cast<int32_t>(section_index * CHUNK_SECTION_SIZE);
+    for (auto y { -1 }; y <= CHUNK_SECTION_SIZE; y++) {
+        for (auto z { -1 }; z <= CHUNK_SECTION_SIZE; z++) {
+            auto& row = scratch.occupancy[y + 1][z + 1];
+            auto inner_row = y >= 0 && y < CHUNK_SECTION_SIZE && z >= 0 && z < CHUNK_SECTION_SIZE;
+
+            for (auto x { -1 }; x <= CHUNK_SECTION_SIZE; x++) {
+                if (inner_row && x == 0)
+                    x = CHUNK_SECTION_SIZE;
+
+                if (is_solid_at(neighborhood, x, base_y + y, z))
+                    row |= 1u << (x + 1);
+            }
+        }
+    }
+}
+
+// the x columns are the occupancy rows themselves, the y and z columns are transposed out of them.
+void build_columns(MeshScratch& scratch)
+{
+    std::memset(scratch.columns, 0, sizeof(scratch.columns));
+
+    for (auto py { 0u }; py < CHUNK_MESHER_PADDED_SIZE; py++) {
+        for (auto pz { 0u }; pz < CHUNK_MESHER_PADDED_SIZE; pz++) {
+            auto inner_y = py >= 1 && py <= CHUNK_SECTION_SIZE;
+            auto inner_z = pz >= 1 && pz <= CHUNK_SECTION_SIZE;
+
+            uint32_t row = scratch.occupancy[py][pz];
+            if (inner_y && inner_z)
+                scratch.columns[0][py - 1][pz - 1] = row;
+
+            auto bits = (row & CHUNK_MESHER_INNER_MASK) >> 1;
+            while (bits) {
+                auto x = std::countr_zero(bits);
+                bits &= bits - 1;
+
+                if (inner_z)
+                    scratch.columns[1][pz - 1][x] |= 1u << py;
+                if (inner_y)
+                    scratch.columns[2][x][py - 1] |= 1u << pz;
+            }
+        }
+    }
+}
+
+// outside the grid counts as air on the sides, so the border faces hang down as skirts over the gaps
+// to neighbors of another level, and as solid below the world like full resolution sections.
+void build_lod_occupancy(MeshScratch& scratch, ChunkLodNeighborhood const& neighborhood)
+{
+    std::memcpy(scratch.blocks, neighborhood.center, sizeof(scratch.blocks));
+    std::memset(scratch.occupancy, 0, sizeof(scratch.occupancy));
+
+    for (auto y { 0u }; y < CHUNK_SECTION_SIZE; y++) {
+        for (auto z { 0u }; z < CHUNK_SECTION_SIZE; z++) {
+            auto& row = scratch.occupancy[y + 1][z + 1];
+            for (auto x { 0u }; x < CHUNK_SECTION_SIZE; x++) {
+                if (is_solid(scratch.blocks[ChunkSection::get_block_index(x, y, z)]))
+                    row |= 1u << (x + 1);
+            }
+        }
+    }
+
+    for (auto z { 0u }; z < CHUNK_SECTION_SIZE; z++) {
+        auto& below = scratch.occupancy[0][z + 1];
+        auto& above = scratch.occupancy[CHUNK_MESHER_PADDED_SIZE - 1][z + 1];
+        for (auto x { 0u }; x < CHUNK_SECTION_SIZE; x++) {
+            if (!neighborhood.below || is_solid(neighborhood.below[ChunkSection::get_block_index(x, CHUNK_SECTION_SIZE - 1, z)]))
+                below |= 1u << (x + 1);
+            if (neighborhood.above && is_solid(neighborhood.above[ChunkSection::get_block_index(x, 0, z)]))
+                above |= 1u << (x + 1);
+        }
+    }
+}
+
+uint32_t block_index_on_axis(uint32_t axis, uint32_t depth, uint32_t a, uint32_t b)
+{
+    switch (axis) {
+    case 0:
+        return ChunkSection::get_block_index(depth, a, b);
+    case 1:
+        return ChunkSection::get_block_index(b, depth, a);
+    default:
+        return ChunkSection::get_block_index(a, b, depth);
+    }
+}
+
+// culls and merges the faces of the blocks and occupancy in scratch.
+void mesh_scratch(MeshScratch& scratch, std::vector<ChunkQuad>& quads)
+{
+    build_columns(scratch);
+
+    for (auto face { 0u }; face < CHUNK_FACE_COUNT; face++) {
+        auto axis = face / 2;
+        auto positive = (face & 1) == 0;
+
+        std::memset(scratch.unoccluded, 0, sizeof(scratch.unoccluded));
+
+        // one shift and mask finds the visible faces of 16 blocks at once.
+        for (auto a { 0u }; a < CHUNK_SECTION_SIZE; a++) {
+            for (auto b { 0u }; b < CHUNK_SECTION_SIZE; b++) {
+                auto column = scratch.columns[axis][a][b];
+                auto faces = positive ? column & ~(column >> 1) : column & ~(column << 1);
+                faces = (faces & CHUNK_MESHER_INNER_MASK) >> 1;
+
+                while (faces) {
+                    auto depth = std::countr_zero(faces);
+                    faces &= faces - 1;
+
+                    auto layer = positive ? depth + 1 : depth - 1;
+                    auto ao = get_face_ao(scratch, axis, layer, a, b);
+                    scratch.ao[depth][b][a] = ao;
+                    if (ao == CHUNK_QUAD_AO_UNOCCLUDED)
+                        scratch.unoccluded[depth][b] |= 1u << a;
+
+                    auto block = scratch.blocks[block_index_on_axis(axis, depth, a, b)];
+                    auto block_index = static_cast<uint32_t>(block);
+                    scratch.planes[block_index][depth][b] |= 1u << a;
+                    scratch.plane_depths[block_index] |= 1u << depth;
+                }
+            }
+        }
+
+        for (auto block_index { 0u }; block_index < BLOCK_COUNT; block_index++) {
+            uint32_t depths = scratch.plane_depths[block_index];
+            scratch.plane_depths[block_index] = 0;
+
+            while (depths) {
+                auto depth = std::countr_zero(depths);
+                depths &= depths - 1;
+                merge_plane(quads, scratch, scratch.planes[block_index][depth], face, depth, static_cast<Block>(block_index));
+            }
+        }
+    }
+}
+
+}
+
+void mesh_chunk_section(ChunkNeighborhood const& neighborhood, uint32_t section_index, std::vector<ChunkQuad>& quads)
+{
+    auto const& section = neighborhood.center->get_section(section_index);
+    if (section.is_empty())
+        return;
+
+    build_occupancy(t_scratch, neighborhood, section_index);
+    mesh_scratch(t_scratch, quads);
+}
+
+void mesh_chunk_lod_section(ChunkLodNeighborhood const& neighborhood, std::vector<ChunkQuad>& quads)
+{
+    auto empty = std::all_of(neighborhood.center, neighborhood.center + CHUNK_SECTION_VOLUME, [](Block block) {
+        return !is_solid(block);
+    });
+    if (empty)
+        return;
+
+    build_lod_occupancy(t_scratch, neighborhood);
+    mesh_scratch(t_scratch, quads);
+}
+
+void ChunkMesher::init(ChunkMesherInfo const& info)
+{
+    m_allocator = info.allocator;
+    m_upload_service = info.upload_service;
+    m_bindless = info.bindless;
+    m_jobs = info.jobs;
+    m_defer_destroy = info.defer_destroy;
+}
+
+void ChunkMesher::mesh(std::span<ChunkMeshRequest const> requests, std::span<ChunkSectionMesh> meshes)
+{
+    mesh_batch(meshes, [&](uint32_t i, std::vector<ChunkQuad>& quads) {
+        auto const& request = requests[i];
+        mesh_chunk_section(request.neighborhood, request.section_index, quads);
+        return compute_section_visibility(request.neighborhood.center->get_section(request.section_index));
+    });
+}
+
+void ChunkMesher::mesh_lod(std::span<ChunkLodNeighborhood const> requests, std::span<ChunkSectionMesh> meshes)
+{
+    mesh_batch(meshes, [&](uint32_t i, std::vector<ChunkQuad>& quads) {
+        mesh_chunk_lod_section(requests[i], quads);
+        return static_cast<uint16_t>(SECTION_VISIBILITY_ALL);
+    });
+}
+
+void ChunkMesher::mesh_batch(std::span<ChunkSectionMesh> meshes, std::function<uint16_t(uint32_t, std::vector<ChunkQuad>&)> const& mesh_one)
+{
+    auto run = [&](uint32_t i) {
+        auto start = std::chrono::steady_clock::now();
+
+        // per worker, so steady state meshing does not allocate.
+        auto& quads = t_scratch.quads;
+        quads.clear();
+        auto visibility = mesh_one(i, quads);
+
+        m_mesh_time_ns.fetch_add(std::chrono::nanoseconds(std::chrono::steady_clock::now() - start).count(), std::memory_order_relaxed);
+        m_section_count.fetch_add(1, std::memory_order_relaxed);
+        m_quad_count.fetch_add(quads.size(), std::memory_order_relaxed);
+
+        meshes[i] = upload(quads);
+        meshes[i].visibility = visibility;
+    };
+
+    // below frame-critical work, edits and streaming share the workers with recording.
+    m_jobs->parallel_for(meshes.size(), run, JobPriority::Normal);
+}
+
+void ChunkMesher::destroy(ChunkSectionMesh& mesh)
+{
+    if (mesh.status != ChunkMeshStatus::Uploaded)
+        return;
+
+    m_bindless->remove_storage_buffer(mesh.quads_index);
+    m_defer_destroy([allocator = m_allocator, buffer = mesh.quad_buffer]() mutable { allocator->destroy_buffer(buffer); });
+    mesh = {};
+}
+
+ChunkMesherStats ChunkMesher::get_stats() const
+{
+    ChunkMesherStats stats {};
+    stats.section_count = m_section_count.load(std::memory_order_relaxed);
+    stats.quad_count = m_quad_count.load(std::memory_order_relaxed);
+    stats.mesh_time_ns = m_mesh_time_ns.load(std::memory_order_relaxed);
+    return stats;
+}
+
+ChunkSectionMesh ChunkMesher::upload(std::vector<ChunkQuad> const& quads)
+{
+    ChunkSectionMesh mesh {};
+    if (quads.empty())
+        return mesh;
+
+    auto size = quads.size() * sizeof(ChunkQuad);
+    auto buffer = m_allocator->create_buffer(
+        size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VKHMemoryUsage::GPUOnly);
+
+    // taken before the upload, so a failure leaves nothing in flight and the buffer can go right away.
+    auto quads_index = m_bindless->add_storage_buffer(buffer.buffer, 0, size);
+    if (quads_index == VKH_BINDLESS_INVALID_INDEX) {
+        if (!m_descriptors_full.exchange(true, std::memory_order_relaxed))
+            fmt::println(stderr, "ChunkMesher::upload(): out of bindless storage buffer slots, sections are retried later!");
+        m_allocator->destroy_buffer(buffer);
+        mesh.status = ChunkMeshStatus::DescriptorsFull;
+        return mesh;
+    }
+    m_descriptors_full.store(false, std::memory_order_relaxed);
+
+    auto ticket = m_upload_service->upload_buffer(buffer.buffer, 0, quads.data(), size);
+    if (ticket == 0) {
+        // never submitted, so the buffer can go right away. the slot is released once no frame can read it.
+        m_bindless->remove_storage_buffer(quads_index);
+        m_allocator->destroy_buffer(buffer);
+        mesh.status = ChunkMeshStatus::StagingFull;
+        return mesh;
+    }
+
+    mesh.status = ChunkMeshStatus::Uploaded;
+    mesh.quad_buffer = buffer;
+    mesh.quad_count = quads.size();
+    mesh.quads_index = quads_index;
+    mesh.upload_ticket = ticket;
+    return mesh;
+}
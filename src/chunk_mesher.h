@@ -0,0 +1,172 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <vector>
+
+#include "chunk.h"
+#include "helper.h"
+#include "job_subsystem.h"
+#include "section_visibility.h"
+#include "upload_service.h"
+#include "vulkan.h"
+#include "vulkan_allocator.h"
+#include "vulkan_bindless.h"
+
+// one greedy quad, expanded into six vertices by shaders/chunk.vert.
+//   geometry: x, y, z of the quad's first block (4 bits each), face (3 bits), width - 1 and height - 1
+//             along the face's u and v axes (4 bits each), then the ambient occlusion of the four
+//             corners (2 bits each, 3 is unoccluded).
+//   material: block id in the low 16 bits.
+struct ChunkQuad {
+    uint32_t geometry;
+    uint32_t material;
+};
+
+static_assert(sizeof(ChunkQuad) == 8);
+
+// +x, -x, +y, -y, +z, -z.
+#define CHUNK_FACE_COUNT 6
+
+#define CHUNK_QUAD_AO_UNOCCLUDED 0xffu
+
+// one drawn section, shaders/chunk.vert reads it at gl_InstanceIndex, so a draw's first_instance picks its
+// record and a whole list of sections goes out in a single indirect draw. quads are pulled from the storage
+// buffer at quads_index.
+struct ChunkDrawRecord {
+    int32_t section_origin[4];
+    uint32_t quads_index;
+    // blocks per quad unit, 1 for full resolution sections and 1 << level for level of detail ones.
+    uint32_t scale;
+    uint32_t pad[2];
+};
+
+static_assert(sizeof(ChunkDrawRecord) == 32);
+
+// push constants of shaders/chunk.vert. the pipeline is built with set_no_vertex_layout() and use_bindless(),
+// records_index is the storage buffer holding the ChunkDrawRecords, e.g. FrameRingAllocation::storage_index.
+struct ChunkDrawConstants {
+    float view_projection[16];
+    uint32_t records_index;
+    uint32_t pad[3];
+};
+
+static_assert(sizeof(ChunkDrawConstants) <= VKH_BINDLESS_PUSH_CONSTANT_SIZE);
+
+// neighbors are only read along the shared borders and edges. a missing neighbor counts as solid, so no
+// faces are emitted towards unloaded chunks and the border is meshed again once the neighbor arrives.
+struct ChunkNeighborhood {
+    Chunk const* center;
+    Chunk const* neg_x;
+    Chunk const* pos_x;
+    Chunk const* neg_z;
+    Chunk const* pos_z;
+    Chunk const* neg_x_neg_z;
+    Chunk const* pos_x_neg_z;
+    Chunk const* neg_x_pos_z;
+    Chunk const* pos_x_pos_z;
+};
+
+// culls hidden faces and greedily merges the visible ones with the same ambient occlusion into quads.
+// faces between two non-air blocks are culled, the bottom of the world is never visible.
+void mesh_chunk_section(ChunkNeighborhood const& neighborhood, uint32_t section_index, std::vector<ChunkQuad>& quads);
+
+// a section of a coarse column, 16^3 cells in get_block_index() order. below is null at the bottom of the
+// world, above at the top.
+struct ChunkLodNeighborhood {
+    Block const* center;
+    Block const* below;
+    Block const* above;
+};
+
+// like mesh_chunk_section(), but the sides of the grid count as air. faces along the border are kept and
+// close the gaps towards neighbors of another level like skirts.
+void mesh_chunk_lod_section(ChunkLodNeighborhood const& neighborhood, std::vector<ChunkQuad>& quads);
+
+struct ChunkMeshRequest {
+    ChunkNeighborhood neighborhood;
+    uint32_t section_index;
+};
+
+enum class ChunkMeshStatus {
+    Empty,
+    Uploaded,
+    // nothing was kept, the request has to be meshed again once the staging ring drained.
+    StagingFull,
+    // nothing was kept either, the request has to be meshed again once meshes were destroyed and their
+    // bindless storage buffer slots released.
+    DescriptorsFull,
+};
+
+// drawn with ChunkDrawRecord::quads_index = quads_index and quad_count * 6 vertices from vertex 0.
+struct ChunkSectionMesh {
+    ChunkMeshStatus status { ChunkMeshStatus::Empty };
+    VKHBuffer quad_buffer;
+    uint32_t quad_count {};
+    uint32_t quads_index { VKH_BINDLESS_INVALID_INDEX };
+
+    // drawable once the upload service reports the ticket complete.
+    uint64_t upload_ticket {};
+
+    // faces connected through the section, computed along with the quads, see compute_section_visibility().
+    // level of detail sections are never culled by it and get SECTION_VISIBILITY_ALL.
+    uint16_t visibility { SECTION_VISIBILITY_ALL };
+};
+
+struct ChunkMesherInfo {
+    VKHAllocator* allocator;
+    UploadService* upload_service;
+    VKHBindlessDescriptors* bindless;
+    JobSubsystem* jobs;
+    std::function<void(std::function<void()>)> defer_destroy;
+};
+
+struct ChunkMesherStats {
+    uint64_t section_count;
+    uint64_t quad_count;
+    uint64_t mesh_time_ns;
+};
+
+// meshes batches of sections on the worker threads, every worker uploads its own results.
+class ChunkMesher {
+    MAKE_NON_COPYABLE(ChunkMesher);
+    MAKE_NON_MOVABLE(ChunkMesher);
+
+public:
+    ChunkMesher() = default;
+
+    void init(ChunkMesherInfo const& info);
+
+    // fills meshes[i] for requests[i], the chunks must not be modified until it returns.
+    void mesh(std::span<ChunkMeshRequest const> requests, std::span<ChunkSectionMesh> meshes);
+
+    // fills meshes[i] for requests[i], the grids must stay alive until it returns.
+    void mesh_lod(std::span<ChunkLodNeighborhood const> requests, std::span<ChunkSectionMesh> meshes);
+
+    // frees the mesh once the frames that may still draw it completed. main thread only.
+    void destroy(ChunkSectionMesh& mesh);
+
+    ChunkMesherStats get_stats() const;
+
+private:
+    // mesh_one returns the visibility of the section it meshed.
+    void mesh_batch(std::span<ChunkSectionMesh> meshes, std::function<uint16_t(uint32_t, std::vector<ChunkQuad>&)> const& mesh_one);
+
+    ChunkSectionMesh upload(std::vector<ChunkQuad> const& quads);
+
+private:
+    VKHAllocator* m_allocator { nullptr };
+    UploadService* m_upload_service { nullptr };
+    VKHBindlessDescriptors* m_bindless { nullptr };
+    JobSubsystem* m_jobs { nullptr };
+    std::function<void(std::function<void()>)> m_defer_destroy;
+
+    std::atomic<uint64_t> m_section_count {};
+    std::atomic<uint64_t> m_quad_count {};
+    std::atomic<uint64_t> m_mesh_time_ns {};
+
+    // reported once until a slot could be allocated again, every section that does not fit fails the same way.
+    std::atomic<bool> m_descriptors_full { false };
+};
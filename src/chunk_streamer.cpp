@@ -0,0 +1,261 @@
+#include <algorithm>
+#include <filesystem>
+
+#include <fmt/format.h>
+
+#include "chunk_streamer.h"
+
+bool ChunkStreamer::init(ChunkStreamerInfo const& info)
+{
+    m_jobs = info.jobs;
+    m_directory = info.directory;
+    m_generator = info.generator;
+    m_max_loads_in_flight = std::max(info.max_loads_in_flight, 1u);
+
+    std::error_code error;
+    std::filesystem::create_directories(m_directory, error);
+    if (error) {
+        fmt::println(stderr, "ChunkStreamer::init(): failed to create '{}': {}!", m_directory, error.message());
+        return false;
+    }
+
+    return true;
+}
+
+void ChunkStreamer::deinit()
+{
+    m_pending_loads.clear();
+    m_jobs->wait(m_counter);
+
+    m_requested.clear();
+    m_results.clear();
+    m_saves.clear();
+
+    for (auto& [position, region] : m_regions)
+        region->file.close();
+    m_regions.clear();
+}
+
+void ChunkStreamer::set_focus(ChunkPosition position)
+{
+    m_focus = position;
+}
+
+void ChunkStreamer::request_load(ChunkPosition position)
+{
+    if (m_requested.insert(position).second)
+        m_pending_loads.push_back(position);
+}
+
+void ChunkStreamer::cancel_load(ChunkPosition position)
+{
+    auto it = std::find(m_pending_loads.begin(), m_pending_loads.end(), position);
+    if (it == m_pending_loads.end())
+        return;
+
+    *it = m_pending_loads.back();
+    m_pending_loads.pop_back();
+    m_requested.erase(position);
+}
+
+void ChunkStreamer::save(Chunk const& chunk)
+{
+    auto position = chunk.get_position();
+
+    auto data = std::make_shared<std::vector<uint8_t>>();
+    chunk.serialize(*data);
+
+    // a write already in flight for the position picks the new data up once it finished.
+    {
+        std::lock_guard lock(m_saves_mutex);
+        auto& pending = m_saves[position];
+        pending.data = std::move(data);
+        pending.sequence++;
+        if (pending.writing)
+            return;
+        pending.writing = true;
+    }
+
+    m_jobs->submit([this, position] { write_pending(position); }, JobPriority::Background, &m_counter);
+}
+
+void ChunkStreamer::update()
+{
+    auto in_flight = m_loads_in_flight.load();
+    if (in_flight < m_max_loads_in_flight && !m_pending_loads.empty()) {
+        auto distance = [this](ChunkPosition position) {
+            int64_t dx = position.x - m_focus.x;
+            int64_t dz = position.z - m_focus.z;
+            return dx * dx + dz * dz;
+        };
+
+        // the closest ones are moved to the back, so dispatching pops them off the end.
+        auto count = std::min<size_t>(m_max_loads_in_flight - in_flight, m_pending_loads.size());
+        auto nth = m_pending_loads.end() - count;
+        std::nth_element(m_pending_loads.begin(), nth, m_pending_loads.end(), [&](ChunkPosition a, ChunkPosition b) {
+            return distance(a) > distance(b);
+        });
+
+        for (auto it = nth; it != m_pending_loads.end(); it++) {
+            m_loads_in_flight.fetch_add(1);
+            m_jobs->submit([this, position = *it] { load(position); }, JobPriority::Background, &m_counter);
+        }
+        m_pending_loads.erase(nth, m_pending_loads.end());
+    }
+
+    if (m_compacting.load())
+        return;
+
+    // needs_compaction() is lock free, so this never waits on a worker's disk I/O.
+    RegionFile* compact_region { nullptr };
+    {
+        std::lock_guard lock(m_regions_mutex);
+        for (auto& [position, region] : m_regions) {
+            if (region->open.load(std::memory_order_acquire) && region->file.needs_compaction()) {
+                compact_region = &region->file;
+                break;
+            }
+        }
+    }
+
+    if (compact_region) {
+        auto compact = [this, compact_region] {
+            if (compact_region->compact())
+                m_compaction_count.fetch_add(1, std::memory_order_relaxed);
+            m_compacting = false;
+        };
+
+        m_compacting = true;
+        m_jobs->submit(std::move(compact), JobPriority::Background, &m_counter);
+    }
+}
+
+void ChunkStreamer::collect(std::vector<ChunkLoadResult>& results)
+{
+    std::vector<ChunkLoadResult> finished;
+    {
+        std::lock_guard lock(m_results_mutex);
+        finished.swap(m_results);
+    }
+
+    for (auto& result : finished) {
+        m_requested.erase(result.position);
+        results.push_back(std::move(result));
+    }
+}
+
+ChunkStreamerStats ChunkStreamer::get_stats() const
+{
+    ChunkStreamerStats stats {};
+    stats.loaded_count = m_loaded_count.load(std::memory_order_relaxed);
+    stats.missing_count = m_missing_count.load(std::memory_order_relaxed);
+    stats.generated_count = m_generated_count.load(std::memory_order_relaxed);
+    stats.saved_count = m_saved_count.load(std::memory_order_relaxed);
+    stats.failed_save_count = m_failed_save_count.load(std::memory_order_relaxed);
+    stats.compaction_count = m_compaction_count.load(std::memory_order_relaxed);
+    stats.pending_load_count = m_pending_loads.size();
+    stats.loads_in_flight = m_loads_in_flight.load();
+    return stats;
+}
+
+void ChunkStreamer::load(ChunkPosition position)
+{
+    auto chunk = std::make_unique<Chunk>(position);
+
+    std::shared_ptr<std::vector<uint8_t> const> saved;
+    {
+        std::lock_guard lock(m_saves_mutex);
+        if (auto it = m_saves.find(position); it != m_saves.end())
+            saved = it->second.data;
+    }
+
+    auto found = false;
+    if (saved) {
+        found = chunk->deserialize(saved->data(), saved->size());
+    } else if (auto region = get_region(get_region_position(position), false)) {
+        found = region->read(position, *chunk);
+    }
+
+    auto generated = false;
+    if (found) {
+        m_loaded_count.fetch_add(1, std::memory_order_relaxed);
+    } else if (m_generator) {
+        m_generator->generate(*chunk);
+        m_generated_count.fetch_add(1, std::memory_order_relaxed);
+        generated = true;
+    } else {
+        m_missing_count.fetch_add(1, std::memory_order_relaxed);
+        chunk.reset();
+    }
+
+    {
+        std::lock_guard lock(m_results_mutex);
+        m_results.push_back({ position, std::move(chunk), generated });
+    }
+
+    m_loads_in_flight.fetch_sub(1);
+}
+
+void ChunkStreamer::write_pending(ChunkPosition position)
+{
+    auto region = get_region(get_region_position(position), true);
+    if (!region)
+        fmt::println(stderr, "ChunkStreamer::write_pending(): no region file for column ({}, {}), dropping its save!", position.x, position.z);
+
+    while (true) {
+        std::shared_ptr<std::vector<uint8_t> const> data;
+        uint64_t sequence;
+        {
+            std::lock_guard lock(m_saves_mutex);
+            auto const& pending = m_saves.at(position);
+            data = pending.data;
+            sequence = pending.sequence;
+        }
+
+        // RegionFile::write() reports its own failures.
+        if (region && region->write(position, *data))
+            m_saved_count.fetch_add(1, std::memory_order_relaxed);
+        else
+            m_failed_save_count.fetch_add(1, std::memory_order_relaxed);
+
+        // loads keep reading the pending data until it is on disk.
+        std::lock_guard lock(m_saves_mutex);
+        auto it = m_saves.find(position);
+        if (it->second.sequence == sequence) {
+            m_saves.erase(it);
+            return;
+        }
+    }
+}
+
+RegionFile* ChunkStreamer::get_region(RegionPosition position, bool create)
+{
+    Region* region;
+    {
+        std::lock_guard lock(m_regions_mutex);
+        auto& entry = m_regions[position];
+        if (!entry)
+            entry = std::make_unique<Region>();
+        region = entry.get();
+    }
+
+    if (region->open.load(std::memory_order_acquire))
+        return &region->file;
+
+    // the file is created, read and mapped under the region's own mutex, so concurrent opens of the same
+    // region wait for each other and nobody else does.
+    std::lock_guard lock(region->open_mutex);
+    if (region->open.load(std::memory_order_relaxed))
+        return &region->file;
+
+    // loads of columns nobody saved yet should not leave empty region files behind.
+    auto path = fmt::format("{}/r.{}.{}.region", m_directory, position.x, position.z);
+    if (!create && !std::filesystem::exists(path))
+        return nullptr;
+
+    if (!region->file.open(path))
+        return nullptr;
+
+    region->open.store(true, std::memory_order_release);
+    return &region->file;
+}
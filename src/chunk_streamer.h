@@ -0,0 +1,139 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "chunk.h"
+#include "helper.h"
+#include "job_subsystem.h"
+#include "region_file.h"
+#include "terrain_generator.h"
+
+struct ChunkStreamerInfo {
+    JobSubsystem* jobs;
+    std::string directory;
+
+    // generates columns that were never saved on the loading worker, null leaves them to the caller.
+    TerrainGenerator const* generator { nullptr };
+
+    // loads running on the workers at once, the rest wait sorted by distance to the focus.
+    uint32_t max_loads_in_flight { 8 };
+};
+
+// chunk is null when the column was never saved and there is no generator.
+struct ChunkLoadResult {
+    ChunkPosition position;
+    std::unique_ptr<Chunk> chunk;
+    bool generated;
+};
+
+struct ChunkStreamerStats {
+    uint64_t loaded_count;
+    uint64_t missing_count;
+    uint64_t generated_count;
+    uint64_t saved_count;
+    // saves whose region file could not be opened or written, the column keeps its previous state on disk.
+    uint64_t failed_save_count;
+    uint64_t compaction_count;
+    uint32_t pending_load_count;
+    uint32_t loads_in_flight;
+};
+
+// loads and saves chunk columns in region files on the background workers. the queue, update() and
+// collect() belong to the main thread, everything else runs on the jobs.
+class ChunkStreamer {
+    MAKE_NON_COPYABLE(ChunkStreamer);
+    MAKE_NON_MOVABLE(ChunkStreamer);
+
+public:
+    ChunkStreamer() = default;
+
+    bool init(ChunkStreamerInfo const& info);
+
+    // finishes every load and save in flight, pending loads are dropped.
+    void deinit();
+
+    // loads closest to the focus are dispatched first.
+    void set_focus(ChunkPosition position);
+
+    // ignored while the column is already queued, loading or waiting to be collected.
+    void request_load(ChunkPosition position);
+
+    // drops a load that was not dispatched yet, e.g. because the column left the view.
+    void cancel_load(ChunkPosition position);
+
+    // serializes right away, so the chunk may change once this returns. compression and the write happen
+    // on a worker, loads issued in the meantime see the saved state.
+    void save(Chunk const& chunk);
+
+    // dispatches queued loads and compacts regions that gathered too much garbage. call once per frame.
+    void update();
+
+    // appends every load that finished since the last call.
+    void collect(std::vector<ChunkLoadResult>& results);
+
+    ChunkStreamerStats get_stats() const;
+
+private:
+    void load(ChunkPosition position);
+
+    // writes the position's pending save until no newer one arrived during the write.
+    void write_pending(ChunkPosition position);
+
+    // null when the file cannot be opened, or does not exist and create is false.
+    RegionFile* get_region(RegionPosition position, bool create);
+
+private:
+    JobSubsystem* m_jobs { nullptr };
+    std::string m_directory;
+    TerrainGenerator const* m_generator { nullptr };
+    uint32_t m_max_loads_in_flight {};
+
+    // every job holds the counter, deinit() waits on it.
+    JobCounter m_counter;
+
+    ChunkPosition m_focus {};
+    std::vector<ChunkPosition> m_pending_loads;
+    std::unordered_set<ChunkPosition, ChunkPositionHash> m_requested;
+    std::atomic<uint32_t> m_loads_in_flight { 0 };
+    std::atomic<bool> m_compacting { false };
+
+    std::mutex m_results_mutex;
+    std::vector<ChunkLoadResult> m_results;
+
+    // a serialized column whose write has not finished, newer saves replace the data and bump the sequence.
+    // at most one job writes a position at a time, so an older save never lands after a newer one.
+    struct PendingSave {
+        std::shared_ptr<std::vector<uint8_t> const> data;
+        uint64_t sequence;
+        bool writing;
+    };
+
+    // only held to look up or swap entries, never across file I/O.
+    std::mutex m_saves_mutex;
+    std::unordered_map<ChunkPosition, PendingSave, ChunkPositionHash> m_saves;
+
+    // opened on first use under its own mutex, so neither the map nor the main thread wait for the disk.
+    struct Region {
+        std::mutex open_mutex;
+        std::atomic<bool> open { false };
+        RegionFile file;
+    };
+
+    // regions stay open until deinit(), the mutex is only held to look up or insert entries.
+    std::mutex m_regions_mutex;
+    std::unordered_map<RegionPosition, std::unique_ptr<Region>, RegionPositionHash> m_regions;
+
+    std::atomic<uint64_t> m_loaded_count {};
+    std::atomic<uint64_t> m_missing_count {};
+    std::atomic<uint64_t> m_generated_count {};
+    std::atomic<uint64_t> m_saved_count {};
+    std::atomic<uint64_t> m_failed_save_count {};
+    std::atomic<uint64_t> m_compaction_count {};
+};
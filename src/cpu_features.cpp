@@ -0,0 +1,50 @@
+#include "cpu_features.h"
+
+#if defined(CPU_X86) && defined(_MSC_VER)
+#    include <intrin.h>
+#endif
+
+bool is_cpu_isa_supported(CpuISA isa)
+{
+    if (isa == CpuISA::Scalar)
+        return true;
+
+#if defined(CPU_X86)
+#    if defined(_MSC_VER)
+    int32_t registers[4];
+    __cpuid(registers, 1);
+    auto sse41 = (registers[2] & (1 << 19)) != 0;
+    auto osxsave = (registers[2] & (1 << 27)) != 0;
+    auto avx = (registers[2] & (1 << 28)) != 0;
+    if (isa == CpuISA::SSE41)
+        return sse41;
+
+    // the OS has to save the upper halves of the ymm registers too.
+    if (!osxsave || !avx || (_xgetbv(0) & 6) != 6)
+        return false;
+
+    __cpuidex(registers, 7, 0);
+    return (registers[1] & (1 << 5)) != 0;
+#    else
+    if (isa == CpuISA::SSE41)
+        return __builtin_cpu_supports("sse4.1");
+    return __builtin_cpu_supports("avx2");
+#    endif
+#else
+    return false;
+#endif
+}
+
+char const* get_cpu_isa_name(CpuISA isa)
+{
+    switch (isa) {
+    case CpuISA::Scalar:
+        return "scalar";
+    case CpuISA::SSE41:
+        return "sse4.1";
+    case CpuISA::AVX2:
+        return "avx2";
+    default:
+        return "unknown";
+    }
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+
+// the SSE4.1 and AVX2 kernels are built for x86-64 only, other targets run the scalar ones.
+#if defined(__x86_64__) || defined(_M_X64)
+#    define CPU_X86
+#endif
+
+enum class CpuISA {
+    Scalar,
+    SSE41,
+    AVX2,
+    Count,
+};
+
+#define CPU_ISA_COUNT static_cast<uint32_t>(CpuISA::Count)
+
+// whether the CPU can run kernels built for isa, false for the vector ISAs on other targets.
+bool is_cpu_isa_supported(CpuISA isa);
+
+char const* get_cpu_isa_name(CpuISA isa);
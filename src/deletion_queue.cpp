@@ -0,0 +1,24 @@
+#include "deletion_queue.h"
+
+void DeletionQueue::push(uint64_t retire_frame, std::function<void()> deleter)
+{
+    m_entries.push_back({ retire_frame, std::move(deleter) });
+}
+
+void DeletionQueue::flush(uint64_t completed_frame)
+{
+    while (!m_entries.empty() && m_entries.front().retire_frame <= completed_frame) {
+        auto deleter = std::move(m_entries.front().deleter);
+        m_entries.pop_front();
+        deleter();
+    }
+}
+
+void DeletionQueue::flush_all()
+{
+    while (!m_entries.empty()) {
+        auto deleter = std::move(m_entries.front().deleter);
+        m_entries.pop_front();
+        deleter();
+    }
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+
+#include "helper.h"
+
+class DeletionQueue {
+    MAKE_NON_COPYABLE(DeletionQueue);
+    MAKE_NON_MOVABLE(DeletionQueue);
+
+public:
+    DeletionQueue() = default;
+
+    // retire_frame must not decrease between pushes, the deleter runs once that frame is complete.
+    void push(uint64_t retire_frame, std::function<void()> deleter);
+
+    void flush(uint64_t completed_frame);
+
+    void flush_all();
+
+    size_t size() const { return m_entries.size(); }
+
+private:
+    struct Entry {
+        uint64_t retire_frame;
+        std::function<void()> deleter;
+    };
+
+    std::deque<Entry> m_entries;
+};
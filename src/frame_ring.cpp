@@ -0,0 +1,122 @@
+#include <algorithm>
+#include <bit>
+
+#include "frame_ring.h"
+#include "vulkan_helper.h"
+
+#define FRAME_RING_BUFFER_USAGE                                                                             \
+    (VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT \
+        | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT)
+
+namespace {
+
+VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+}
+
+void FrameRing::init(FrameRingInfo const& info)
+{
+    m_allocator = info.allocator;
+    m_bindless = info.bindless;
+    m_frames_in_flight = info.frames_in_flight;
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(info.physical_device, &properties);
+
+    // both limits are powers of two, so the larger one satisfies the other.
+    m_alignment = std::max<VkDeviceSize>({
+        properties.limits.minUniformBufferOffsetAlignment,
+        properties.limits.minStorageBufferOffsetAlignment,
+        16,
+    });
+
+    m_slots = std::make_unique<Slot[]>(m_frames_in_flight);
+    for (auto i { 0u }; i < m_frames_in_flight; i++)
+        create_buffer(m_slots[i], align_up(info.size, m_alignment));
+}
+
+void FrameRing::deinit()
+{
+    for (auto i { 0u }; i < m_frames_in_flight; i++)
+        destroy_buffer(m_slots[i]);
+
+    m_slots.reset();
+}
+
+void FrameRing::reset(uint32_t frame_index)
+{
+    auto& slot = m_slots[frame_index];
+    auto used = slot.head.exchange(0, std::memory_order_relaxed);
+
+    m_last_frame_bytes = used;
+    m_peak_frame_bytes = std::max(m_peak_frame_bytes, used);
+
+    // the slot's last frame has retired, so its buffer can be replaced right away.
+    if (used > slot.buffer.size) {
+        auto size = std::bit_ceil(used);
+        fmt::println("frame ring: slot {} overflowed ({} of {} bytes), growing to {} bytes",
+            frame_index, used, slot.buffer.size, size);
+
+        destroy_buffer(slot);
+        create_buffer(slot, size);
+        m_grow_count++;
+    }
+}
+
+FrameRingAllocation FrameRing::allocate(uint32_t frame_index, VkDeviceSize size, VkDeviceSize alignment)
+{
+    auto& slot = m_slots[frame_index];
+
+    // every size is rounded to the alignment, so every offset handed out stays aligned. a larger alignment
+    // reserves the padding needed to round the offset up to it.
+    auto padding = alignment > m_alignment ? alignment - m_alignment : 0;
+    auto aligned_size = align_up(size + padding, m_alignment);
+    auto head = slot.head.fetch_add(aligned_size, std::memory_order_relaxed);
+    if (head + aligned_size > slot.buffer.size) {
+        m_overflow_count.fetch_add(1, std::memory_order_relaxed);
+        return {};
+    }
+
+    auto offset = padding ? align_up(head, alignment) : head;
+
+    FrameRingAllocation allocation {};
+    allocation.buffer = slot.buffer.buffer;
+    allocation.offset = offset;
+    allocation.size = size;
+    allocation.data = slot.data + offset;
+    allocation.storage_index = slot.storage_index;
+    return allocation;
+}
+
+FrameRingStats FrameRing::get_stats() const
+{
+    FrameRingStats stats {};
+    for (auto i { 0u }; i < m_frames_in_flight; i++)
+        stats.capacity += m_slots[i].buffer.size;
+    stats.last_frame_bytes = m_last_frame_bytes;
+    stats.peak_frame_bytes = m_peak_frame_bytes;
+    stats.overflow_count = m_overflow_count.load(std::memory_order_relaxed);
+    stats.grow_count = m_grow_count;
+    return stats;
+}
+
+void FrameRing::create_buffer(Slot& slot, VkDeviceSize size)
+{
+    slot.buffer = m_allocator->create_buffer(size, FRAME_RING_BUFFER_USAGE, VKHMemoryUsage::CPUToGPU);
+    slot.data = static_cast<uint8_t*>(slot.buffer.allocation.mapped);
+    if (m_bindless)
+        slot.storage_index = m_bindless->add_storage_buffer(slot.buffer.buffer);
+}
+
+void FrameRing::destroy_buffer(Slot& slot)
+{
+    // the index is only handed out again once the frames that may still read it completed.
+    if (slot.storage_index != VKH_BINDLESS_INVALID_INDEX)
+        m_bindless->remove_storage_buffer(slot.storage_index);
+    slot.storage_index = VKH_BINDLESS_INVALID_INDEX;
+
+    m_allocator->destroy_buffer(slot.buffer);
+}
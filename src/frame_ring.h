@@ -0,0 +1,107 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include "helper.h"
+#include "vulkan.h"
+#include "vulkan_allocator.h"
+#include "vulkan_bindless.h"
+
+#define FRAME_RING_DEFAULT_SIZE (4ull * 1024 * 1024)
+
+struct FrameRingAllocation {
+    VkBuffer buffer { nullptr };
+    VkDeviceSize offset {};
+    VkDeviceSize size {};
+    void* data { nullptr };
+
+    // the slot buffer as a bindless storage buffer, VKH_BINDLESS_INVALID_INDEX without FrameRingInfo::bindless.
+    uint32_t storage_index { VKH_BINDLESS_INVALID_INDEX };
+
+    operator bool() const { return data != nullptr; }
+};
+
+struct FrameRingInfo {
+    VkPhysicalDevice physical_device;
+    VKHAllocator* allocator;
+    uint32_t frames_in_flight;
+
+    // per frame slot. a slot that overflowed is regrown to fit its peak the next time it is reset.
+    VkDeviceSize size { FRAME_RING_DEFAULT_SIZE };
+
+    // registers every slot buffer, so shaders can read allocations through FrameRingAllocation::storage_index.
+    VKHBindlessDescriptors* bindless { nullptr };
+};
+
+struct FrameRingStats {
+    VkDeviceSize capacity;
+    VkDeviceSize last_frame_bytes;
+    VkDeviceSize peak_frame_bytes;
+    uint64_t overflow_count;
+    uint32_t grow_count;
+};
+
+// hands out aligned, persistently mapped suballocations for uniform, storage and indirect data that
+// only live for one frame. every frame slot owns one buffer which is rewound once the slot is reused.
+class FrameRing {
+    MAKE_NON_COPYABLE(FrameRing);
+    MAKE_NON_MOVABLE(FrameRing);
+
+public:
+    FrameRing() = default;
+
+    void init(FrameRingInfo const& info);
+
+    void deinit();
+
+    // rewinds the slot, must only be called once the frame's previous submission is known to be complete.
+    void reset(uint32_t frame_index);
+
+    // lock free and safe to call from any recording thread. returns an empty allocation on overflow.
+    // alignment is a power of two, offsets are aligned to the larger of it and get_alignment(), e.g. so
+    // shaders can index an array of structs from the buffer's start.
+    FrameRingAllocation allocate(uint32_t frame_index, VkDeviceSize size, VkDeviceSize alignment = 0);
+
+    template <typename T>
+    FrameRingAllocation push(uint32_t frame_index, T const& value)
+    {
+        auto allocation = allocate(frame_index, sizeof(T));
+        if (allocation)
+            *static_cast<T*>(allocation.data) = value;
+        return allocation;
+    }
+
+    // satisfies both minUniformBufferOffsetAlignment and minStorageBufferOffsetAlignment.
+    VkDeviceSize get_alignment() const { return m_alignment; }
+
+    FrameRingStats get_stats() const;
+
+private:
+    struct Slot {
+        VKHBuffer buffer;
+        uint8_t* data { nullptr };
+        uint32_t storage_index { VKH_BINDLESS_INVALID_INDEX };
+
+        // keeps counting past the capacity so an overflowing frame still reports what it needed.
+        std::atomic<VkDeviceSize> head {};
+    };
+
+    void create_buffer(Slot& slot, VkDeviceSize size);
+
+    void destroy_buffer(Slot& slot);
+
+private:
+    VKHAllocator* m_allocator { nullptr };
+    VKHBindlessDescriptors* m_bindless { nullptr };
+    VkDeviceSize m_alignment {};
+    uint32_t m_frames_in_flight {};
+
+    std::unique_ptr<Slot[]> m_slots;
+
+    VkDeviceSize m_last_frame_bytes {};
+    VkDeviceSize m_peak_frame_bytes {};
+    std::atomic<uint64_t> m_overflow_count {};
+    uint32_t m_grow_count {};
+};
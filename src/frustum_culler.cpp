@@ -0,0 +1,178 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <initializer_list>
+#include <limits>
+
+#include "frustum_culler.h"
+
+#if defined(CPU_X86)
+FrustumCullKernels const* get_frustum_cull_kernels_sse41();
+FrustumCullKernels const* get_frustum_cull_kernels_avx2();
+#endif
+
+namespace {
+
+// nan where a plane's normal has a zero component, which fails the test just the same.
+constexpr float g_removed_min = std::numeric_limits<float>::infinity();
+constexpr float g_removed_max = -std::numeric_limits<float>::infinity();
+
+uint32_t cull_scalar(FrustumCullPlane const (&planes)[6], uint32_t begin, uint32_t end, uint32_t* out)
+{
+    auto count { 0u };
+    for (auto i = begin; i < end; i++) {
+        auto inside = true;
+        for (auto const& plane : planes) {
+            auto distance = plane.normal[0] * plane.x[i] + plane.normal[1] * plane.y[i] + plane.normal[2] * plane.z[i] + plane.distance;
+            inside &= distance >= 0.0f;
+        }
+        out[count] = i;
+        count += inside;
+    }
+    return count;
+}
+
+FrustumCullKernels const SCALAR_KERNELS { CpuISA::Scalar, cull_scalar };
+
+}
+
+void extract_frustum_planes(float const* view_projection, float (&planes)[6][4])
+{
+    auto row = [view_projection](uint32_t i, uint32_t j) { return view_projection[j * 4 + i]; };
+
+    for (auto j { 0u }; j < 4; j++) {
+        planes[0][j] = row(3, j) + row(0, j);
+        planes[1][j] = row(3, j) - row(0, j);
+        planes[2][j] = row(3, j) + row(1, j);
+        planes[3][j] = row(3, j) - row(1, j);
+        planes[4][j] = row(2, j);
+        planes[5][j] = row(3, j) - row(2, j);
+    }
+
+    for (auto& plane : planes) {
+        auto length = std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+        for (auto& value : plane)
+            value /= length;
+    }
+}
+
+FrustumCullKernels const& get_frustum_cull_kernels()
+{
+    static FrustumCullKernels const* kernels = [] {
+        for (auto isa : { CpuISA::AVX2, CpuISA::SSE41 }) {
+            if (auto kernels = get_frustum_cull_kernels(isa))
+                return kernels;
+        }
+        return &SCALAR_KERNELS;
+    }();
+    return *kernels;
+}
+
+FrustumCullKernels const* get_frustum_cull_kernels(CpuISA isa)
+{
+    switch (isa) {
+    case CpuISA::Scalar:
+        return &SCALAR_KERNELS;
+#if defined(CPU_X86)
+    case CpuISA::SSE41:
+        return is_cpu_isa_supported(isa) ? get_frustum_cull_kernels_sse41() : nullptr;
+    case CpuISA::AVX2:
+        return is_cpu_isa_supported(isa) ? get_frustum_cull_kernels_avx2() : nullptr;
+#endif
+    default:
+        return nullptr;
+    }
+}
+
+void FrustumCuller::init(FrustumCullerInfo const& info)
+{
+    m_jobs = info.jobs;
+    m_kernels = info.kernels ? info.kernels : &get_frustum_cull_kernels();
+    m_boxes_per_job = std::max(info.boxes_per_job / FRUSTUM_CULL_BATCH * FRUSTUM_CULL_BATCH, static_cast<uint32_t>(FRUSTUM_CULL_BATCH));
+}
+
+uint32_t FrustumCuller::add(float const (&min)[3], float const (&max)[3])
+{
+    uint32_t index;
+    if (!m_free.empty()) {
+        index = m_free.back();
+        m_free.pop_back();
+    } else {
+        index = m_count++;
+        if (index == m_min_x.size()) {
+            auto size = m_min_x.size() + FRUSTUM_CULL_BATCH;
+            for (auto bounds : { &m_min_x, &m_min_y, &m_min_z })
+                bounds->resize(size, g_removed_min);
+            for (auto bounds : { &m_max_x, &m_max_y, &m_max_z })
+                bounds->resize(size, g_removed_max);
+        }
+    }
+
+    set(index, min, max);
+    return index;
+}
+
+void FrustumCuller::set(uint32_t index, float const (&min)[3], float const (&max)[3])
+{
+    m_min_x[index] = min[0];
+    m_min_y[index] = min[1];
+    m_min_z[index] = min[2];
+    m_max_x[index] = max[0];
+    m_max_y[index] = max[1];
+    m_max_z[index] = max[2];
+}
+
+void FrustumCuller::remove(uint32_t index)
+{
+    m_min_x[index] = m_min_y[index] = m_min_z[index] = g_removed_min;
+    m_max_x[index] = m_max_y[index] = m_max_z[index] = g_removed_max;
+    m_free.push_back(index);
+}
+
+void FrustumCuller::clear()
+{
+    for (auto bounds : { &m_min_x, &m_min_y, &m_min_z, &m_max_x, &m_max_y, &m_max_z })
+        bounds->clear();
+    m_count = 0;
+    m_free.clear();
+}
+
+void FrustumCuller::cull(float const (&view_projection)[16], std::vector<uint32_t>& visible)
+{
+    float frustum[6][4];
+    extract_frustum_planes(view_projection, frustum);
+
+    FrustumCullPlane planes[6];
+    for (auto i { 0u }; i < 6; i++) {
+        auto& plane = planes[i];
+        std::copy_n(frustum[i], 3, plane.normal);
+        plane.distance = frustum[i][3];
+        plane.x = plane.normal[0] >= 0.0f ? m_max_x.data() : m_min_x.data();
+        plane.y = plane.normal[1] >= 0.0f ? m_max_y.data() : m_min_y.data();
+        plane.z = plane.normal[2] >= 0.0f ? m_max_z.data() : m_min_z.data();
+    }
+
+    // every job writes at the start of its own range, the ranges are packed afterwards.
+    auto size = static_cast<uint32_t>(m_min_x.size());
+    visible.resize(size);
+    if (!m_jobs || size <= m_boxes_per_job) {
+        visible.resize(m_kernels->cull(planes, 0, size, visible.data()));
+        return;
+    }
+
+    auto job_count = (size + m_boxes_per_job - 1) / m_boxes_per_job;
+    m_job_counts.resize(job_count);
+    auto cull_range = [&](uint32_t job) {
+        auto begin = job * m_boxes_per_job;
+        auto end = std::min(begin + m_boxes_per_job, size);
+        m_job_counts[job] = m_kernels->cull(planes, begin, end, visible.data() + begin);
+    };
+    m_jobs->parallel_for(job_count, cull_range, JobPriority::High);
+
+    auto count = m_job_counts[0];
+    for (auto job { 1u }; job < job_count; job++) {
+        std::memmove(visible.data() + count, visible.data() + job * m_boxes_per_job, m_job_counts[job] * sizeof(uint32_t));
+        count += m_job_counts[job];
+    }
+    visible.resize(count);
+}
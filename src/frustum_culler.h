@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "cpu_features.h"
+#include "helper.h"
+#include "job_subsystem.h"
+
+// boxes are tested in batches of this many, the widest ISA's lane count. tables are padded to a multiple of it.
+#define FRUSTUM_CULL_BATCH 8
+
+#define FRUSTUM_CULLER_INVALID_INDEX UINT32_MAX
+
+// Gribb-Hartmann on a column-major matrix with a [0, 1] depth range, planes point inwards.
+void extract_frustum_planes(float const* view_projection, float (&planes)[6][4]);
+
+// one plane together with the bounds its positive vertex reads, the box corner furthest along the normal.
+// a box whose positive vertex lies behind any plane is outside.
+struct FrustumCullPlane {
+    float normal[3];
+    float distance;
+    float const* x;
+    float const* y;
+    float const* z;
+};
+
+struct FrustumCullKernels {
+    CpuISA isa;
+
+    // writes the indices in [begin, end) of the boxes that are not outside to out in ascending order and
+    // returns how many. begin and end are multiples of FRUSTUM_CULL_BATCH.
+    uint32_t (*cull)(FrustumCullPlane const (&planes)[6], uint32_t begin, uint32_t end, uint32_t* out);
+};
+
+// the widest ISA the CPU supports, detected once.
+FrustumCullKernels const& get_frustum_cull_kernels();
+
+// null when the CPU or the build does not support isa.
+FrustumCullKernels const* get_frustum_cull_kernels(CpuISA isa);
+
+struct FrustumCullerInfo {
+    // null culls on the calling thread only.
+    JobSubsystem* jobs;
+
+    // null picks get_frustum_cull_kernels().
+    FrustumCullKernels const* kernels;
+
+    // boxes per job, tables up to this size are culled on the calling thread.
+    uint32_t boxes_per_job { 16384 };
+};
+
+// axis aligned boxes stored as one array per bound, so a batch is a single load per bound and plane.
+// indices stay stable until removed and are handed out again afterwards, removed boxes are inverted and
+// never pass. main thread only, cull() spreads over the workers itself.
+class FrustumCuller {
+    MAKE_NON_COPYABLE(FrustumCuller);
+    MAKE_NON_MOVABLE(FrustumCuller);
+
+public:
+    FrustumCuller() = default;
+
+    void init(FrustumCullerInfo const& info);
+
+    uint32_t add(float const (&min)[3], float const (&max)[3]);
+
+    void set(uint32_t index, float const (&min)[3], float const (&max)[3]);
+
+    void remove(uint32_t index);
+
+    void clear();
+
+    uint32_t get_count() const { return m_count - m_free.size(); }
+
+    // replaces visible with the indices of the boxes inside or intersecting the frustum, ascending.
+    void cull(float const (&view_projection)[16], std::vector<uint32_t>& visible);
+
+    CpuISA get_isa() const { return m_kernels->isa; }
+
+private:
+    JobSubsystem* m_jobs { nullptr };
+    FrustumCullKernels const* m_kernels { nullptr };
+    uint32_t m_boxes_per_job {};
+
+    std::vector<float> m_min_x;
+    std::vector<float> m_min_y;
+    std::vector<float> m_min_z;
+    std::vector<float> m_max_x;
+    std::vector<float> m_max_y;
+    std::vector<float> m_max_z;
+
+    // indices handed out so far, removed ones included.
+    uint32_t m_count {};
+    std::vector<uint32_t> m_free;
+
+    std::vector<uint32_t> m_job_counts;
+};
@@ -0,0 +1,55 @@
+#include "frustum_culler.h"
+
+#if defined(CPU_X86)
+
+#    include <smmintrin.h>
+
+namespace {
+
+// no standard library in here, an inline function emitted with SSE4.1 enabled could be picked by the
+// linker for the other translation units too.
+uint32_t cull_sse41(FrustumCullPlane const (&planes)[6], uint32_t begin, uint32_t end, uint32_t* out)
+{
+    __m128 normal_x[6];
+    __m128 normal_y[6];
+    __m128 normal_z[6];
+    __m128 distance[6];
+    for (auto i { 0u }; i < 6; i++) {
+        normal_x[i] = _mm_set1_ps(planes[i].normal[0]);
+        normal_y[i] = _mm_set1_ps(planes[i].normal[1]);
+        normal_z[i] = _mm_set1_ps(planes[i].normal[2]);
+        distance[i] = _mm_set1_ps(planes[i].distance);
+    }
+
+    auto zero = _mm_setzero_ps();
+    auto count { 0u };
+    for (auto i = begin; i < end; i += 4) {
+        auto inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (auto p { 0u }; p < 6; p++) {
+            auto const& plane = planes[p];
+            auto d = _mm_mul_ps(normal_x[p], _mm_loadu_ps(plane.x + i));
+            d = _mm_add_ps(d, _mm_mul_ps(normal_y[p], _mm_loadu_ps(plane.y + i)));
+            d = _mm_add_ps(d, _mm_mul_ps(normal_z[p], _mm_loadu_ps(plane.z + i)));
+            d = _mm_add_ps(d, distance[p]);
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(d, zero));
+        }
+
+        // every lane is written, only the inside ones advance the output.
+        auto mask = static_cast<uint32_t>(_mm_movemask_ps(inside));
+        for (auto lane { 0u }; lane < 4; lane++) {
+            out[count] = i + lane;
+            count += (mask >> lane) & 1;
+        }
+    }
+    return count;
+}
+
+}
+
+FrustumCullKernels const* get_frustum_cull_kernels_sse41()
+{
+    static FrustumCullKernels const kernels { CpuISA::SSE41, cull_sse41 };
+    return &kernels;
+}
+
+#endif
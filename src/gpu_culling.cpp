@@ -0,0 +1,340 @@
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+#include "frustum_culler.h"
+#include "gpu_culling.h"
+
+namespace {
+
+VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+uint32_t dispatch_size(uint32_t count, uint32_t group_size)
+{
+    return (count + group_size - 1) / group_size;
+}
+
+}
+
+bool GPUCuller::init(GPUCullerInfo const& info)
+{
+    m_device = info.device;
+    m_allocator = info.allocator;
+    m_bindless = info.bindless;
+    m_defer_destroy = info.defer_destroy;
+    m_max_draw_count = info.max_draw_count;
+
+    m_cull_shader = vkh_create_shader_module(m_device, info.shader_dir + "/cull.comp.spv");
+    m_depth_pyramid_shader = vkh_create_shader_module(m_device, info.shader_dir + "/hiz.comp.spv");
+    if (!m_cull_shader || !m_depth_pyramid_shader) {
+        deinit();
+        return false;
+    }
+
+    m_cull_pipeline = VKHComputePipelineBuilder(info.registry)
+                          .set_shader(m_cull_shader, "main")
+                          .use_bindless(*m_bindless)
+                          .build();
+
+    m_depth_pyramid_pipeline = VKHComputePipelineBuilder(info.registry)
+                                   .set_shader(m_depth_pyramid_shader, "main")
+                                   .use_bindless(*m_bindless)
+                                   .build();
+
+    m_commands = m_allocator->create_buffer(
+        m_max_draw_count * sizeof(VkDrawIndexedIndirectCommand),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+        VKHMemoryUsage::GPUOnly);
+    m_count = m_allocator->create_buffer(
+        sizeof(uint32_t),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VKHMemoryUsage::GPUOnly);
+    m_commands_index = m_bindless->add_storage_buffer(m_commands.buffer);
+    m_count_index = m_bindless->add_storage_buffer(m_count.buffer);
+
+    // 256 satisfies every minStorageBufferOffsetAlignment the spec allows.
+    auto params_stride = align_up(sizeof(Params), 256);
+    m_params = m_allocator->create_buffer(params_stride * info.frames_in_flight, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VKHMemoryUsage::CPUToGPU);
+    for (auto i { 0u }; i < info.frames_in_flight; i++)
+        m_params_indices.push_back(m_bindless->add_storage_buffer(m_params.buffer, i * params_stride, sizeof(Params)));
+
+    VkSamplerCreateInfo sampler_create_info {};
+    sampler_create_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    sampler_create_info.magFilter = VK_FILTER_NEAREST;
+    sampler_create_info.minFilter = VK_FILTER_NEAREST;
+    sampler_create_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    sampler_create_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_create_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_create_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    VK_CHECK(vkCreateSampler(m_device, &sampler_create_info, nullptr, &m_depth_sampler));
+    m_depth_sampler_index = m_bindless->add_sampler(m_depth_sampler);
+
+    return true;
+}
+
+void GPUCuller::deinit()
+{
+    destroy_depth_pyramid(false);
+
+    if (m_depth_sampler)
+        vkDestroySampler(m_device, m_depth_sampler, nullptr);
+    m_depth_sampler = nullptr;
+
+    m_bindless->remove_sampler(m_depth_sampler_index);
+    m_bindless->remove_sampled_image(m_depth_index);
+    m_bindless->remove_storage_buffer(m_commands_index);
+    m_bindless->remove_storage_buffer(m_count_index);
+    for (auto index : m_params_indices)
+        m_bindless->remove_storage_buffer(index);
+
+    m_allocator->destroy_buffer(m_commands);
+    m_allocator->destroy_buffer(m_count);
+    m_allocator->destroy_buffer(m_params);
+    m_params_indices.clear();
+    m_depth_sampler_index = VKH_BINDLESS_INVALID_INDEX;
+    m_commands_index = VKH_BINDLESS_INVALID_INDEX;
+    m_count_index = VKH_BINDLESS_INVALID_INDEX;
+
+    // the pipelines belong to the registry.
+    if (m_cull_shader)
+        vkDestroyShaderModule(m_device, m_cull_shader.module, nullptr);
+    if (m_depth_pyramid_shader)
+        vkDestroyShaderModule(m_device, m_depth_pyramid_shader.module, nullptr);
+    m_cull_shader = {};
+    m_depth_pyramid_shader = {};
+
+    m_depth_view = nullptr;
+    m_depth_index = VKH_BINDLESS_INVALID_INDEX;
+}
+
+GPUCullOutput GPUCuller::add_cull_pass(
+    RenderGraph& graph,
+    uint32_t frame_index,
+    GPUCullView const& view,
+    uint32_t objects_index,
+    uint32_t object_count)
+{
+    std::memcpy(m_view_projection, view.view_projection, sizeof(m_view_projection));
+
+    Params params {};
+    std::memcpy(params.prev_view_projection, m_prev_view_projection, sizeof(params.prev_view_projection));
+    extract_frustum_planes(view.view_projection, params.frustum_planes);
+
+    m_frame_pyramid = {};
+    if (view.occlusion && m_pyramid_valid) {
+        m_frame_pyramid = import_depth_pyramid(graph);
+        params.occlusion = 1;
+        params.hiz_mip_count = m_pyramid_mip_count;
+        params.hiz_width = m_pyramid_extent.width;
+        params.hiz_height = m_pyramid_extent.height;
+        std::copy(m_pyramid_indices.begin(), m_pyramid_indices.end(), params.hiz_images);
+    }
+
+    // the slot's previous frame has retired, so its params can be overwritten while recording.
+    auto params_stride = align_up(sizeof(Params), 256);
+    std::memcpy(static_cast<uint8_t*>(m_params.allocation.mapped) + frame_index * params_stride, &params, sizeof(Params));
+
+    // last frame's indirect draws read both buffers, the first barrier has to wait for them.
+    RGImportedBufferInfo commands_info {};
+    commands_info.buffer = m_commands.buffer;
+    commands_info.size = m_commands.size;
+    commands_info.initial_stage = VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT;
+
+    RGImportedBufferInfo count_info {};
+    count_info.buffer = m_count.buffer;
+    count_info.size = m_count.size;
+    count_info.initial_stage = VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT;
+
+    GPUCullOutput output {};
+    output.commands = graph.import_buffer("cull_commands", commands_info);
+    output.count = graph.import_buffer("cull_count", count_info);
+    output.max_draw_count = m_max_draw_count;
+
+    graph.add_pass("cull_clear_count")
+        .use(output.count, RGAccess::TransferWrite)
+        .set_execute([this](RGPassContext& context) {
+            vkCmdFillBuffer(context.get_cmd_buffer(), m_count.buffer, 0, sizeof(uint32_t), 0);
+        });
+
+    CullPushConstants push_constants {};
+    push_constants.params_index = m_params_indices[frame_index];
+    push_constants.objects_index = objects_index;
+    push_constants.object_count = object_count;
+    push_constants.commands_index = m_commands_index;
+    push_constants.count_index = m_count_index;
+    push_constants.max_draw_count = m_max_draw_count;
+
+    auto pass = graph.add_pass("cull");
+    pass.use(output.commands, RGAccess::ComputeStorageWrite).use(output.count, RGAccess::ComputeStorageWrite);
+    if (m_frame_pyramid)
+        pass.use(m_frame_pyramid, RGAccess::ComputeStorageRead);
+
+    pass.set_execute([this, push_constants](RGPassContext& context) {
+        auto cmd_buffer = context.get_cmd_buffer();
+        vkCmdBindPipeline(cmd_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_cull_pipeline.pipeline);
+        m_bindless->push_constants(cmd_buffer, &push_constants, sizeof(push_constants));
+        vkCmdDispatch(cmd_buffer, dispatch_size(push_constants.object_count, 64), 1, 1);
+    });
+
+    return output;
+}
+
+void GPUCuller::add_depth_pyramid_pass(RenderGraph& graph, RGImage depth)
+{
+    auto depth_extent = graph.get_image_extent(depth);
+    VkExtent2D extent { std::max(depth_extent.width / 2, 1u), std::max(depth_extent.height / 2, 1u) };
+
+    auto pyramid = m_frame_pyramid;
+    if (!m_pyramid || extent.width != m_pyramid_extent.width || extent.height != m_pyramid_extent.height) {
+        destroy_depth_pyramid(true);
+        create_depth_pyramid(extent);
+        pyramid = {};
+    }
+
+    if (!pyramid)
+        pyramid = import_depth_pyramid(graph);
+    m_frame_pyramid = {};
+
+    // nothing this frame reads the pyramid, the next frame's cull pass does.
+    graph.add_pass("depth_pyramid")
+        .use(depth, RGAccess::ComputeSampled)
+        .use(pyramid, RGAccess::ComputeStorageWrite)
+        .set_side_effects()
+        .set_execute([this, depth, depth_extent](RGPassContext& context) {
+            auto cmd_buffer = context.get_cmd_buffer();
+
+            // transient depth images may move between frames, the view is only re-registered when it does.
+            auto depth_view = context.get_image_view(depth);
+            if (depth_view != m_depth_view) {
+                m_bindless->remove_sampled_image(m_depth_index);
+                m_depth_index = m_bindless->add_sampled_image(depth_view);
+                m_depth_view = depth_view;
+            }
+
+            vkCmdBindPipeline(cmd_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_depth_pyramid_pipeline.pipeline);
+
+            VkMemoryBarrier2 mip_barrier {};
+            mip_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+            mip_barrier.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+            mip_barrier.srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+            mip_barrier.dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+            mip_barrier.dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT;
+
+            VkDependencyInfo dependency_info {};
+            dependency_info.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+            dependency_info.memoryBarrierCount = 1;
+            dependency_info.pMemoryBarriers = &mip_barrier;
+
+            auto src_extent = depth_extent;
+            for (auto mip { 0u }; mip < m_pyramid_mip_count; mip++) {
+                VkExtent2D dst_extent {
+                    std::max(m_pyramid_extent.width >> mip, 1u),
+                    std::max(m_pyramid_extent.height >> mip, 1u),
+                };
+
+                DepthPyramidPushConstants push_constants {};
+                push_constants.src_index = mip == 0 ? m_depth_index : m_pyramid_indices[mip - 1];
+                push_constants.sampler_index = m_depth_sampler_index;
+                push_constants.dst_index = m_pyramid_indices[mip];
+                push_constants.from_depth = mip == 0;
+                push_constants.src_size[0] = src_extent.width;
+                push_constants.src_size[1] = src_extent.height;
+                push_constants.dst_size[0] = dst_extent.width;
+                push_constants.dst_size[1] = dst_extent.height;
+
+                if (mip > 0)
+                    vkCmdPipelineBarrier2(cmd_buffer, &dependency_info);
+
+                m_bindless->push_constants(cmd_buffer, &push_constants, sizeof(push_constants));
+                vkCmdDispatch(cmd_buffer, dispatch_size(dst_extent.width, 8), dispatch_size(dst_extent.height, 8), 1);
+
+                src_extent = dst_extent;
+            }
+        });
+
+    m_pyramid_valid = true;
+    std::memcpy(m_prev_view_projection, m_view_projection, sizeof(m_prev_view_projection));
+}
+
+void GPUCuller::create_depth_pyramid(VkExtent2D extent)
+{
+    m_pyramid_extent = extent;
+    m_pyramid_mip_count = std::min<uint32_t>(std::bit_width(std::max(extent.width, extent.height)), GPU_CULLER_MAX_HIZ_MIPS);
+
+    VkImageCreateInfo image_create_info {};
+    image_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    image_create_info.imageType = VK_IMAGE_TYPE_2D;
+    image_create_info.format = VK_FORMAT_R32_SFLOAT;
+    image_create_info.extent = { extent.width, extent.height, 1 };
+    image_create_info.mipLevels = m_pyramid_mip_count;
+    image_create_info.arrayLayers = 1;
+    image_create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+    image_create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    image_create_info.usage = VK_IMAGE_USAGE_STORAGE_BIT;
+    image_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    image_create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    m_pyramid = m_allocator->create_image(image_create_info, VKHMemoryUsage::GPUOnly);
+
+    m_pyramid_views.resize(m_pyramid_mip_count);
+    m_pyramid_indices.resize(m_pyramid_mip_count);
+    for (auto mip { 0u }; mip < m_pyramid_mip_count; mip++) {
+        VkImageViewCreateInfo view_create_info {};
+        view_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        view_create_info.image = m_pyramid.image;
+        view_create_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        view_create_info.format = VK_FORMAT_R32_SFLOAT;
+        view_create_info.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, mip, 1, 0, 1 };
+        VK_CHECK(vkCreateImageView(m_device, &view_create_info, nullptr, &m_pyramid_views[mip]));
+
+        m_pyramid_indices[mip] = m_bindless->add_storage_image(m_pyramid_views[mip]);
+    }
+
+    m_pyramid_valid = false;
+}
+
+void GPUCuller::destroy_depth_pyramid(bool deferred)
+{
+    if (!m_pyramid)
+        return;
+
+    for (auto index : m_pyramid_indices)
+        m_bindless->remove_storage_image(index);
+
+    auto destroy = [device = m_device, allocator = m_allocator, image = m_pyramid, views = std::move(m_pyramid_views)]() mutable {
+        for (auto view : views)
+            vkDestroyImageView(device, view, nullptr);
+        allocator->destroy_image(image);
+    };
+
+    if (deferred) {
+        m_defer_destroy(std::move(destroy));
+    } else {
+        destroy();
+    }
+
+    m_pyramid = {};
+    m_pyramid_views.clear();
+    m_pyramid_indices.clear();
+    m_pyramid_valid = false;
+}
+
+RGImage GPUCuller::import_depth_pyramid(RenderGraph& graph)
+{
+    RGImportedImageInfo info {};
+    info.image = m_pyramid.image;
+    info.image_view = m_pyramid_views[0];
+    info.format = VK_FORMAT_R32_SFLOAT;
+    info.extent = m_pyramid_extent;
+
+    // every access to the pyramid is a storage access, so it stays in the general layout between frames.
+    if (m_pyramid_valid) {
+        info.initial_layout = VK_IMAGE_LAYOUT_GENERAL;
+        info.initial_stage = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+        info.initial_access = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+    }
+
+    return graph.import_image("depth_pyramid", info);
+}
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "helper.h"
+#include "render_graph.h"
+#include "vulkan.h"
+#include "vulkan_allocator.h"
+#include "vulkan_bindless.h"
+#include "vulkan_helper.h"
+
+#define GPU_CULLER_MAX_HIZ_MIPS 16
+#define GPU_CULLER_DEFAULT_MAX_DRAW_COUNT 65536
+
+// one entry per drawable, matches CullObject in shaders/cull.comp.
+struct GPUCullObject {
+    float aabb_min[3];
+    uint32_t index_count;
+    float aabb_max[3];
+    uint32_t first_index;
+    int32_t vertex_offset;
+    uint32_t draw_id;
+    uint32_t pad[2];
+};
+
+static_assert(sizeof(GPUCullObject) == 48);
+
+struct GPUCullView {
+    // column-major, the frustum is extracted from it.
+    float view_projection[16];
+
+    bool occlusion { true };
+};
+
+struct GPUCullOutput {
+    // compacted VkDrawIndexedIndirectCommands and their count, read with IndirectRead.
+    RGBuffer commands;
+    RGBuffer count;
+    uint32_t max_draw_count;
+};
+
+struct GPUCullerInfo {
+    VkDevice device;
+    VKHAllocator* allocator;
+    VKHPipelineRegistry* registry;
+    VKHBindlessDescriptors* bindless;
+    std::function<void(std::function<void()>)> defer_destroy;
+    uint32_t frames_in_flight;
+    uint32_t max_draw_count { GPU_CULLER_DEFAULT_MAX_DRAW_COUNT };
+    std::string shader_dir;
+};
+
+// culls objects against the frustum and a depth pyramid of the previous frame on the GPU, writing
+// compacted indirect draws and a count for vkCmdDrawIndexedIndirectCount.
+class GPUCuller {
+    MAKE_NON_COPYABLE(GPUCuller);
+    MAKE_NON_MOVABLE(GPUCuller);
+
+public:
+    GPUCuller() = default;
+
+    // returns false when the shaders could not be loaded, the culler is unusable then.
+    bool init(GPUCullerInfo const& info);
+
+    // the device must be idle.
+    void deinit();
+
+    // objects_index is the bindless storage buffer holding object_count GPUCullObjects.
+    GPUCullOutput add_cull_pass(
+        RenderGraph& graph,
+        uint32_t frame_index,
+        GPUCullView const& view,
+        uint32_t objects_index,
+        uint32_t object_count);
+
+    // builds the depth pyramid the next frame's cull pass tests against. depth must be sampleable.
+    void add_depth_pyramid_pass(RenderGraph& graph, RGImage depth);
+
+    uint32_t get_max_draw_count() const { return m_max_draw_count; }
+
+private:
+    struct Params {
+        float prev_view_projection[16];
+        float frustum_planes[6][4];
+        uint32_t hiz_images[GPU_CULLER_MAX_HIZ_MIPS];
+        uint32_t hiz_mip_count;
+        uint32_t hiz_width;
+        uint32_t hiz_height;
+        uint32_t occlusion;
+    };
+
+    struct CullPushConstants {
+        uint32_t params_index;
+        uint32_t objects_index;
+        uint32_t object_count;
+        uint32_t commands_index;
+        uint32_t count_index;
+        uint32_t max_draw_count;
+    };
+
+    struct DepthPyramidPushConstants {
+        uint32_t src_index;
+        uint32_t sampler_index;
+        uint32_t dst_index;
+        uint32_t from_depth;
+        uint32_t src_size[2];
+        uint32_t dst_size[2];
+    };
+
+    void create_depth_pyramid(VkExtent2D depth_extent);
+
+    void destroy_depth_pyramid(bool deferred);
+
+    RGImage import_depth_pyramid(RenderGraph& graph);
+
+private:
+    VkDevice m_device { nullptr };
+    VKHAllocator* m_allocator { nullptr };
+    VKHBindlessDescriptors* m_bindless { nullptr };
+    std::function<void(std::function<void()>)> m_defer_destroy;
+    uint32_t m_max_draw_count {};
+
+    VKHShaderModule m_cull_shader {};
+    VKHShaderModule m_depth_pyramid_shader {};
+    VKHPipeline m_cull_pipeline;
+    VKHPipeline m_depth_pyramid_pipeline;
+
+    VKHBuffer m_commands;
+    VKHBuffer m_count;
+    uint32_t m_commands_index { VKH_BINDLESS_INVALID_INDEX };
+    uint32_t m_count_index { VKH_BINDLESS_INVALID_INDEX };
+
+    // one slot per frame in flight, written by the CPU while recording.
+    VKHBuffer m_params;
+    std::vector<uint32_t> m_params_indices;
+
+    VkSampler m_depth_sampler { nullptr };
+    uint32_t m_depth_sampler_index { VKH_BINDLESS_INVALID_INDEX };
+    VkImageView m_depth_view { nullptr };
+    uint32_t m_depth_index { VKH_BINDLESS_INVALID_INDEX };
+
+    VKHImage m_pyramid;
+    VkExtent2D m_pyramid_extent {};
+    uint32_t m_pyramid_mip_count {};
+    std::vector<VkImageView> m_pyramid_views;
+    std::vector<uint32_t> m_pyramid_indices;
+
+    // the pyramid holds a complete depth pyramid, rather than undefined contents.
+    bool m_pyramid_valid { false };
+
+    // the pyramid is imported once per graph, by whichever pass of the frame comes first.
+    RGImage m_frame_pyramid;
+    float m_view_projection[16] {};
+    float m_prev_view_projection[16] {};
+};
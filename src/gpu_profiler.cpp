@@ -0,0 +1,257 @@
+#include <algorithm>
+#include <cmath>
+
+#include "gpu_profiler.h"
+#include "vulkan_helper.h"
+
+#define GPU_PROFILER_INVALID_SCOPE UINT32_MAX
+
+void GPUProfiler::init(GPUProfilerInfo const& info)
+{
+    m_device = info.device;
+
+    VkPhysicalDeviceProperties properties {};
+    vkGetPhysicalDeviceProperties(info.physical_device, &properties);
+
+    uint32_t queue_family_count {};
+    vkGetPhysicalDeviceQueueFamilyProperties(info.physical_device, &queue_family_count, nullptr);
+    std::vector<VkQueueFamilyProperties> queue_families(queue_family_count);
+    vkGetPhysicalDeviceQueueFamilyProperties(info.physical_device, &queue_family_count, queue_families.data());
+
+    auto valid_bits = queue_families[info.queue_family].timestampValidBits;
+
+    m_timestamps_enabled = info.enable_timestamps && valid_bits != 0 && properties.limits.timestampPeriod > 0.0f;
+    m_statistics_enabled = info.enable_pipeline_statistics;
+    m_timestamp_period_ns = properties.limits.timestampPeriod;
+    m_timestamp_mask = valid_bits >= 64 ? ~0ull : (1ull << valid_bits) - 1;
+
+    m_frames.resize(info.frames_in_flight);
+    m_query_results.resize(GPU_PROFILER_MAX_QUERIES_PER_FRAME);
+
+    for (auto& frame : m_frames) {
+        if (m_timestamps_enabled) {
+            VkQueryPoolCreateInfo create_info {};
+            create_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+            create_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+            create_info.queryCount = GPU_PROFILER_MAX_QUERIES_PER_FRAME;
+
+            VK_CHECK(vkCreateQueryPool(m_device, &create_info, nullptr, &frame.timestamp_pool));
+        }
+
+        if (m_statistics_enabled) {
+            VkQueryPoolCreateInfo create_info {};
+            create_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+            create_info.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+            create_info.queryCount = 1;
+            create_info.pipelineStatistics = VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT
+                | VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT
+                | VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT
+                | VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT
+                | VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT
+                | VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT
+                | VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+
+            VK_CHECK(vkCreateQueryPool(m_device, &create_info, nullptr, &frame.statistics_pool));
+        }
+    }
+}
+
+void GPUProfiler::deinit()
+{
+    for (auto& frame : m_frames) {
+        if (frame.timestamp_pool)
+            vkDestroyQueryPool(m_device, frame.timestamp_pool, nullptr);
+        if (frame.statistics_pool)
+            vkDestroyQueryPool(m_device, frame.statistics_pool, nullptr);
+    }
+
+    m_frames.clear();
+    m_histories.clear();
+    m_history_indices.clear();
+}
+
+void GPUProfiler::collect(uint32_t frame_index)
+{
+    auto& frame = m_frames[frame_index];
+    if (!frame.pending)
+        return;
+
+    frame.pending = false;
+
+    if (m_timestamps_enabled && frame.query_count > 0) {
+        auto result = vkGetQueryPoolResults(
+            m_device,
+            frame.timestamp_pool,
+            0, frame.query_count,
+            frame.query_count * sizeof(uint64_t), m_query_results.data(),
+            sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+
+        if (result == VK_SUCCESS) {
+            for (auto const& scope : frame.scopes) {
+                auto begin = m_query_results[scope.begin_query] & m_timestamp_mask;
+                auto end = m_query_results[scope.end_query] & m_timestamp_mask;
+                auto ticks = (end - begin) & m_timestamp_mask;
+                record_sample(scope.name, static_cast<double>(ticks) * m_timestamp_period_ns / 1e6);
+            }
+        } else if (result != VK_NOT_READY) {
+            VK_CHECK(result);
+        }
+    }
+
+    if (m_statistics_enabled && frame.statistics_recorded) {
+        uint64_t statistics[7] {};
+        auto result = vkGetQueryPoolResults(
+            m_device,
+            frame.statistics_pool,
+            0, 1,
+            sizeof(statistics), statistics,
+            sizeof(statistics), VK_QUERY_RESULT_64_BIT);
+
+        if (result == VK_SUCCESS) {
+            m_last_statistics = {
+                statistics[0], statistics[1], statistics[2], statistics[3],
+                statistics[4], statistics[5], statistics[6]
+            };
+        } else if (result != VK_NOT_READY) {
+            VK_CHECK(result);
+        }
+    }
+}
+
+void GPUProfiler::begin_frame(VkCommandBuffer cmd_buffer, uint32_t frame_index)
+{
+    auto& frame = m_frames[frame_index];
+    frame.scopes.clear();
+    frame.open_scopes.clear();
+    frame.query_count = 0;
+    frame.statistics_recorded = false;
+    frame.statistics_active = false;
+    frame.pending = true;
+
+    if (m_timestamps_enabled)
+        vkCmdResetQueryPool(cmd_buffer, frame.timestamp_pool, 0, GPU_PROFILER_MAX_QUERIES_PER_FRAME);
+
+    if (m_statistics_enabled)
+        vkCmdResetQueryPool(cmd_buffer, frame.statistics_pool, 0, 1);
+
+    push_scope(cmd_buffer, frame_index, "frame");
+}
+
+void GPUProfiler::end_frame(VkCommandBuffer cmd_buffer, uint32_t frame_index)
+{
+    auto& frame = m_frames[frame_index];
+    while (!frame.open_scopes.empty())
+        pop_scope(cmd_buffer, frame_index);
+}
+
+void GPUProfiler::push_scope(VkCommandBuffer cmd_buffer, uint32_t frame_index, std::string_view name)
+{
+    if (!m_timestamps_enabled)
+        return;
+
+    auto& frame = m_frames[frame_index];
+    if (frame.query_count + 2 > GPU_PROFILER_MAX_QUERIES_PER_FRAME) {
+        frame.open_scopes.push_back(GPU_PROFILER_INVALID_SCOPE);
+        return;
+    }
+
+    auto begin_query = frame.query_count;
+    frame.query_count += 2;
+
+    vkCmdWriteTimestamp2(cmd_buffer, VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT, frame.timestamp_pool, begin_query);
+
+    frame.open_scopes.push_back(frame.scopes.size());
+    frame.scopes.push_back({ std::string(name), begin_query, begin_query + 1 });
+}
+
+void GPUProfiler::pop_scope(VkCommandBuffer cmd_buffer, uint32_t frame_index)
+{
+    if (!m_timestamps_enabled)
+        return;
+
+    auto& frame = m_frames[frame_index];
+    if (frame.open_scopes.empty())
+        return;
+
+    auto scope = frame.open_scopes.back();
+    frame.open_scopes.pop_back();
+
+    if (scope == GPU_PROFILER_INVALID_SCOPE)
+        return;
+
+    vkCmdWriteTimestamp2(cmd_buffer, VK_PIPELINE_STAGE_2_BOTTOM_OF_PIPE_BIT, frame.timestamp_pool, frame.scopes[scope].end_query);
+}
+
+void GPUProfiler::begin_pipeline_statistics(VkCommandBuffer cmd_buffer, uint32_t frame_index)
+{
+    if (!m_statistics_enabled)
+        return;
+
+    auto& frame = m_frames[frame_index];
+    if (frame.statistics_recorded || frame.statistics_active)
+        return;
+
+    vkCmdBeginQuery(cmd_buffer, frame.statistics_pool, 0, 0);
+    frame.statistics_active = true;
+}
+
+void GPUProfiler::end_pipeline_statistics(VkCommandBuffer cmd_buffer, uint32_t frame_index)
+{
+    if (!m_statistics_enabled)
+        return;
+
+    auto& frame = m_frames[frame_index];
+    if (!frame.statistics_active)
+        return;
+
+    vkCmdEndQuery(cmd_buffer, frame.statistics_pool, 0);
+    frame.statistics_active = false;
+    frame.statistics_recorded = true;
+}
+
+std::vector<GPUScopeTiming> GPUProfiler::get_timings() const
+{
+    std::vector<GPUScopeTiming> timings;
+    timings.reserve(m_histories.size());
+
+    std::vector<double> sorted;
+    for (auto const& history : m_histories) {
+        if (history.samples.empty())
+            continue;
+
+        sorted.assign(history.samples.begin(), history.samples.end());
+        std::sort(sorted.begin(), sorted.end());
+
+        double sum { 0.0 };
+        for (auto sample : sorted)
+            sum += sample;
+
+        auto p99_index = static_cast<size_t>(std::ceil(0.99 * sorted.size())) - 1;
+
+        GPUScopeTiming timing {};
+        timing.name = history.name;
+        timing.min_ms = sorted.front();
+        timing.avg_ms = sum / sorted.size();
+        timing.p99_ms = sorted[p99_index];
+        timing.sample_count = sorted.size();
+        timings.push_back(std::move(timing));
+    }
+
+    return timings;
+}
+
+void GPUProfiler::record_sample(std::string const& name, double ms)
+{
+    auto [it, inserted] = m_history_indices.try_emplace(name, m_histories.size());
+    if (inserted)
+        m_histories.push_back({ name, {}, 0 });
+
+    auto& history = m_histories[it->second];
+    if (history.samples.size() < GPU_PROFILER_HISTORY_SIZE) {
+        history.samples.push_back(ms);
+    } else {
+        history.samples[history.next] = ms;
+    }
+
+    history.next = (history.next + 1) % GPU_PROFILER_HISTORY_SIZE;
+}
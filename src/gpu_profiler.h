@@ -0,0 +1,117 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "helper.h"
+#include "vulkan.h"
+
+#define GPU_PROFILER_MAX_QUERIES_PER_FRAME 256
+#define GPU_PROFILER_HISTORY_SIZE 256
+
+struct GPUScopeTiming {
+    std::string name;
+    double min_ms;
+    double avg_ms;
+    double p99_ms;
+    uint32_t sample_count;
+};
+
+struct GPUPipelineStatistics {
+    uint64_t input_assembly_vertices;
+    uint64_t input_assembly_primitives;
+    uint64_t vertex_shader_invocations;
+    uint64_t clipping_invocations;
+    uint64_t clipping_primitives;
+    uint64_t fragment_shader_invocations;
+    uint64_t compute_shader_invocations;
+};
+
+struct GPUProfilerInfo {
+    VkPhysicalDevice physical_device;
+    VkDevice device;
+    uint32_t queue_family;
+    uint32_t frames_in_flight;
+    bool enable_timestamps;
+    bool enable_pipeline_statistics;
+};
+
+class GPUProfiler {
+    MAKE_NON_COPYABLE(GPUProfiler);
+    MAKE_NON_MOVABLE(GPUProfiler);
+
+public:
+    GPUProfiler() = default;
+
+    void init(GPUProfilerInfo const& info);
+
+    void deinit();
+
+    // reads back the queries recorded the last time this frame slot was used, must only
+    // be called once the frame's previous submission is known to be complete.
+    void collect(uint32_t frame_index);
+
+    void begin_frame(VkCommandBuffer cmd_buffer, uint32_t frame_index);
+
+    void end_frame(VkCommandBuffer cmd_buffer, uint32_t frame_index);
+
+    void push_scope(VkCommandBuffer cmd_buffer, uint32_t frame_index, std::string_view name);
+
+    void pop_scope(VkCommandBuffer cmd_buffer, uint32_t frame_index);
+
+    void begin_pipeline_statistics(VkCommandBuffer cmd_buffer, uint32_t frame_index);
+
+    void end_pipeline_statistics(VkCommandBuffer cmd_buffer, uint32_t frame_index);
+
+    std::vector<GPUScopeTiming> get_timings() const;
+
+    GPUPipelineStatistics get_pipeline_statistics() const { return m_last_statistics; }
+
+    bool timestamps_enabled() const { return m_timestamps_enabled; }
+
+    bool pipeline_statistics_enabled() const { return m_statistics_enabled; }
+
+private:
+    struct Scope {
+        std::string name;
+        uint32_t begin_query;
+        uint32_t end_query;
+    };
+
+    struct FrameQueries {
+        VkQueryPool timestamp_pool { nullptr };
+        VkQueryPool statistics_pool { nullptr };
+        std::vector<Scope> scopes;
+        std::vector<uint32_t> open_scopes;
+        uint32_t query_count { 0 };
+        bool statistics_recorded { false };
+        bool statistics_active { false };
+        bool pending { false };
+    };
+
+    struct ScopeHistory {
+        std::string name;
+        std::vector<double> samples;
+        uint32_t next { 0 };
+    };
+
+    void record_sample(std::string const& name, double ms);
+
+private:
+    std::vector<FrameQueries> m_frames;
+    std::vector<uint64_t> m_query_results;
+
+    std::vector<ScopeHistory> m_histories;
+    std::unordered_map<std::string, uint32_t> m_history_indices;
+
+    GPUPipelineStatistics m_last_statistics {};
+
+    double m_timestamp_period_ns { 1.0 };
+    uint64_t m_timestamp_mask { ~0ull };
+
+    VkDevice m_device { nullptr };
+    bool m_timestamps_enabled { false };
+    bool m_statistics_enabled { false };
+};
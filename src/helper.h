@@ -1,5 +1,7 @@
 #pragma once
 
+#include <utility>
+
 #define MAKE_NON_COPYABLE(__TYPE__)     \
     __TYPE__(const __TYPE__&) = delete; \
     __TYPE__& operator=(const __TYPE__&) = delete;
@@ -7,3 +9,21 @@
 #define MAKE_NON_MOVABLE(__TYPE__) \
     __TYPE__(__TYPE__&&) = delete; \
     __TYPE__& operator=(__TYPE__&&) = delete;
+
+// calls fn when it goes out of scope, so early returns tear down whatever was set up before them.
+template<typename F>
+class ScopeGuard {
+    MAKE_NON_COPYABLE(ScopeGuard);
+    MAKE_NON_MOVABLE(ScopeGuard);
+
+public:
+    explicit ScopeGuard(F fn)
+        : m_fn(std::move(fn))
+    {
+    }
+
+    ~ScopeGuard() { m_fn(); }
+
+private:
+    F m_fn;
+};
@@ -0,0 +1,56 @@
+#include <cstring>
+
+#include "indirect_draw.h"
+
+namespace {
+
+template <typename T>
+FrameRingAllocation write_commands(std::vector<T> const& commands, FrameRing& ring, uint32_t frame_index)
+{
+    if (commands.empty())
+        return {};
+
+    auto size = commands.size() * sizeof(T);
+    auto allocation = ring.allocate(frame_index, size);
+    if (allocation)
+        std::memcpy(allocation.data, commands.data(), size);
+    return allocation;
+}
+
+}
+
+void IndirectDrawBuilder::add(uint32_t vertex_count, uint32_t instance_count, uint32_t first_vertex, uint32_t first_instance)
+{
+    VkDrawIndirectCommand command {};
+    command.vertexCount = vertex_count;
+    command.instanceCount = instance_count;
+    command.firstVertex = first_vertex;
+    command.firstInstance = first_instance;
+    m_commands.push_back(command);
+}
+
+void IndirectDrawBuilder::add_indexed(
+    uint32_t index_count,
+    uint32_t instance_count,
+    uint32_t first_index,
+    int32_t vertex_offset,
+    uint32_t first_instance)
+{
+    VkDrawIndexedIndirectCommand command {};
+    command.indexCount = index_count;
+    command.instanceCount = instance_count;
+    command.firstIndex = first_index;
+    command.vertexOffset = vertex_offset;
+    command.firstInstance = first_instance;
+    m_indexed_commands.push_back(command);
+}
+
+FrameRingAllocation IndirectDrawBuilder::write(FrameRing& ring, uint32_t frame_index) const
+{
+    return write_commands(m_commands, ring, frame_index);
+}
+
+FrameRingAllocation IndirectDrawBuilder::write_indexed(FrameRing& ring, uint32_t frame_index) const
+{
+    return write_commands(m_indexed_commands, ring, frame_index);
+}
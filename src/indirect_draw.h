@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "frame_ring.h"
+#include "vulkan.h"
+
+// collects draws on the CPU and packs them into one indirect command buffer, indexed and non-indexed
+// draws are kept apart and issued by separate calls. clear() keeps the storage, so a builder reused every
+// frame stops allocating once it has seen the largest scene.
+class IndirectDrawBuilder {
+public:
+    IndirectDrawBuilder() = default;
+
+    void reserve(uint32_t draw_count) { m_commands.reserve(draw_count); }
+
+    void reserve_indexed(uint32_t draw_count) { m_indexed_commands.reserve(draw_count); }
+
+    void clear()
+    {
+        m_commands.clear();
+        m_indexed_commands.clear();
+    }
+
+    // first_instance doubles as the draw id, shaders use gl_BaseInstance or gl_InstanceIndex to find per-draw data.
+    void add(uint32_t vertex_count, uint32_t instance_count, uint32_t first_vertex, uint32_t first_instance);
+
+    void add_indexed(
+        uint32_t index_count,
+        uint32_t instance_count,
+        uint32_t first_index,
+        int32_t vertex_offset,
+        uint32_t first_instance);
+
+    uint32_t get_draw_count() const { return static_cast<uint32_t>(m_commands.size()); }
+
+    uint32_t get_indexed_draw_count() const { return static_cast<uint32_t>(m_indexed_commands.size()); }
+
+    bool is_empty() const { return m_commands.empty() && m_indexed_commands.empty(); }
+
+    // copy the commands into this frame's ring, empty when there are none or the ring overflowed.
+    FrameRingAllocation write(FrameRing& ring, uint32_t frame_index) const;
+
+    FrameRingAllocation write_indexed(FrameRing& ring, uint32_t frame_index) const;
+
+private:
+    std::vector<VkDrawIndirectCommand> m_commands;
+    std::vector<VkDrawIndexedIndirectCommand> m_indexed_commands;
+};
@@ -0,0 +1,324 @@
+#include <algorithm>
+#include <chrono>
+
+#include "job_subsystem.h"
+
+namespace {
+
+// UINT32_MAX on threads the subsystem does not own, the main thread included.
+thread_local uint32_t t_worker_index { UINT32_MAX };
+
+}
+
+Subsystem::InitResult<void> JobSubsystem::init(uint32_t worker_count)
+{
+    if (m_initialized)
+        return MAKE_SUBSYSTEM_INIT_SUCCESS();
+
+    if (worker_count == 0)
+        worker_count = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+
+    m_main_thread_id = std::this_thread::get_id();
+    m_worker_count = worker_count;
+    m_background_limit = worker_count - 1;
+    m_stopping = false;
+
+    m_workers = std::make_unique<Worker[]>(m_worker_count);
+    for (auto i { 0u }; i < m_worker_count; i++)
+        m_workers[i].thread = std::thread([this, i] { worker_loop(i); });
+
+    m_initialized = true;
+    return MAKE_SUBSYSTEM_INIT_SUCCESS();
+}
+
+void JobSubsystem::deinit()
+{
+    if (!m_initialized)
+        return;
+
+    {
+        std::lock_guard lock(m_sleep_mutex);
+        m_stopping = true;
+    }
+    m_sleep_condition.notify_all();
+
+    for (auto i { 0u }; i < m_worker_count; i++)
+        m_workers[i].thread.join();
+
+    m_workers.reset();
+    m_worker_count = 0;
+
+    run_main_thread_jobs();
+
+    m_initialized = false;
+}
+
+void JobSubsystem::submit(std::function<void()> job, JobPriority priority, JobCounter* counter)
+{
+    if (counter)
+        add_to_counter(*counter, priority);
+
+    push({ std::move(job), counter }, priority);
+}
+
+void JobSubsystem::submit_after(JobCounter& dependency, std::function<void()> job, JobPriority priority, JobCounter* counter)
+{
+    if (counter)
+        add_to_counter(*counter, priority);
+
+    // finish() drops the count under the same mutex, so the continuation is either queued here or picked up there.
+    {
+        std::lock_guard lock(dependency.m_mutex);
+        if (dependency.m_value.load(std::memory_order_acquire) != 0) {
+            dependency.m_continuations.push_back({ std::move(job), priority, counter });
+            return;
+        }
+    }
+
+    push({ std::move(job), counter }, priority);
+}
+
+void JobSubsystem::submit_main(std::function<void()> job)
+{
+    std::lock_guard lock(m_main_mutex);
+    m_main_jobs.push_back(std::move(job));
+}
+
+void JobSubsystem::run_main_thread_jobs()
+{
+    if (!is_main_thread()) {
+        fmt::println(stderr, "JobSubsystem::run_main_thread_jobs(): called off the main thread!");
+        return;
+    }
+
+    std::vector<std::function<void()>> jobs;
+    {
+        std::lock_guard lock(m_main_mutex);
+        jobs.swap(m_main_jobs);
+    }
+
+    for (auto& job : jobs)
+        job();
+}
+
+void JobSubsystem::wait(JobCounter& counter)
+{
+    auto lowest = static_cast<JobPriority>(counter.m_priority.load(std::memory_order_relaxed));
+    if (lowest == JobPriority::Background && is_main_thread())
+        lowest = JobPriority::Normal;
+
+    while (!counter.is_done()) {
+        if (try_run_one(lowest))
+            continue;
+
+        // the job may be running on another worker, check back regularly in case more work gets queued.
+        std::unique_lock lock(counter.m_mutex);
+        counter.m_condition.wait_for(lock, std::chrono::microseconds(100), [&] { return counter.is_done(); });
+    }
+
+    // the last finish() may still hold the mutex, the counter must outlive it.
+    std::lock_guard lock(counter.m_mutex);
+}
+
+void JobSubsystem::parallel_for(uint32_t count, std::function<void(uint32_t)> const& fn, JobPriority priority)
+{
+    if (count == 0)
+        return;
+
+    std::atomic<uint32_t> next { 0 };
+    auto run = [&] {
+        for (auto i = next.fetch_add(1); i < count; i = next.fetch_add(1))
+            fn(i);
+    };
+
+    // helpers that start after every index was claimed return right away.
+    JobCounter counter;
+    auto helper_count = std::min(count - 1, m_worker_count);
+    for (auto i { 0u }; i < helper_count; i++)
+        submit(run, priority, &counter);
+
+    run();
+    wait(counter);
+}
+
+void JobSubsystem::push(Job job, JobPriority priority)
+{
+    if (m_worker_count == 0) {
+        fmt::println(stderr, "JobSubsystem::push(): job submitted while not initialized, dropping it!");
+        if (job.counter)
+            finish(*job.counter);
+        return;
+    }
+
+    auto index = t_worker_index;
+    if (index == UINT32_MAX)
+        index = m_next_worker.fetch_add(1, std::memory_order_relaxed) % m_worker_count;
+
+    auto& worker = m_workers[index];
+    {
+        std::lock_guard lock(worker.mutex);
+        worker.queues[static_cast<uint32_t>(priority)].push_back(std::move(job));
+    }
+
+    m_queued[static_cast<uint32_t>(priority)].fetch_add(1);
+
+    if (m_sleeping.load() > 0) {
+        std::lock_guard lock(m_sleep_mutex);
+        m_sleep_condition.notify_one();
+    }
+}
+
+void JobSubsystem::add_to_counter(JobCounter& counter, JobPriority priority)
+{
+    counter.m_value.fetch_add(1, std::memory_order_relaxed);
+
+    auto value = static_cast<uint32_t>(priority);
+    auto current = counter.m_priority.load(std::memory_order_relaxed);
+    while (current < value && !counter.m_priority.compare_exchange_weak(current, value, std::memory_order_relaxed)) { }
+}
+
+bool JobSubsystem::try_pop(JobPriority priority, Job& job)
+{
+    auto queue_index = static_cast<uint32_t>(priority);
+    if (m_queued[queue_index].load() == 0)
+        return false;
+
+    auto self = t_worker_index;
+    if (self != UINT32_MAX) {
+        auto& worker = m_workers[self];
+        std::lock_guard lock(worker.mutex);
+
+        auto& queue = worker.queues[queue_index];
+        if (!queue.empty()) {
+            job = std::move(queue.back());
+            queue.pop_back();
+            m_queued[queue_index].fetch_sub(1);
+            return true;
+        }
+    }
+
+    auto start = self != UINT32_MAX ? self + 1 : 0;
+    for (auto i { 0u }; i < m_worker_count; i++) {
+        auto victim = (start + i) % m_worker_count;
+        if (victim == self)
+            continue;
+
+        auto& worker = m_workers[victim];
+        std::lock_guard lock(worker.mutex);
+
+        auto& queue = worker.queues[queue_index];
+        if (!queue.empty()) {
+            job = std::move(queue.front());
+            queue.pop_front();
+            m_queued[queue_index].fetch_sub(1);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool JobSubsystem::try_run_one(JobPriority lowest)
+{
+    Job job;
+    for (auto priority : { JobPriority::High, JobPriority::Normal }) {
+        if (priority > lowest)
+            return false;
+
+        if (try_pop(priority, job)) {
+            run(job, priority);
+            return true;
+        }
+    }
+
+    if (lowest != JobPriority::Background || m_queued[static_cast<uint32_t>(JobPriority::Background)].load() == 0)
+        return false;
+
+    // claims a background slot before popping, so the limit holds with many workers racing for it.
+    auto running = m_running_background.fetch_add(1);
+    if ((can_start_background(running) || m_stopping) && try_pop(JobPriority::Background, job)) {
+        run(job, JobPriority::Background);
+        return true;
+    }
+
+    m_running_background.fetch_sub(1);
+    return false;
+}
+
+bool JobSubsystem::can_start_background(uint32_t running) const
+{
+    // a single worker has just found nothing more urgent, which is as idle as it gets.
+    return running < m_background_limit || (m_background_limit == 0 && running == 0);
+}
+
+void JobSubsystem::run(Job& job, JobPriority priority)
+{
+    job.fn();
+
+    if (priority == JobPriority::Background) {
+        m_running_background.fetch_sub(1);
+
+        // a worker may have gone to sleep on a background job it was not allowed to take.
+        if (m_queued[static_cast<uint32_t>(JobPriority::Background)].load() > 0 && m_sleeping.load() > 0) {
+            std::lock_guard lock(m_sleep_mutex);
+            m_sleep_condition.notify_one();
+        }
+    }
+
+    if (job.counter)
+        finish(*job.counter);
+}
+
+void JobSubsystem::finish(JobCounter& counter)
+{
+    std::vector<JobCounter::Continuation> continuations;
+    {
+        std::lock_guard lock(counter.m_mutex);
+        if (counter.m_value.fetch_sub(1, std::memory_order_acq_rel) != 1)
+            return;
+
+        continuations.swap(counter.m_continuations);
+        counter.m_condition.notify_all();
+    }
+
+    for (auto& continuation : continuations)
+        push({ std::move(continuation.fn), continuation.counter }, continuation.priority);
+}
+
+bool JobSubsystem::has_runnable_work() const
+{
+    if (m_queued[static_cast<uint32_t>(JobPriority::High)].load() > 0)
+        return true;
+    if (m_queued[static_cast<uint32_t>(JobPriority::Normal)].load() > 0)
+        return true;
+
+    return m_queued[static_cast<uint32_t>(JobPriority::Background)].load() > 0
+        && can_start_background(m_running_background.load());
+}
+
+void JobSubsystem::worker_loop(uint32_t worker_index)
+{
+    t_worker_index = worker_index;
+
+    while (true) {
+        if (try_run_one(JobPriority::Background))
+            continue;
+
+        std::unique_lock lock(m_sleep_mutex);
+        m_sleeping.fetch_add(1);
+        m_sleep_condition.wait(lock, [this] { return m_stopping || has_runnable_work(); });
+        m_sleeping.fetch_sub(1);
+
+        if (!m_stopping)
+            continue;
+
+        lock.unlock();
+
+        // queued jobs still run, deinit() only returns once every deque drained.
+        auto queued { 0u };
+        for (auto const& count : m_queued)
+            queued += count.load();
+        if (queued == 0)
+            return;
+    }
+}
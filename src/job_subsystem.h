@@ -0,0 +1,159 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "helper.h"
+#include "subsystem.h"
+
+enum class JobPriority {
+    // work the current frame waits on, e.g. parallel command recording.
+    High,
+    Normal,
+    // streaming, generation and IO. never occupies every worker, so high priority work finds a core. with a
+    // single worker it only starts while nothing else is queued. never runs on the main thread.
+    Background,
+    Count,
+};
+
+#define JOB_PRIORITY_COUNT static_cast<uint32_t>(JobPriority::Count)
+
+// counts unfinished jobs. jobs submitted with a counter keep it above zero until they returned,
+// continuations submitted after it run once it drops to zero.
+class JobCounter {
+    MAKE_NON_COPYABLE(JobCounter);
+    MAKE_NON_MOVABLE(JobCounter);
+
+public:
+    JobCounter() = default;
+
+    bool is_done() const { return m_value.load(std::memory_order_acquire) == 0; }
+
+private:
+    friend class JobSubsystem;
+
+    struct Continuation {
+        std::function<void()> fn;
+        JobPriority priority;
+        JobCounter* counter;
+    };
+
+    std::atomic<uint32_t> m_value { 0 };
+
+    // the least urgent priority any of its jobs was submitted with, waiting only helps with those and more urgent ones.
+    std::atomic<uint32_t> m_priority { 0 };
+
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::vector<Continuation> m_continuations;
+};
+
+// a work-stealing pool shared by everything that runs off the main thread. every worker owns one deque
+// per priority, pops its own newest job and steals the oldest job of another worker when it runs dry.
+class JobSubsystem {
+    MAKE_NON_COPYABLE(JobSubsystem);
+    MAKE_NON_MOVABLE(JobSubsystem);
+
+public:
+    static JobSubsystem* instance()
+    {
+        static JobSubsystem instance;
+        return &instance;
+    }
+
+    // 0 uses every core but the main thread's. must be called from the main thread.
+    Subsystem::InitResult<void> init(uint32_t worker_count = 0);
+
+    // runs every job that is still queued, then joins the workers.
+    void deinit();
+
+    void submit(std::function<void()> job, JobPriority priority = JobPriority::Normal, JobCounter* counter = nullptr);
+
+    // queues job once dependency is done, right away when it already is.
+    void submit_after(
+        JobCounter& dependency,
+        std::function<void()> job,
+        JobPriority priority = JobPriority::Normal,
+        JobCounter* counter = nullptr);
+
+    // for work that must happen on the main thread, like GLFW calls. runs in run_main_thread_jobs().
+    void submit_main(std::function<void()> job);
+
+    void run_main_thread_jobs();
+
+    // runs queued jobs on the calling thread while the counter is not done, only ones at least as urgent as
+    // the counter's own and never background ones on the main thread, so a frame does not stall on IO.
+    void wait(JobCounter& counter);
+
+    // calls fn(i) for every i in [0, count) on the workers and the calling thread, returns once all of
+    // them have finished. at most get_worker_count() + 1 calls run at the same time.
+    void parallel_for(uint32_t count, std::function<void(uint32_t)> const& fn, JobPriority priority = JobPriority::High);
+
+    uint32_t get_worker_count() const { return m_worker_count; }
+
+    bool is_main_thread() const { return std::this_thread::get_id() == m_main_thread_id; }
+
+private:
+    JobSubsystem() = default;
+
+    struct Job {
+        std::function<void()> fn;
+        JobCounter* counter;
+    };
+
+    struct Worker {
+        std::thread thread;
+        std::mutex mutex;
+        std::deque<Job> queues[JOB_PRIORITY_COUNT];
+    };
+
+    void push(Job job, JobPriority priority);
+
+    void add_to_counter(JobCounter& counter, JobPriority priority);
+
+    // the calling thread's own deque first, newest job, then the oldest job of every other worker.
+    bool try_pop(JobPriority priority, Job& job);
+
+    // highest priority first down to lowest, background only while below the background limit.
+    bool try_run_one(JobPriority lowest);
+
+    bool can_start_background(uint32_t running) const;
+
+    void run(Job& job, JobPriority priority);
+
+    void finish(JobCounter& counter);
+
+    bool has_runnable_work() const;
+
+    void worker_loop(uint32_t worker_index);
+
+private:
+    std::unique_ptr<Worker[]> m_workers;
+    uint32_t m_worker_count {};
+    std::atomic<uint32_t> m_next_worker { 0 };
+
+    std::atomic<uint32_t> m_queued[JOB_PRIORITY_COUNT] {};
+    std::atomic<uint32_t> m_running_background { 0 };
+
+    // every worker but one, 0 with a single worker, which then only starts background jobs when idle.
+    uint32_t m_background_limit {};
+
+    // idle workers sleep here, submitters only take the mutex when someone sleeps.
+    std::mutex m_sleep_mutex;
+    std::condition_variable m_sleep_condition;
+    std::atomic<uint32_t> m_sleeping { 0 };
+    std::atomic<bool> m_stopping { false };
+
+    std::mutex m_main_mutex;
+    std::vector<std::function<void()>> m_main_jobs;
+    std::thread::id m_main_thread_id;
+
+    bool m_initialized { false };
+};
@@ -0,0 +1,307 @@
+#include <algorithm>
+#include <array>
+
+#include "lod_terrain.h"
+
+void LodTerrain::init(LodTerrainInfo const& info)
+{
+    m_generator = info.generator;
+    m_mesher = info.mesher;
+    m_upload_service = info.upload_service;
+    m_jobs = info.jobs;
+    m_near_distance = info.near_distance;
+    m_max_builds_per_update = std::max(info.max_builds_per_update, 1u);
+    m_culler.init({ info.jobs });
+}
+
+void LodTerrain::deinit()
+{
+    for (auto& [key, cell] : m_cells)
+        destroy(cell);
+
+    m_cells.clear();
+    m_selected.clear();
+    m_missing.clear();
+    m_culler.clear();
+    m_box_owners.clear();
+    m_has_camera = false;
+}
+
+void LodTerrain::update(ChunkPosition camera)
+{
+    if (!m_has_camera || camera != m_camera) {
+        m_camera = camera;
+        m_has_camera = true;
+
+        // the coarsest cells within reach, each split down as far as the camera is close to it.
+        auto reach = static_cast<int32_t>(get_view_distance());
+        auto shift = LOD_LEVEL_COUNT;
+        m_selected.clear();
+        for (auto z = (camera.z - reach) >> shift; z <= (camera.z + reach) >> shift; z++) {
+            for (auto x = (camera.x - reach) >> shift; x <= (camera.x + reach) >> shift; x++) {
+                LodCellKey key { LOD_LEVEL_COUNT, x, z };
+                if (get_distance(key) < static_cast<uint32_t>(reach))
+                    select(key);
+            }
+        }
+
+        m_missing.clear();
+        for (auto const& key : m_selected) {
+            if (!m_cells.contains(key))
+                m_missing.push_back(key);
+        }
+    }
+
+    if (!m_missing.empty()) {
+        // the closest ones are moved to the back and built.
+        auto count = std::min<size_t>(m_max_builds_per_update, m_missing.size());
+        auto nth = m_missing.end() - count;
+        std::nth_element(m_missing.begin(), nth, m_missing.end(), [this](LodCellKey a, LodCellKey b) {
+            return get_distance(a) > get_distance(b);
+        });
+
+        std::vector<LodCellKey> keys(nth, m_missing.end());
+        m_missing.erase(nth, m_missing.end());
+        build(keys);
+    }
+
+    for (auto it = m_cells.begin(); it != m_cells.end();) {
+        if (!m_selected.contains(it->first) && is_covered(it->first)) {
+            destroy(it->second);
+            it = m_cells.erase(it);
+        } else {
+            it++;
+        }
+    }
+}
+
+bool LodTerrain::is_full_resolution(ChunkPosition position) const
+{
+    // inside a split level 1 cell.
+    LodCellKey key { 1, position.x >> 1, position.z >> 1 };
+    return m_has_camera && get_distance(key) < m_near_distance;
+}
+
+void LodTerrain::draw(RenderingInstance& instance, float const (&view_projection)[16])
+{
+    m_culler.cull(view_projection, m_visible);
+    if (m_visible.empty())
+        return;
+
+    for (auto& [key, cell] : m_cells)
+        cell.drawable = is_drawable(key);
+
+    // sized for every visible box, sections that are not ready leave the tail unused. on overflow the
+    // ring grows before the slot comes around again, this frame skips the terrain.
+    auto records = instance.allocate_frame_data(m_visible.size() * sizeof(ChunkDrawRecord), sizeof(ChunkDrawRecord));
+    if (!records)
+        return;
+
+    auto record = static_cast<ChunkDrawRecord*>(records.data);
+    auto first_record = static_cast<uint32_t>(records.offset / sizeof(ChunkDrawRecord));
+
+    m_draws.clear();
+    for (auto box : m_visible) {
+        auto [key, section_index] = m_box_owners[box];
+        auto const& cell = m_cells.at(key);
+        if (!cell.drawable)
+            continue;
+
+        auto const& mesh = cell.meshes[section_index];
+        auto scale = 1 << key.level;
+        *record = {};
+        record->section_origin[0] = key.x * scale * CHUNK_SECTION_SIZE;
+        record->section_origin[1] = section_index * CHUNK_SECTION_SIZE * scale;
+        record->section_origin[2] = key.z * scale * CHUNK_SECTION_SIZE;
+        record->quads_index = mesh.quads_index;
+        record->scale = scale;
+        record++;
+
+        m_draws.add(mesh.quad_count * 6, 1, 0, first_record + m_draws.get_draw_count());
+    }
+
+    ChunkDrawConstants constants {};
+    std::copy_n(view_projection, 16, constants.view_projection);
+    constants.records_index = records.storage_index;
+    instance.push_constants(&constants, sizeof(constants));
+    instance.draw_indirect(m_draws);
+}
+
+LodTerrainStats LodTerrain::get_stats() const
+{
+    LodTerrainStats stats {};
+    stats.cell_count = m_cells.size();
+    stats.pending_count = m_missing.size();
+    for (auto const& [key, cell] : m_cells) {
+        for (auto const& mesh : cell.meshes) {
+            if (mesh.quad_count == 0)
+                continue;
+            stats.section_count++;
+            stats.quad_count += mesh.quad_count;
+        }
+    }
+    return stats;
+}
+
+uint32_t LodTerrain::get_distance(LodCellKey key) const
+{
+    auto size = 1 << key.level;
+    auto min_x = key.x * size;
+    auto min_z = key.z * size;
+    auto dx = std::max({ min_x - m_camera.x, m_camera.x - (min_x + size - 1), 0 });
+    auto dz = std::max({ min_z - m_camera.z, m_camera.z - (min_z + size - 1), 0 });
+    return std::max(dx, dz);
+}
+
+void LodTerrain::select(LodCellKey key)
+{
+    // level 0 children are the caller's full resolution chunks.
+    if (get_distance(key) >= m_near_distance << (key.level - 1)) {
+        m_selected.insert(key);
+        return;
+    }
+
+    if (key.level == 1)
+        return;
+
+    for (auto i { 0 }; i < 4; i++)
+        select({ key.level - 1, key.x * 2 + (i & 1), key.z * 2 + (i >> 1) });
+}
+
+void LodTerrain::build(std::span<LodCellKey const> keys)
+{
+    std::vector<std::vector<std::array<Block, CHUNK_SECTION_VOLUME>>> grids(keys.size());
+    auto generate = [&](uint32_t i) {
+        auto key = keys[i];
+        auto origin_x = key.x * (CHUNK_SECTION_SIZE << key.level);
+        auto origin_z = key.z * (CHUNK_SECTION_SIZE << key.level);
+        grids[i].resize(CHUNK_SECTION_COUNT >> key.level);
+        m_generator->generate_lod(origin_x, origin_z, key.level, grids[i]);
+    };
+    m_jobs->parallel_for(keys.size(), generate, JobPriority::Normal);
+
+    std::vector<ChunkLodNeighborhood> requests;
+    for (auto const& grid : grids) {
+        for (auto i { 0u }; i < grid.size(); i++) {
+            ChunkLodNeighborhood request {};
+            request.center = grid[i].data();
+            request.below = i > 0 ? grid[i - 1].data() : nullptr;
+            request.above = i + 1 < grid.size() ? grid[i + 1].data() : nullptr;
+            requests.push_back(request);
+        }
+    }
+
+    std::vector<ChunkSectionMesh> meshes(requests.size());
+    m_mesher->mesh_lod(requests, meshes);
+
+    auto first_mesh { 0u };
+    for (auto i { 0u }; i < keys.size(); i++) {
+        Cell cell;
+        cell.meshes.assign(meshes.begin() + first_mesh, meshes.begin() + first_mesh + grids[i].size());
+        first_mesh += grids[i].size();
+
+        // retried on a later update once the staging ring drained or descriptor slots were released.
+        auto failed = std::any_of(cell.meshes.begin(), cell.meshes.end(), [](ChunkSectionMesh const& mesh) {
+            return mesh.status == ChunkMeshStatus::StagingFull || mesh.status == ChunkMeshStatus::DescriptorsFull;
+        });
+        if (failed) {
+            destroy(cell);
+            m_missing.push_back(keys[i]);
+            continue;
+        }
+
+        auto& stored = m_cells[keys[i]];
+        stored = std::move(cell);
+        add_boxes(keys[i], stored);
+    }
+}
+
+bool LodTerrain::is_ready(LodCellKey key) const
+{
+    auto it = m_cells.find(key);
+    if (it == m_cells.end())
+        return false;
+
+    for (auto const& mesh : it->second.meshes) {
+        if (mesh.status == ChunkMeshStatus::Uploaded && !m_upload_service->is_complete(mesh.upload_ticket))
+            return false;
+    }
+    return true;
+}
+
+bool LodTerrain::is_covered(LodCellKey key) const
+{
+    for (auto level = key.level + 1; level <= LOD_LEVEL_COUNT; level++) {
+        auto shift = level - key.level;
+        LodCellKey ancestor { level, key.x >> shift, key.z >> shift };
+        if (m_selected.contains(ancestor))
+            return is_ready(ancestor);
+    }
+
+    return are_children_ready(key);
+}
+
+bool LodTerrain::are_children_ready(LodCellKey key) const
+{
+    // full resolution chunks are the caller's to stream in.
+    if (key.level == 1)
+        return true;
+
+    for (auto i { 0 }; i < 4; i++) {
+        LodCellKey child { key.level - 1, key.x * 2 + (i & 1), key.z * 2 + (i >> 1) };
+        auto ready = m_selected.contains(child) ? is_ready(child) : are_children_ready(child);
+        if (!ready)
+            return false;
+    }
+    return true;
+}
+
+bool LodTerrain::is_drawable(LodCellKey key) const
+{
+    if (!is_ready(key))
+        return false;
+
+    // replaced cells are destroyed by the next update() once covered, until then they just step aside.
+    if (!m_selected.contains(key) && is_covered(key))
+        return false;
+
+    // a replaced coarser cell still standing in for this one, e.g. the parent of a split whose siblings
+    // are not all uploaded yet.
+    for (auto level = key.level + 1; level <= LOD_LEVEL_COUNT; level++) {
+        auto shift = level - key.level;
+        LodCellKey ancestor { level, key.x >> shift, key.z >> shift };
+        if (m_cells.contains(ancestor) && !m_selected.contains(ancestor) && is_ready(ancestor) && !is_covered(ancestor))
+            return false;
+    }
+    return true;
+}
+
+void LodTerrain::add_boxes(LodCellKey key, Cell& cell)
+{
+    auto size = static_cast<float>(CHUNK_SECTION_SIZE << key.level);
+    cell.boxes.assign(cell.meshes.size(), FRUSTUM_CULLER_INVALID_INDEX);
+    for (auto i { 0u }; i < cell.meshes.size(); i++) {
+        if (cell.meshes[i].quad_count == 0)
+            continue;
+
+        float min[3] = { key.x * size, i * size, key.z * size };
+        float max[3] = { min[0] + size, min[1] + size, min[2] + size };
+        cell.boxes[i] = m_culler.add(min, max);
+        if (cell.boxes[i] >= m_box_owners.size())
+            m_box_owners.resize(cell.boxes[i] + 1);
+        m_box_owners[cell.boxes[i]] = { key, i };
+    }
+}
+
+void LodTerrain::destroy(Cell& cell)
+{
+    for (auto& mesh : cell.meshes)
+        m_mesher->destroy(mesh);
+    cell.meshes.clear();
+
+    for (auto box : cell.boxes) {
+        if (box != FRUSTUM_CULLER_INVALID_INDEX)
+            m_culler.remove(box);
+    }
+    cell.boxes.clear();
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "chunk.h"
+#include "chunk_mesher.h"
+#include "frustum_culler.h"
+#include "helper.h"
+#include "indirect_draw.h"
+#include "job_subsystem.h"
+#include "renderer_subsystem.h"
+#include "terrain_generator.h"
+#include "upload_service.h"
+
+// coarse levels 1..LOD_LEVEL_COUNT, a level's cells are 2^level chunks wide and every block of their
+// grids stands for a cube of 2^level blocks.
+#define LOD_LEVEL_COUNT 3
+
+struct LodCellKey {
+    uint32_t level;
+    int32_t x;
+    int32_t z;
+
+    bool operator==(LodCellKey const&) const = default;
+};
+
+struct LodCellKeyHash {
+    size_t operator()(LodCellKey key) const
+    {
+        auto position = (static_cast<uint64_t>(static_cast<uint32_t>(key.x)) << 32) | static_cast<uint32_t>(key.z);
+        return std::hash<uint64_t>()(position * 31 + key.level);
+    }
+};
+
+struct LodTerrainInfo {
+    TerrainGenerator const* generator;
+    ChunkMesher* mesher;
+    UploadService* upload_service;
+    JobSubsystem* jobs;
+
+    // chunks drawn at full resolution around the camera, every level reaches twice as far as the one before.
+    uint32_t near_distance { 16 };
+
+    // cells generated and meshed per update(), closest to the camera first.
+    uint32_t max_builds_per_update { 8 };
+};
+
+struct LodTerrainStats {
+    uint32_t cell_count;
+    uint32_t pending_count;
+    uint32_t section_count;
+    uint64_t quad_count;
+};
+
+// distance clipmap rings of coarse terrain around the full resolution chunks. cells are picked by
+// splitting a quadtree of the coarsest level wherever it comes closer to the camera than the next finer
+// level reaches, so rings nest without gaps or overlaps. cells replaced by a move of the camera are
+// drawn until their replacements finished uploading. main thread only.
+class LodTerrain {
+    MAKE_NON_COPYABLE(LodTerrain);
+    MAKE_NON_MOVABLE(LodTerrain);
+
+public:
+    LodTerrain() = default;
+
+    void init(LodTerrainInfo const& info);
+
+    // meshes may still be drawn by frames in flight, they go through the mesher's deferred destruction.
+    void deinit();
+
+    // reselects the cells when the camera entered another chunk, then builds the closest missing ones
+    // and drops the replaced ones that are covered.
+    void update(ChunkPosition camera);
+
+    // chunks the caller has to draw itself, the rings leave a hole for them.
+    bool is_full_resolution(ChunkPosition position) const;
+
+    // in chunks, from the camera to the outer edge of the coarsest ring.
+    uint32_t get_view_distance() const { return m_near_distance << LOD_LEVEL_COUNT; }
+
+    // draws the sections inside the frustum through the chunk pipeline, which the caller has bound already.
+    // their records go into the frame ring and all of them are issued by a single indirect draw.
+    void draw(RenderingInstance& instance, float const (&view_projection)[16]);
+
+    LodTerrainStats get_stats() const;
+
+private:
+    struct Cell {
+        std::vector<ChunkSectionMesh> meshes;
+
+        // the culler's box of every mesh, FRUSTUM_CULLER_INVALID_INDEX for empty ones.
+        std::vector<uint32_t> boxes;
+
+        // refreshed at the start of every draw(), see is_drawable().
+        bool drawable { false };
+    };
+
+    struct BoxOwner {
+        LodCellKey key;
+        uint32_t section_index;
+    };
+
+    // chebyshev distance in chunks from the camera to the closest chunk of the cell.
+    uint32_t get_distance(LodCellKey key) const;
+
+    void select(LodCellKey key);
+
+    void build(std::span<LodCellKey const> keys);
+
+    bool is_ready(LodCellKey key) const;
+
+    // whether the cells that replace key, coarser or finer, can all be drawn.
+    bool is_covered(LodCellKey key) const;
+
+    bool are_children_ready(LodCellKey key) const;
+
+    // ready, not replaced by drawable cells yet and not inside a coarser cell that is still drawn in its
+    // place, so coarse and fine geometry never overlap while a split or merge is uploading.
+    bool is_drawable(LodCellKey key) const;
+
+    void add_boxes(LodCellKey key, Cell& cell);
+
+    void destroy(Cell& cell);
+
+private:
+    TerrainGenerator const* m_generator { nullptr };
+    ChunkMesher* m_mesher { nullptr };
+    UploadService* m_upload_service { nullptr };
+    JobSubsystem* m_jobs { nullptr };
+    uint32_t m_near_distance {};
+    uint32_t m_max_builds_per_update {};
+
+    ChunkPosition m_camera {};
+    bool m_has_camera { false };
+
+    std::unordered_set<LodCellKey, LodCellKeyHash> m_selected;
+    std::unordered_map<LodCellKey, Cell, LodCellKeyHash> m_cells;
+    std::vector<LodCellKey> m_missing;
+
+    FrustumCuller m_culler;
+    std::vector<BoxOwner> m_box_owners;
+    std::vector<uint32_t> m_visible;
+    IndirectDrawBuilder m_draws;
+};
@@ -0,0 +1,163 @@
+#include <cstring>
+
+#include "lz.h"
+
+#define LZ_MIN_MATCH 4
+#define LZ_MAX_OFFSET 65535
+#define LZ_HASH_BITS 12
+
+// the last bytes always go out as literals, so matching never reads past the input.
+#define LZ_END_LITERALS 8
+
+namespace {
+
+uint32_t read_u32(uint8_t const* data)
+{
+    uint32_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+uint32_t hash_sequence(uint32_t sequence)
+{
+    return (sequence * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+uint8_t* write_length(uint8_t* dst, size_t length)
+{
+    while (length >= 255) {
+        *dst++ = 255;
+        length -= 255;
+    }
+    *dst++ = static_cast<uint8_t>(length);
+    return dst;
+}
+
+// match_length 0 writes a final sequence of literals only.
+uint8_t* write_sequence(uint8_t* dst, uint8_t const* literals, size_t literal_length, size_t offset, size_t match_length)
+{
+    auto token = dst++;
+    *token = static_cast<uint8_t>((literal_length < 15 ? literal_length : 15) << 4);
+    if (literal_length >= 15)
+        dst = write_length(dst, literal_length - 15);
+
+    if (literal_length > 0)
+        std::memcpy(dst, literals, literal_length);
+    dst += literal_length;
+
+    if (match_length == 0)
+        return dst;
+
+    *dst++ = static_cast<uint8_t>(offset);
+    *dst++ = static_cast<uint8_t>(offset >> 8);
+
+    auto length = match_length - LZ_MIN_MATCH;
+    *token |= static_cast<uint8_t>(length < 15 ? length : 15);
+    if (length >= 15)
+        dst = write_length(dst, length - 15);
+
+    return dst;
+}
+
+bool read_length(uint8_t const*& src, uint8_t const* end, size_t& length)
+{
+    uint8_t byte;
+    do {
+        if (src == end)
+            return false;
+        byte = *src++;
+        length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+}
+
+size_t lz_compress_bound(size_t size)
+{
+    return size + size / 255 + 16;
+}
+
+size_t lz_compress(uint8_t const* src, size_t size, uint8_t* dst)
+{
+    uint32_t table[1 << LZ_HASH_BITS] {};
+
+    auto out = dst;
+    size_t anchor {};
+    size_t position {};
+    auto match_limit = size > LZ_END_LITERALS + LZ_MIN_MATCH ? size - LZ_END_LITERALS - LZ_MIN_MATCH : 0;
+
+    while (position < match_limit) {
+        auto sequence = read_u32(src + position);
+        auto& slot = table[hash_sequence(sequence)];
+        size_t candidate = slot;
+        slot = static_cast<uint32_t>(position);
+
+        if (candidate >= position || position - candidate > LZ_MAX_OFFSET || read_u32(src + candidate) != sequence) {
+            // skips faster through data that does not compress.
+            position += 1 + ((position - anchor) >> 6);
+            continue;
+        }
+
+        auto length = static_cast<size_t>(LZ_MIN_MATCH);
+        while (position + length < size - LZ_END_LITERALS && src[candidate + length] == src[position + length])
+            length++;
+
+        out = write_sequence(out, src + anchor, position - anchor, position - candidate, length);
+        position += length;
+        anchor = position;
+    }
+
+    out = write_sequence(out, src + anchor, size - anchor, 0, 0);
+    return out - dst;
+}
+
+bool lz_decompress(uint8_t const* src, size_t size, uint8_t* dst, size_t dst_size)
+{
+    auto end = src + size;
+    size_t written {};
+
+    while (src < end) {
+        auto token = *src++;
+
+        size_t literal_length = token >> 4;
+        if (literal_length == 15 && !read_length(src, end, literal_length))
+            return false;
+
+        if (literal_length > static_cast<size_t>(end - src) || literal_length > dst_size - written)
+            return false;
+
+        if (literal_length > 0)
+            std::memcpy(dst + written, src, literal_length);
+        src += literal_length;
+        written += literal_length;
+
+        // the final sequence has no match.
+        if (src == end)
+            break;
+
+        if (end - src < 2)
+            return false;
+
+        size_t offset = src[0] | (src[1] << 8);
+        src += 2;
+        if (offset == 0 || offset > written)
+            return false;
+
+        size_t match_length = token & 15;
+        if (match_length == 15 && !read_length(src, end, match_length))
+            return false;
+        match_length += LZ_MIN_MATCH;
+
+        if (match_length > dst_size - written)
+            return false;
+
+        // byte by byte, a match may overlap the bytes it produces.
+        auto match = dst + written - offset;
+        for (size_t i {}; i < match_length; i++)
+            dst[written + i] = match[i];
+        written += match_length;
+    }
+
+    return written == dst_size;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// a byte-oriented LZ77 codec in the spirit of LZ4's block format: sequences of a token, literals, a
+// 16-bit back reference and a match length. fast enough to run on every chunk that is saved or loaded.
+
+// worst case size of lz_compress's output for size input bytes.
+size_t lz_compress_bound(size_t size);
+
+// returns the number of bytes written to dst, which must hold lz_compress_bound(size) bytes.
+size_t lz_compress(uint8_t const* src, size_t size, uint8_t* dst);
+
+// decodes exactly dst_size bytes, false when src is malformed or does not decode to dst_size bytes.
+bool lz_decompress(uint8_t const* src, size_t size, uint8_t* dst, size_t dst_size);
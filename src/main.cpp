@@ -1,11 +1,66 @@
+#include <chrono>
 #include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 
 #if defined(VULKRAFT_WINDOWS)
 #    define VULKRAFT_WINMAIN
 #    include "platform.h"
 #endif
 
+#include "chunk_streamer.h"
+#include "job_subsystem.h"
 #include "renderer_subsystem.h"
+#include "terrain_generator.h"
+
+// chunk columns streamed in around the camera.
+#define VIEW_DISTANCE 32
+
+#define WORLD_SEED 1337
+
+// generates the same columns with every noise ISA on the calling thread, then with the best one on all workers.
+void run_terrain_benchmark(JobSubsystem* jobs, uint32_t column_count)
+{
+    std::vector<std::unique_ptr<Chunk>> chunks;
+    std::vector<Chunk*> chunk_pointers;
+    for (auto i { 0u }; i < column_count; i++) {
+        chunks.push_back(std::make_unique<Chunk>(ChunkPosition { static_cast<int32_t>(i % 64), static_cast<int32_t>(i / 64) }));
+        chunk_pointers.push_back(chunks.back().get());
+    }
+
+    for (auto i { 0u }; i < CPU_ISA_COUNT; i++) {
+        auto kernels = get_noise_kernels(static_cast<CpuISA>(i));
+        if (!kernels)
+            continue;
+
+        TerrainGenerator generator;
+        generator.init({ WORLD_SEED, jobs, kernels });
+
+        auto start = std::chrono::steady_clock::now();
+        for (auto chunk : chunk_pointers)
+            generator.generate(*chunk);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        fmt::println("terrain {}: {:.0f} columns/s on one core", get_cpu_isa_name(kernels->isa), column_count / elapsed.count());
+    }
+
+    TerrainGenerator generator;
+    generator.init({ WORLD_SEED, jobs });
+
+    auto start = std::chrono::steady_clock::now();
+    generator.generate(chunk_pointers);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    auto thread_count = jobs->get_worker_count() + 1;
+    fmt::println("terrain {} parallel: {:.0f} columns/s on {} threads, {:.0f} per thread",
+        get_cpu_isa_name(generator.get_isa()),
+        column_count / elapsed.count(),
+        thread_count,
+        column_count / elapsed.count() / thread_count);
+}
 
 enum class Color {
     Red,
@@ -15,17 +70,120 @@ enum class Color {
 
 int32_t main(int32_t argc, char** argv)
 {
-    auto window = WindowSubsystem::instance();
-    if (auto result = window->init("Vulkraft", 800, 600, true); !result) {
+    bool headless = false;
+    bool print_gpu_timings = false;
+    uint64_t frame_limit = 0;
+    PresentPolicy present_policy {};
+    std::string_view world_directory;
+    uint32_t benchmark_columns = 0;
+
+    for (auto i { 1 }; i < argc; i++) {
+        std::string_view arg = argv[i];
+        if (arg == "--headless") {
+            headless = true;
+        } else if (arg == "--frames" && i + 1 < argc) {
+            frame_limit = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--gpu-timings") {
+            print_gpu_timings = true;
+        } else if (arg == "--present-mode" && i + 1 < argc) {
+            std::string_view mode = argv[++i];
+            if (mode == "fifo") {
+                present_policy.mode = PresentMode::Fifo;
+            } else if (mode == "relaxed") {
+                present_policy.mode = PresentMode::FifoRelaxed;
+            } else if (mode == "mailbox") {
+                present_policy.mode = PresentMode::Mailbox;
+            } else if (mode == "immediate") {
+                present_policy.mode = PresentMode::Immediate;
+            } else {
+                fmt::println(stderr, "unknown present mode '{}'", mode);
+            }
+        } else if (arg == "--swapchain-images" && i + 1 < argc) {
+            present_policy.image_count = std::strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--low-latency") {
+            present_policy.limit_latency = true;
+        } else if (arg == "--world" && i + 1 < argc) {
+            world_directory = argv[++i];
+        } else if (arg == "--benchmark-terrain") {
+            benchmark_columns = 4096;
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+                benchmark_columns = std::strtoul(argv[++i], nullptr, 10);
+        }
+    }
+
+    // guards run in reverse, so the window goes last. leftover main thread jobs may still talk to GLFW.
+    WindowSubsystem* window { nullptr };
+    ScopeGuard deinit_window([&] {
+        if (window)
+            window->deinit();
+    });
+
+    auto jobs = JobSubsystem::instance();
+    ScopeGuard deinit_jobs([jobs] { jobs->deinit(); });
+    if (auto result = jobs->init(); !result) {
         fmt::println(stderr, "{}", result.message);
         return -1;
     }
+
+    if (benchmark_columns > 0) {
+        run_terrain_benchmark(jobs, benchmark_columns);
+        return 0;
+    }
+
+    if (!headless) {
+        window = WindowSubsystem::instance();
+        if (auto result = window->init("Vulkraft", 800, 600, true); !result) {
+            fmt::println(stderr, "{}", result.message);
+            return -1;
+        }
+    }
+
+    RendererSubsystemInfo renderer_info {};
+    renderer_info.window = window;
+    renderer_info.jobs = jobs;
+    renderer_info.headless = headless;
+    renderer_info.present_policy = present_policy;
+
     auto renderer = RendererSubsystem::instance();
-    if (auto result = renderer->init(window); !result) {
+    ScopeGuard deinit_renderer([renderer] { renderer->deinit(); });
+    if (auto result = renderer->init(renderer_info); !result) {
         fmt::println(stderr, "{}", result.message);
         return -1;
     }
 
+    TerrainGenerator terrain_generator;
+    terrain_generator.init({ WORLD_SEED, jobs });
+
+    std::unique_ptr<ChunkStreamer> streamer;
+    ScopeGuard deinit_streamer([&] {
+        if (streamer)
+            streamer->deinit();
+    });
+    if (!world_directory.empty()) {
+        ChunkStreamerInfo streamer_info {};
+        streamer_info.jobs = jobs;
+        streamer_info.directory = world_directory;
+        streamer_info.generator = &terrain_generator;
+
+        streamer = std::make_unique<ChunkStreamer>();
+        if (!streamer->init(streamer_info))
+            return -1;
+    }
+
+    // the camera sits at the origin for now, so the view is requested once.
+    ChunkPosition camera_chunk {};
+    std::unordered_map<ChunkPosition, std::unique_ptr<Chunk>, ChunkPositionHash> chunks;
+    std::vector<ChunkLoadResult> loaded_chunks;
+    if (streamer) {
+        streamer->set_focus(camera_chunk);
+        for (auto z { -VIEW_DISTANCE }; z <= VIEW_DISTANCE; z++) {
+            for (auto x { -VIEW_DISTANCE }; x <= VIEW_DISTANCE; x++) {
+                if (x * x + z * z <= VIEW_DISTANCE * VIEW_DISTANCE)
+                    streamer->request_load({ camera_chunk.x + x, camera_chunk.z + z });
+            }
+        }
+    }
+
     Color current_color = Color::Red;
 
     float red_value = 0.0f;
@@ -36,13 +194,38 @@ int32_t main(int32_t argc, char** argv)
     float green_factor = 0.1f;
     float blue_factor = 0.1f;
 
-    while (!window->should_close()) {
-        window->poll_events();
+    uint64_t frame_count = 0;
+
+    while (frame_limit == 0 || frame_count < frame_limit) {
+        if (window) {
+            if (window->should_close())
+                break;
+
+            renderer->wait_for_present_latency();
+            window->poll_events();
+        }
+
+        jobs->run_main_thread_jobs();
+
+        if (streamer) {
+            streamer->update();
+            streamer->collect(loaded_chunks);
+
+            // generated columns are written right away, so the next start loads them from disk.
+            for (auto& result : loaded_chunks) {
+                if (result.chunk && result.generated)
+                    streamer->save(*result.chunk);
+                chunks[result.position] = std::move(result.chunk);
+            }
+            loaded_chunks.clear();
+        }
 
         auto frame = renderer->try_get_frame();
         if (!frame)
             continue;
 
+        frame_count++;
+
         if (current_color == Color::Red) {
             red_value += red_factor;
             if (red_value >= 1.0f || red_value <= 0.0f) {
@@ -63,11 +246,29 @@ int32_t main(int32_t argc, char** argv)
             }
         }
 
-        frame.begin(red_value, green_value, blue_value, 1.0f);
-        frame.end();
+        frame.get_render_graph()->add_pass("rendering").add_color_attachment(
+            frame.get_target(),
+            VK_ATTACHMENT_LOAD_OP_CLEAR,
+            { .float32 = { red_value, green_value, blue_value, 1.0f } });
+
+        frame.execute_render_graph();
         frame.submit_and_present();
     }
 
-    renderer->deinit();
-    window->deinit();
+    if (print_gpu_timings) {
+        for (auto const& timing : renderer->get_gpu_timings()) {
+            fmt::println("{}: min {:.3f} ms, avg {:.3f} ms, p99 {:.3f} ms ({} samples)",
+                timing.name, timing.min_ms, timing.avg_ms, timing.p99_ms, timing.sample_count);
+        }
+    }
+
+    if (streamer) {
+        // deinit() finishes the writes, the stats are read afterwards so they include them.
+        streamer->deinit();
+
+        auto stats = streamer->get_stats();
+        fmt::println("streamed {} chunks: {} from disk, {} generated, {} saved, {} failed saves, {} compactions",
+            chunks.size(), stats.loaded_count, stats.generated_count, stats.saved_count, stats.failed_save_count, stats.compaction_count);
+        streamer.reset();
+    }
 }
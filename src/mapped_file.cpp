@@ -0,0 +1,131 @@
+#if defined(VULKRAFT_WINDOWS)
+#    include <windows.h>
+#elif defined(VULKRAFT_LINUX)
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#else
+#    error "UNSUPPORTED PLATFORM!"
+#endif
+
+#include <fmt/base.h>
+
+#include "mapped_file.h"
+
+#if defined(VULKRAFT_WINDOWS)
+
+bool MappedFile::open(std::string const& path)
+{
+    close();
+
+    // writers append to the same file while it is mapped, and compaction replaces it.
+    auto file = CreateFileA(
+        path.c_str(),
+        GENERIC_READ,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        nullptr,
+        OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL,
+        nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        fmt::println(stderr, "MappedFile::open(): failed to open '{}'!", path);
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size)) {
+        fmt::println(stderr, "MappedFile::open(): failed to query the size of '{}'!", path);
+        CloseHandle(file);
+        return false;
+    }
+
+    m_file = file;
+    m_open = true;
+    if (size.QuadPart == 0)
+        return true;
+
+    m_mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!m_mapping) {
+        fmt::println(stderr, "MappedFile::open(): failed to map '{}'!", path);
+        close();
+        return false;
+    }
+
+    m_data = static_cast<uint8_t const*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+    if (!m_data) {
+        fmt::println(stderr, "MappedFile::open(): failed to map '{}'!", path);
+        close();
+        return false;
+    }
+
+    m_size = static_cast<size_t>(size.QuadPart);
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (m_data)
+        UnmapViewOfFile(m_data);
+    if (m_mapping)
+        CloseHandle(m_mapping);
+    if (m_file)
+        CloseHandle(m_file);
+
+    m_data = nullptr;
+    m_size = 0;
+    m_mapping = nullptr;
+    m_file = nullptr;
+    m_open = false;
+}
+
+#elif defined(VULKRAFT_LINUX)
+
+bool MappedFile::open(std::string const& path)
+{
+    close();
+
+    auto fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        fmt::println(stderr, "MappedFile::open(): failed to open '{}'!", path);
+        return false;
+    }
+
+    struct stat stat;
+    if (fstat(fd, &stat) != 0) {
+        fmt::println(stderr, "MappedFile::open(): failed to query the size of '{}'!", path);
+        ::close(fd);
+        return false;
+    }
+
+    m_fd = fd;
+    m_open = true;
+    if (stat.st_size == 0)
+        return true;
+
+    auto data = mmap(nullptr, stat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+        fmt::println(stderr, "MappedFile::open(): failed to map '{}'!", path);
+        close();
+        return false;
+    }
+
+    m_data = static_cast<uint8_t const*>(data);
+    m_size = static_cast<size_t>(stat.st_size);
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (m_data)
+        munmap(const_cast<uint8_t*>(m_data), m_size);
+    if (m_fd >= 0)
+        ::close(m_fd);
+
+    m_data = nullptr;
+    m_size = 0;
+    m_fd = -1;
+    m_open = false;
+}
+
+#endif
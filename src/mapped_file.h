@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "helper.h"
+
+// a read-only view of a whole file. the mapping is a snapshot of the size at open(), bytes appended
+// afterwards are only visible after reopening.
+class MappedFile {
+    MAKE_NON_COPYABLE(MappedFile);
+    MAKE_NON_MOVABLE(MappedFile);
+
+public:
+    MappedFile() = default;
+
+    ~MappedFile() { close(); }
+
+    // an empty file opens without data.
+    bool open(std::string const& path);
+
+    void close();
+
+    bool is_open() const { return m_open; }
+
+    uint8_t const* get_data() const { return m_data; }
+
+    size_t get_size() const { return m_size; }
+
+private:
+    uint8_t const* m_data { nullptr };
+    size_t m_size {};
+    bool m_open { false };
+
+#if defined(VULKRAFT_WINDOWS)
+    void* m_file { nullptr };
+    void* m_mapping { nullptr };
+#elif defined(VULKRAFT_LINUX)
+    int32_t m_fd { -1 };
+#else
+#    error "UNSUPPORTED PLATFORM!"
+#endif
+};
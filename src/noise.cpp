@@ -0,0 +1,77 @@
+#include <bit>
+#include <cmath>
+#include <initializer_list>
+
+#include "noise.h"
+
+#if defined(CPU_X86)
+NoiseKernels const* get_noise_kernels_sse41();
+NoiseKernels const* get_noise_kernels_avx2();
+#endif
+
+namespace {
+
+#define NOISE_LANES 1
+
+struct F32 {
+    float v;
+};
+
+struct I32 {
+    uint32_t v;
+};
+
+inline F32 operator+(F32 a, F32 b) { return { a.v + b.v }; }
+inline F32 operator-(F32 a, F32 b) { return { a.v - b.v }; }
+inline F32 operator*(F32 a, F32 b) { return { a.v * b.v }; }
+inline I32 operator+(I32 a, I32 b) { return { a.v + b.v }; }
+inline I32 operator^(I32 a, I32 b) { return { a.v ^ b.v }; }
+inline I32 operator&(I32 a, I32 b) { return { a.v & b.v }; }
+inline I32 operator|(I32 a, I32 b) { return { a.v | b.v }; }
+inline I32 mul(I32 a, I32 b) { return { a.v * b.v }; }
+inline F32 splat(float value) { return { value }; }
+inline I32 splat_int(uint32_t value) { return { value }; }
+inline F32 load(float const* data) { return { *data }; }
+inline void store(float* data, F32 value) { *data = value.v; }
+inline F32 floor(F32 a) { return { std::floor(a.v) }; }
+inline I32 to_int(F32 a) { return { static_cast<uint32_t>(static_cast<int32_t>(a.v)) }; }
+inline I32 shift_left(I32 a, int bits) { return { a.v << bits }; }
+inline I32 shift_right(I32 a, int bits) { return { a.v >> bits }; }
+inline F32 as_float(I32 a) { return { std::bit_cast<float>(a.v) }; }
+inline I32 as_int(F32 a) { return { std::bit_cast<uint32_t>(a.v) }; }
+inline F32 select(I32 mask, F32 a, F32 b) { return mask.v ? a : b; }
+inline I32 equal(I32 a, I32 b) { return { a.v == b.v ? ~0u : 0u }; }
+
+#include "noise_impl.h"
+
+NoiseKernels const SCALAR_KERNELS { CpuISA::Scalar, noise_fbm2_batch, noise_fbm3_batch };
+
+}
+
+NoiseKernels const& get_noise_kernels()
+{
+    static NoiseKernels const* kernels = [] {
+        for (auto isa : { CpuISA::AVX2, CpuISA::SSE41 }) {
+            if (auto kernels = get_noise_kernels(isa))
+                return kernels;
+        }
+        return &SCALAR_KERNELS;
+    }();
+    return *kernels;
+}
+
+NoiseKernels const* get_noise_kernels(CpuISA isa)
+{
+    switch (isa) {
+    case CpuISA::Scalar:
+        return &SCALAR_KERNELS;
+#if defined(CPU_X86)
+    case CpuISA::SSE41:
+        return is_cpu_isa_supported(isa) ? get_noise_kernels_sse41() : nullptr;
+    case CpuISA::AVX2:
+        return is_cpu_isa_supported(isa) ? get_noise_kernels_avx2() : nullptr;
+#endif
+    default:
+        return nullptr;
+    }
+}
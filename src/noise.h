@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+
+#include "cpu_features.h"
+
+// fractal gradient noise, every octave's frequency and amplitude are the previous one's times
+// lacunarity and gain. results are normalized to about [-1, 1].
+struct NoiseOctaves {
+    uint32_t seed;
+    uint32_t octaves;
+    float frequency;
+    float lacunarity { 2.0f };
+    float gain { 0.5f };
+};
+
+// batch evaluation, out[i] is the noise at (x[i], z[i]) or (x[i], y[i], z[i]). every ISA performs the
+// same operations in the same order and produces bit-identical results, so worlds do not depend on the
+// CPU that generated them.
+struct NoiseKernels {
+    CpuISA isa;
+    void (*fbm2)(NoiseOctaves const& octaves, float const* x, float const* z, float* out, uint32_t count);
+    void (*fbm3)(NoiseOctaves const& octaves, float const* x, float const* y, float const* z, float* out, uint32_t count);
+};
+
+// the widest ISA the CPU supports, detected once.
+NoiseKernels const& get_noise_kernels();
+
+// null when the CPU or the build does not support isa.
+NoiseKernels const* get_noise_kernels(CpuISA isa);
@@ -0,0 +1,50 @@
+#include "noise.h"
+
+#if defined(CPU_X86)
+
+#    include <immintrin.h>
+
+namespace {
+
+#    define NOISE_LANES 8
+
+struct F32 {
+    __m256 v;
+};
+
+struct I32 {
+    __m256i v;
+};
+
+inline F32 operator+(F32 a, F32 b) { return { _mm256_add_ps(a.v, b.v) }; }
+inline F32 operator-(F32 a, F32 b) { return { _mm256_sub_ps(a.v, b.v) }; }
+inline F32 operator*(F32 a, F32 b) { return { _mm256_mul_ps(a.v, b.v) }; }
+inline I32 operator+(I32 a, I32 b) { return { _mm256_add_epi32(a.v, b.v) }; }
+inline I32 operator^(I32 a, I32 b) { return { _mm256_xor_si256(a.v, b.v) }; }
+inline I32 operator&(I32 a, I32 b) { return { _mm256_and_si256(a.v, b.v) }; }
+inline I32 operator|(I32 a, I32 b) { return { _mm256_or_si256(a.v, b.v) }; }
+inline I32 mul(I32 a, I32 b) { return { _mm256_mullo_epi32(a.v, b.v) }; }
+inline F32 splat(float value) { return { _mm256_set1_ps(value) }; }
+inline I32 splat_int(uint32_t value) { return { _mm256_set1_epi32(static_cast<int32_t>(value)) }; }
+inline F32 load(float const* data) { return { _mm256_loadu_ps(data) }; }
+inline void store(float* data, F32 value) { _mm256_storeu_ps(data, value.v); }
+inline F32 floor(F32 a) { return { _mm256_floor_ps(a.v) }; }
+inline I32 to_int(F32 a) { return { _mm256_cvttps_epi32(a.v) }; }
+inline I32 shift_left(I32 a, int bits) { return { _mm256_slli_epi32(a.v, bits) }; }
+inline I32 shift_right(I32 a, int bits) { return { _mm256_srli_epi32(a.v, bits) }; }
+inline F32 as_float(I32 a) { return { _mm256_castsi256_ps(a.v) }; }
+inline I32 as_int(F32 a) { return { _mm256_castps_si256(a.v) }; }
+inline F32 select(I32 mask, F32 a, F32 b) { return { _mm256_blendv_ps(b.v, a.v, _mm256_castsi256_ps(mask.v)) }; }
+inline I32 equal(I32 a, I32 b) { return { _mm256_cmpeq_epi32(a.v, b.v) }; }
+
+#    include "noise_impl.h"
+
+}
+
+NoiseKernels const* get_noise_kernels_avx2()
+{
+    static NoiseKernels const kernels { CpuISA::AVX2, noise_fbm2_batch, noise_fbm3_batch };
+    return &kernels;
+}
+
+#endif
@@ -0,0 +1,209 @@
+// the noise kernels, written once against a small vector interface. every ISA's translation unit
+// defines F32 and I32 (NOISE_LANES floats or 32-bit integers) and the operations below inside an
+// anonymous namespace, then includes this file there. nothing in here may use the standard library,
+// an inline function emitted for one ISA would otherwise be shared with the others at link time.
+//
+// required interface:
+//   F32 operator+, -, * (F32, F32); I32 operator+, ^, &, | (I32, I32); I32 mul(I32, I32) (low 32 bits)
+//   F32 splat(float); I32 splat_int(uint32_t); F32 load(float const*); void store(float*, F32)
+//   F32 floor(F32); I32 to_int(F32) (truncating); I32 shift_left(I32, int); I32 shift_right(I32, int) (logical)
+//   F32 as_float(I32); I32 as_int(F32); F32 select(I32 mask, F32 a, F32 b) (all ones picks a)
+//   I32 equal(I32, I32) (all ones where equal)
+
+#define NOISE_PRIME_X 0x27d4eb2du
+#define NOISE_PRIME_Y 0x165667b1u
+#define NOISE_PRIME_Z 0x9e3779b9u
+
+// gradients are picked by hashing the lattice point instead of indexing a permutation table,
+// gathers are slow or missing on the narrower ISAs. the coordinates come premultiplied by their
+// primes, the neighboring lattice point's term is one addition away.
+inline I32 noise_hash(I32 x, I32 y, I32 z, I32 seed)
+{
+    auto h = x ^ y ^ z ^ seed;
+    h = h ^ shift_right(h, 15);
+    h = mul(h, splat_int(0x2c1b3c6du));
+    h = h ^ shift_right(h, 12);
+    return h;
+}
+
+inline F32 noise_fade(F32 t)
+{
+    return t * t * t * (t * (t * splat(6.0f) - splat(15.0f)) + splat(10.0f));
+}
+
+inline F32 noise_lerp(F32 t, F32 a, F32 b)
+{
+    return a + t * (b - a);
+}
+
+// flips the sign of v where the given hash bit is set.
+inline F32 noise_negate_if(I32 h, uint32_t bit, F32 v)
+{
+    auto sign = shift_left(h & splat_int(1u << bit), 31 - bit);
+    return as_float(as_int(v) ^ sign);
+}
+
+// one of (+-1, +-2) and (+-2, +-1).
+inline F32 noise_gradient2(I32 h, F32 x, F32 z)
+{
+    auto swap = equal(h & splat_int(4), splat_int(4));
+    auto u = select(swap, z, x);
+    auto v = select(swap, x, z);
+    return noise_negate_if(h, 0, u) + noise_negate_if(h, 1, v + v);
+}
+
+// the 12 cube edge directions of improved perlin noise, 4 of them twice.
+inline F32 noise_gradient3(I32 h, F32 x, F32 y, F32 z)
+{
+    auto index = h & splat_int(15);
+    auto low = equal(shift_right(index, 3), splat_int(0));
+    auto u = select(low, x, y);
+    auto use_y = equal(shift_right(index, 2), splat_int(0));
+    auto use_x = equal(index, splat_int(12)) | equal(index, splat_int(14));
+    auto v = select(use_y, y, select(use_x, x, z));
+    return noise_negate_if(h, 0, u) + noise_negate_if(h, 1, v);
+}
+
+inline F32 noise_perlin2(F32 x, F32 z, I32 seed)
+{
+    auto x0 = floor(x);
+    auto z0 = floor(z);
+    auto hx = mul(to_int(x0), splat_int(NOISE_PRIME_X));
+    auto hz = mul(to_int(z0), splat_int(NOISE_PRIME_Z));
+    auto hx1 = hx + splat_int(NOISE_PRIME_X);
+    auto hz1 = hz + splat_int(NOISE_PRIME_Z);
+    auto hy = splat_int(0);
+    auto fx = x - x0;
+    auto fz = z - z0;
+    auto one = splat(1.0f);
+
+    auto n00 = noise_gradient2(noise_hash(hx, hy, hz, seed), fx, fz);
+    auto n10 = noise_gradient2(noise_hash(hx1, hy, hz, seed), fx - one, fz);
+    auto n01 = noise_gradient2(noise_hash(hx, hy, hz1, seed), fx, fz - one);
+    auto n11 = noise_gradient2(noise_hash(hx1, hy, hz1, seed), fx - one, fz - one);
+
+    auto u = noise_fade(fx);
+    auto v = noise_fade(fz);
+    return noise_lerp(v, noise_lerp(u, n00, n10), noise_lerp(u, n01, n11));
+}
+
+inline F32 noise_perlin3(F32 x, F32 y, F32 z, I32 seed)
+{
+    auto x0 = floor(x);
+    auto y0 = floor(y);
+    auto z0 = floor(z);
+    auto ix = mul(to_int(x0), splat_int(NOISE_PRIME_X));
+    auto iy = mul(to_int(y0), splat_int(NOISE_PRIME_Y));
+    auto iz = mul(to_int(z0), splat_int(NOISE_PRIME_Z));
+    auto ix1 = ix + splat_int(NOISE_PRIME_X);
+    auto iy1 = iy + splat_int(NOISE_PRIME_Y);
+    auto iz1 = iz + splat_int(NOISE_PRIME_Z);
+    auto fx = x - x0;
+    auto fy = y - y0;
+    auto fz = z - z0;
+    auto one = splat(1.0f);
+    auto gx = fx - one;
+    auto gy = fy - one;
+    auto gz = fz - one;
+
+    auto n000 = noise_gradient3(noise_hash(ix, iy, iz, seed), fx, fy, fz);
+    auto n100 = noise_gradient3(noise_hash(ix1, iy, iz, seed), gx, fy, fz);
+    auto n010 = noise_gradient3(noise_hash(ix, iy1, iz, seed), fx, gy, fz);
+    auto n110 = noise_gradient3(noise_hash(ix1, iy1, iz, seed), gx, gy, fz);
+    auto n001 = noise_gradient3(noise_hash(ix, iy, iz1, seed), fx, fy, gz);
+    auto n101 = noise_gradient3(noise_hash(ix1, iy, iz1, seed), gx, fy, gz);
+    auto n011 = noise_gradient3(noise_hash(ix, iy1, iz1, seed), fx, gy, gz);
+    auto n111 = noise_gradient3(noise_hash(ix1, iy1, iz1, seed), gx, gy, gz);
+
+    auto u = noise_fade(fx);
+    auto v = noise_fade(fy);
+    auto w = noise_fade(fz);
+    auto n00 = noise_lerp(u, n000, n100);
+    auto n10 = noise_lerp(u, n010, n110);
+    auto n01 = noise_lerp(u, n001, n101);
+    auto n11 = noise_lerp(u, n011, n111);
+    return noise_lerp(w, noise_lerp(v, n00, n10), noise_lerp(v, n01, n11));
+}
+
+// brings a single octave to about [-1, 1].
+#define NOISE_PERLIN2_SCALE 0.65f
+#define NOISE_PERLIN3_SCALE 1.0f
+
+inline F32 noise_fbm2(NoiseOctaves const& octaves, F32 x, F32 z)
+{
+    auto sum = splat(0.0f);
+    auto frequency = octaves.frequency;
+    auto amplitude = 1.0f;
+    auto total = 0.0f;
+    for (auto i { 0u }; i < octaves.octaves; i++) {
+        auto f = splat(frequency);
+        auto n = noise_perlin2(x * f, z * f, splat_int(octaves.seed + i * 0x632be5abu));
+        sum = sum + n * splat(amplitude);
+        total += amplitude;
+        frequency *= octaves.lacunarity;
+        amplitude *= octaves.gain;
+    }
+    return sum * splat(NOISE_PERLIN2_SCALE / total);
+}
+
+inline F32 noise_fbm3(NoiseOctaves const& octaves, F32 x, F32 y, F32 z)
+{
+    auto sum = splat(0.0f);
+    auto frequency = octaves.frequency;
+    auto amplitude = 1.0f;
+    auto total = 0.0f;
+    for (auto i { 0u }; i < octaves.octaves; i++) {
+        auto f = splat(frequency);
+        auto n = noise_perlin3(x * f, y * f, z * f, splat_int(octaves.seed + i * 0x632be5abu));
+        sum = sum + n * splat(amplitude);
+        total += amplitude;
+        frequency *= octaves.lacunarity;
+        amplitude *= octaves.gain;
+    }
+    return sum * splat(NOISE_PERLIN3_SCALE / total);
+}
+
+// whole vectors first, the tail goes through a zero padded one.
+void noise_fbm2_batch(NoiseOctaves const& octaves, float const* x, float const* z, float* out, uint32_t count)
+{
+    auto i { 0u };
+    for (; i + NOISE_LANES <= count; i += NOISE_LANES)
+        store(out + i, noise_fbm2(octaves, load(x + i), load(z + i)));
+
+    if (i == count)
+        return;
+
+    float tail_x[NOISE_LANES] {};
+    float tail_z[NOISE_LANES] {};
+    float tail_out[NOISE_LANES];
+    for (auto j { 0u }; i + j < count; j++) {
+        tail_x[j] = x[i + j];
+        tail_z[j] = z[i + j];
+    }
+    store(tail_out, noise_fbm2(octaves, load(tail_x), load(tail_z)));
+    for (auto j { 0u }; i + j < count; j++)
+        out[i + j] = tail_out[j];
+}
+
+void noise_fbm3_batch(NoiseOctaves const& octaves, float const* x, float const* y, float const* z, float* out, uint32_t count)
+{
+    auto i { 0u };
+    for (; i + NOISE_LANES <= count; i += NOISE_LANES)
+        store(out + i, noise_fbm3(octaves, load(x + i), load(y + i), load(z + i)));
+
+    if (i == count)
+        return;
+
+    float tail_x[NOISE_LANES] {};
+    float tail_y[NOISE_LANES] {};
+    float tail_z[NOISE_LANES] {};
+    float tail_out[NOISE_LANES];
+    for (auto j { 0u }; i + j < count; j++) {
+        tail_x[j] = x[i + j];
+        tail_y[j] = y[i + j];
+        tail_z[j] = z[i + j];
+    }
+    store(tail_out, noise_fbm3(octaves, load(tail_x), load(tail_y), load(tail_z)));
+    for (auto j { 0u }; i + j < count; j++)
+        out[i + j] = tail_out[j];
+}
@@ -0,0 +1,50 @@
+#include "noise.h"
+
+#if defined(CPU_X86)
+
+#    include <smmintrin.h>
+
+namespace {
+
+#    define NOISE_LANES 4
+
+struct F32 {
+    __m128 v;
+};
+
+struct I32 {
+    __m128i v;
+};
+
+inline F32 operator+(F32 a, F32 b) { return { _mm_add_ps(a.v, b.v) }; }
+inline F32 operator-(F32 a, F32 b) { return { _mm_sub_ps(a.v, b.v) }; }
+inline F32 operator*(F32 a, F32 b) { return { _mm_mul_ps(a.v, b.v) }; }
+inline I32 operator+(I32 a, I32 b) { return { _mm_add_epi32(a.v, b.v) }; }
+inline I32 operator^(I32 a, I32 b) { return { _mm_xor_si128(a.v, b.v) }; }
+inline I32 operator&(I32 a, I32 b) { return { _mm_and_si128(a.v, b.v) }; }
+inline I32 operator|(I32 a, I32 b) { return { _mm_or_si128(a.v, b.v) }; }
+inline I32 mul(I32 a, I32 b) { return { _mm_mullo_epi32(a.v, b.v) }; }
+inline F32 splat(float value) { return { _mm_set1_ps(value) }; }
+inline I32 splat_int(uint32_t value) { return { _mm_set1_epi32(static_cast<int32_t>(value)) }; }
+inline F32 load(float const* data) { return { _mm_loadu_ps(data) }; }
+inline void store(float* data, F32 value) { _mm_storeu_ps(data, value.v); }
+inline F32 floor(F32 a) { return { _mm_floor_ps(a.v) }; }
+inline I32 to_int(F32 a) { return { _mm_cvttps_epi32(a.v) }; }
+inline I32 shift_left(I32 a, int bits) { return { _mm_slli_epi32(a.v, bits) }; }
+inline I32 shift_right(I32 a, int bits) { return { _mm_srli_epi32(a.v, bits) }; }
+inline F32 as_float(I32 a) { return { _mm_castsi128_ps(a.v) }; }
+inline I32 as_int(F32 a) { return { _mm_castps_si128(a.v) }; }
+inline F32 select(I32 mask, F32 a, F32 b) { return { _mm_blendv_ps(b.v, a.v, _mm_castsi128_ps(mask.v)) }; }
+inline I32 equal(I32 a, I32 b) { return { _mm_cmpeq_epi32(a.v, b.v) }; }
+
+#    include "noise_impl.h"
+
+}
+
+NoiseKernels const* get_noise_kernels_sse41()
+{
+    static NoiseKernels const kernels { CpuISA::SSE41, noise_fbm2_batch, noise_fbm3_batch };
+    return &kernels;
+}
+
+#endif
@@ -0,0 +1,297 @@
+#include <cstring>
+#include <filesystem>
+
+#include <fmt/base.h>
+
+#include "lz.h"
+#include "region_file.h"
+
+namespace {
+
+constexpr uint32_t REGION_FILE_MAGIC = 0x4E474552; // "REGN"
+constexpr uint32_t REGION_FILE_VERSION = 1;
+
+// compaction is not worth it for a few stale columns.
+constexpr uint64_t REGION_FILE_COMPACTION_MIN_GARBAGE = 1 << 20;
+
+struct RegionFileHeader {
+    uint32_t magic;
+    uint32_t version;
+};
+
+uint64_t hash_bytes(uint8_t const* data, size_t size)
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t i { 0 }; i < size; i++) {
+        hash ^= data[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+}
+
+bool RegionFile::open(std::string const& path)
+{
+    close();
+
+    m_path = path;
+    m_entries.assign(REGION_CHUNK_COUNT, {});
+
+    if (!std::filesystem::exists(m_path)) {
+        RegionFileHeader header {};
+        header.magic = REGION_FILE_MAGIC;
+        header.version = REGION_FILE_VERSION;
+
+        std::ofstream file(m_path, std::ios::binary | std::ios::trunc);
+        if (!file
+            || !file.write(reinterpret_cast<char const*>(&header), sizeof(header))
+            || !file.write(reinterpret_cast<char const*>(m_entries.data()), m_entries.size() * sizeof(Entry))) {
+            fmt::println(stderr, "RegionFile::open(): failed to create '{}'!", m_path);
+            return false;
+        }
+    }
+
+    m_file.open(m_path, std::ios::binary | std::ios::in | std::ios::out);
+    if (!m_file) {
+        fmt::println(stderr, "RegionFile::open(): failed to open '{}'!", m_path);
+        return false;
+    }
+
+    if (!load_table()) {
+        close();
+        return false;
+    }
+
+    if (!remap()) {
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void RegionFile::close()
+{
+    m_mapping.close();
+    if (m_file.is_open())
+        m_file.close();
+
+    m_entries.clear();
+    m_file_size = 0;
+    m_live_size = 0;
+    m_garbage_size = 0;
+}
+
+bool RegionFile::read(ChunkPosition position, Chunk& chunk)
+{
+    auto index = get_entry_index(position);
+
+    {
+        std::shared_lock lock(m_mutex);
+        if (m_entries.empty())
+            return false;
+
+        auto entry = m_entries[index];
+        if (entry.size == 0)
+            return false;
+
+        if (is_within(entry, m_mapping.get_size())) {
+            auto record = m_mapping.get_data() + entry.offset;
+            if (hash_bytes(record, entry.size) != entry.checksum) {
+                fmt::println(stderr, "RegionFile::read(): column ({}, {}) in '{}' is corrupt!", position.x, position.z, m_path);
+                return false;
+            }
+
+            std::vector<uint8_t> data(entry.raw_size);
+            if (!lz_decompress(record, entry.size, data.data(), data.size()) || !chunk.deserialize(data.data(), data.size())) {
+                fmt::println(stderr, "RegionFile::read(): column ({}, {}) in '{}' is corrupt!", position.x, position.z, m_path);
+                return false;
+            }
+
+            return true;
+        }
+    }
+
+    // the record was appended after the file was mapped.
+    {
+        std::unique_lock lock(m_mutex);
+        auto const& entry = m_entries[index];
+        if (!is_within(entry, m_mapping.get_size())) {
+            if (!remap())
+                return false;
+
+            if (!is_within(entry, m_mapping.get_size())) {
+                fmt::println(stderr, "RegionFile::read(): column ({}, {}) lies past the end of '{}'!", position.x, position.z, m_path);
+                return false;
+            }
+        }
+    }
+
+    return read(position, chunk);
+}
+
+bool RegionFile::write(ChunkPosition position, std::vector<uint8_t> const& data)
+{
+    std::vector<uint8_t> compressed(lz_compress_bound(data.size()));
+    compressed.resize(lz_compress(data.data(), data.size(), compressed.data()));
+
+    Entry entry {};
+    entry.size = compressed.size();
+    entry.raw_size = data.size();
+    entry.checksum = hash_bytes(compressed.data(), compressed.size());
+
+    std::unique_lock lock(m_mutex);
+    if (!m_file.is_open())
+        return false;
+
+    auto index = get_entry_index(position);
+    entry.offset = m_file_size;
+
+    // the record has to be on disk before the table points at it.
+    m_file.seekp(entry.offset);
+    m_file.write(reinterpret_cast<char const*>(compressed.data()), compressed.size());
+    m_file.flush();
+    m_file.seekp(sizeof(RegionFileHeader) + index * sizeof(Entry));
+    m_file.write(reinterpret_cast<char const*>(&entry), sizeof(entry));
+    m_file.flush();
+
+    if (!m_file) {
+        fmt::println(stderr, "RegionFile::write(): failed to write column ({}, {}) to '{}'!", position.x, position.z, m_path);
+        m_file.clear();
+        return false;
+    }
+
+    m_live_size += entry.size;
+    m_live_size -= m_entries[index].size;
+    m_garbage_size += m_entries[index].size;
+    m_entries[index] = entry;
+    m_file_size += entry.size;
+    return true;
+}
+
+bool RegionFile::needs_compaction() const
+{
+    auto live = m_live_size.load(std::memory_order_relaxed);
+    auto garbage = m_garbage_size.load(std::memory_order_relaxed);
+    return garbage > live && garbage > REGION_FILE_COMPACTION_MIN_GARBAGE;
+}
+
+bool RegionFile::compact()
+{
+    std::unique_lock lock(m_mutex);
+    if (!m_file.is_open())
+        return false;
+
+    // the mapping may trail behind the appends.
+    if (!remap())
+        return false;
+
+    RegionFileHeader header {};
+    header.magic = REGION_FILE_MAGIC;
+    header.version = REGION_FILE_VERSION;
+
+    std::vector<Entry> entries(REGION_CHUNK_COUNT);
+    uint64_t offset = sizeof(RegionFileHeader) + REGION_CHUNK_COUNT * sizeof(Entry);
+    for (auto i { 0u }; i < REGION_CHUNK_COUNT; i++) {
+        if (m_entries[i].size == 0)
+            continue;
+
+        entries[i] = m_entries[i];
+        entries[i].offset = offset;
+        offset += m_entries[i].size;
+    }
+
+    auto temp_path = m_path + ".tmp";
+    {
+        std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<char const*>(&header), sizeof(header));
+        file.write(reinterpret_cast<char const*>(entries.data()), entries.size() * sizeof(Entry));
+        for (auto const& entry : m_entries) {
+            if (entry.size > 0)
+                file.write(reinterpret_cast<char const*>(m_mapping.get_data() + entry.offset), entry.size);
+        }
+
+        if (!file.flush()) {
+            fmt::println(stderr, "RegionFile::compact(): failed to write '{}'!", temp_path);
+            return false;
+        }
+    }
+
+    // windows refuses to replace a file that is still mapped.
+    m_mapping.close();
+    m_file.close();
+
+    std::error_code error;
+    std::filesystem::rename(temp_path, m_path, error);
+    if (error)
+        fmt::println(stderr, "RegionFile::compact(): failed to replace '{}': {}", m_path, error.message());
+
+    m_file.open(m_path, std::ios::binary | std::ios::in | std::ios::out);
+    if (!m_file || !load_table() || !remap()) {
+        fmt::println(stderr, "RegionFile::compact(): failed to reopen '{}'!", m_path);
+        m_mapping.close();
+        m_file.close();
+        m_entries.clear();
+        return false;
+    }
+
+    return !error;
+}
+
+RegionFileStats RegionFile::get_stats() const
+{
+    std::shared_lock lock(m_mutex);
+    return { m_file_size, m_live_size.load(std::memory_order_relaxed) };
+}
+
+bool RegionFile::load_table()
+{
+    RegionFileHeader header {};
+    m_file.seekg(0, std::ios::end);
+    m_file_size = m_file.tellg();
+    m_file.seekg(0);
+
+    if (!m_file.read(reinterpret_cast<char*>(&header), sizeof(header))
+        || header.magic != REGION_FILE_MAGIC
+        || header.version != REGION_FILE_VERSION
+        || !m_file.read(reinterpret_cast<char*>(m_entries.data()), m_entries.size() * sizeof(Entry))) {
+        fmt::println(stderr, "RegionFile::load_table(): '{}' is not a region file!", m_path);
+        return false;
+    }
+
+    // a crash between an append and the table update leaves the old, complete record in place, so only
+    // entries pointing past the end are dropped. the table is untrusted, entries pointing into the header
+    // or claiming a larger column than any chunk serializes to are dropped as well.
+    uint64_t live {};
+    for (auto& entry : m_entries) {
+        if (entry.size == 0)
+            continue;
+
+        if (entry.offset < sizeof(RegionFileHeader) + REGION_CHUNK_COUNT * sizeof(Entry)
+            || entry.raw_size > CHUNK_MAX_SERIALIZED_SIZE) {
+            fmt::println(stderr, "RegionFile::load_table(): '{}' has a corrupt column, dropping it", m_path);
+            entry = {};
+        } else if (!is_within(entry, m_file_size)) {
+            fmt::println(stderr, "RegionFile::load_table(): '{}' has a truncated column, dropping it", m_path);
+            entry = {};
+        }
+        live += entry.size;
+    }
+
+    // records that were replaced and the ones dropped above. corrupt entries may overlap and add up to more.
+    auto records = m_file_size - sizeof(RegionFileHeader) - REGION_CHUNK_COUNT * sizeof(Entry);
+    m_live_size = live;
+    m_garbage_size = records > live ? records - live : 0;
+
+    return true;
+}
+
+bool RegionFile::remap()
+{
+    if (!m_mapping.open(m_path)) {
+        fmt::println(stderr, "RegionFile::remap(): failed to map '{}'!", m_path);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+#include "chunk.h"
+#include "helper.h"
+#include "mapped_file.h"
+
+// chunk columns per region along x and z.
+#define REGION_SIZE 32
+#define REGION_SIZE_LOG2 5
+#define REGION_CHUNK_COUNT (REGION_SIZE * REGION_SIZE)
+
+struct RegionPosition {
+    int32_t x;
+    int32_t z;
+
+    auto operator<=>(RegionPosition const&) const = default;
+};
+
+struct RegionPositionHash {
+    size_t operator()(RegionPosition position) const
+    {
+        auto key = (static_cast<uint64_t>(static_cast<uint32_t>(position.x)) << 32) | static_cast<uint32_t>(position.z);
+        return std::hash<uint64_t>()(key);
+    }
+};
+
+inline RegionPosition get_region_position(ChunkPosition position)
+{
+    return { position.x >> REGION_SIZE_LOG2, position.z >> REGION_SIZE_LOG2 };
+}
+
+struct RegionFileStats {
+    uint64_t file_size;
+    uint64_t live_size;
+};
+
+// one file per 32x32 chunk columns: a header with an offset table of every column, followed by the
+// compressed columns. writes append the new record and patch the table entry, the old record stays
+// behind as garbage until compact() rewrites the file. reads decompress straight from a mapping of the
+// file and may run on any number of threads, writes are serialized internally.
+class RegionFile {
+    MAKE_NON_COPYABLE(RegionFile);
+    MAKE_NON_MOVABLE(RegionFile);
+
+public:
+    RegionFile() = default;
+
+    // creates the file when it does not exist yet.
+    bool open(std::string const& path);
+
+    void close();
+
+    // false when the column is not stored or its record is corrupt.
+    bool read(ChunkPosition position, Chunk& chunk);
+
+    // data is the output of Chunk::serialize(), compressed before the file is locked.
+    bool write(ChunkPosition position, std::vector<uint8_t> const& data);
+
+    // true once more than half of the file is garbage. lock free, so it never waits for a write or compaction.
+    bool needs_compaction() const;
+
+    // rewrites the file with only the live records, readers and writers block meanwhile.
+    bool compact();
+
+    RegionFileStats get_stats() const;
+
+private:
+    struct Entry {
+        uint64_t offset;
+        uint32_t size;
+        uint32_t raw_size;
+        uint64_t checksum;
+    };
+
+    static uint32_t get_entry_index(ChunkPosition position)
+    {
+        return ((position.z & (REGION_SIZE - 1)) << REGION_SIZE_LOG2) | (position.x & (REGION_SIZE - 1));
+    }
+
+    // without adding offset and size, so a corrupt offset cannot wrap around.
+    static bool is_within(Entry const& entry, uint64_t size)
+    {
+        return entry.offset <= size && entry.size <= size - entry.offset;
+    }
+
+    bool load_table();
+
+    bool remap();
+
+private:
+    std::string m_path;
+
+    // shared by readers, exclusive for appends, remaps and compaction.
+    mutable std::shared_mutex m_mutex;
+    MappedFile m_mapping;
+    std::fstream m_file;
+    std::vector<Entry> m_entries;
+    uint64_t m_file_size {};
+
+    // bytes of the records the table points at and of the ones it no longer does. only changed under the
+    // exclusive lock, published for needs_compaction().
+    std::atomic<uint64_t> m_live_size {};
+    std::atomic<uint64_t> m_garbage_size {};
+};
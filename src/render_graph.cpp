@@ -0,0 +1,786 @@
+#include <algorithm>
+#include <numeric>
+
+#include "gpu_profiler.h"
+#include "render_graph.h"
+#include "vulkan_helper.h"
+
+namespace {
+
+constexpr VkAccessFlags2 WRITE_ACCESS_MASK = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT
+    | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT
+    | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT
+    | VK_ACCESS_2_TRANSFER_WRITE_BIT;
+
+struct AccessInfo {
+    VkPipelineStageFlags2 stage;
+    VkAccessFlags2 access;
+    VkImageLayout layout;
+    VkImageUsageFlags usage;
+    bool reads;
+    bool writes;
+};
+
+AccessInfo get_access_info(RGAccess access)
+{
+    constexpr auto fragment_tests = VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT;
+
+    switch (access) {
+    case RGAccess::ColorAttachmentWrite:
+        return {
+            VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+            VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+            VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+            false, true
+        };
+    case RGAccess::DepthAttachmentWrite:
+        return {
+            fragment_tests,
+            VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+            VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+            VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+            false, true
+        };
+    case RGAccess::DepthAttachmentRead:
+        return {
+            fragment_tests,
+            VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT,
+            VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+            VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+            true, false
+        };
+    case RGAccess::FragmentSampled:
+        return {
+            VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
+            VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            VK_IMAGE_USAGE_SAMPLED_BIT,
+            true, false
+        };
+    case RGAccess::ComputeSampled:
+        return {
+            VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+            VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            VK_IMAGE_USAGE_SAMPLED_BIT,
+            true, false
+        };
+    case RGAccess::ComputeStorageRead:
+        return {
+            VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+            VK_ACCESS_2_SHADER_STORAGE_READ_BIT,
+            VK_IMAGE_LAYOUT_GENERAL,
+            VK_IMAGE_USAGE_STORAGE_BIT,
+            true, false
+        };
+    // storage writes may be partial, so they keep the previous contents alive.
+    case RGAccess::ComputeStorageWrite:
+        return {
+            VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+            VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+            VK_IMAGE_LAYOUT_GENERAL,
+            VK_IMAGE_USAGE_STORAGE_BIT,
+            true, true
+        };
+    case RGAccess::VertexStorageRead:
+        return {
+            VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT,
+            VK_ACCESS_2_SHADER_STORAGE_READ_BIT,
+            VK_IMAGE_LAYOUT_GENERAL,
+            VK_IMAGE_USAGE_STORAGE_BIT,
+            true, false
+        };
+    case RGAccess::VertexAttributeRead:
+        return {
+            VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT,
+            VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT,
+            VK_IMAGE_LAYOUT_UNDEFINED,
+            0,
+            true, false
+        };
+    case RGAccess::IndexRead:
+        return {
+            VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT,
+            VK_ACCESS_2_INDEX_READ_BIT,
+            VK_IMAGE_LAYOUT_UNDEFINED,
+            0,
+            true, false
+        };
+    case RGAccess::IndirectRead:
+        return {
+            VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT,
+            VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT,
+            VK_IMAGE_LAYOUT_UNDEFINED,
+            0,
+            true, false
+        };
+    case RGAccess::TransferRead:
+        return {
+            VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+            VK_ACCESS_2_TRANSFER_READ_BIT,
+            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+            true, false
+        };
+    case RGAccess::TransferWrite:
+        return {
+            VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+            VK_ACCESS_2_TRANSFER_WRITE_BIT,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+            false, true
+        };
+    case RGAccess::Present:
+        return {
+            VK_PIPELINE_STAGE_2_BOTTOM_OF_PIPE_BIT,
+            VK_ACCESS_2_NONE,
+            VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+            0,
+            true, false
+        };
+    }
+
+    return {};
+}
+
+VkImageAspectFlags get_aspect(VkFormat format)
+{
+    switch (format) {
+    case VK_FORMAT_D16_UNORM:
+    case VK_FORMAT_X8_D24_UNORM_PACK32:
+    case VK_FORMAT_D32_SFLOAT:
+        return VK_IMAGE_ASPECT_DEPTH_BIT;
+    case VK_FORMAT_D16_UNORM_S8_UINT:
+    case VK_FORMAT_D24_UNORM_S8_UINT:
+    case VK_FORMAT_D32_SFLOAT_S8_UINT:
+        return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+    case VK_FORMAT_S8_UINT:
+        return VK_IMAGE_ASPECT_STENCIL_BIT;
+    default:
+        return VK_IMAGE_ASPECT_COLOR_BIT;
+    }
+}
+
+}
+
+VkImage RGPassContext::get_image(RGImage image) const
+{
+    return m_graph->get_image(image);
+}
+
+VkImageView RGPassContext::get_image_view(RGImage image) const
+{
+    return m_graph->get_image_view(image);
+}
+
+VkBuffer RGPassContext::get_buffer(RGBuffer buffer) const
+{
+    return m_graph->get_buffer(buffer);
+}
+
+RGPassBuilder& RGPassBuilder::add_color_attachment(
+    RGImage image,
+    VkAttachmentLoadOp load_op,
+    VkClearColorValue clear_value)
+{
+    auto& pass = m_graph->m_passes[m_pass_index];
+    pass.color_attachments.push_back({ image.index, load_op, { .color = clear_value } });
+    m_graph->add_use(m_pass_index, image.index, RGAccess::ColorAttachmentWrite, load_op == VK_ATTACHMENT_LOAD_OP_LOAD);
+
+    return *this;
+}
+
+RGPassBuilder& RGPassBuilder::set_depth_attachment(
+    RGImage image,
+    VkAttachmentLoadOp load_op,
+    float clear_depth,
+    bool write)
+{
+    auto& pass = m_graph->m_passes[m_pass_index];
+    pass.depth_attachment = { image.index, load_op, { .depthStencil = { clear_depth, 0 } } };
+    m_graph->add_use(
+        m_pass_index, image.index,
+        write ? RGAccess::DepthAttachmentWrite : RGAccess::DepthAttachmentRead,
+        load_op == VK_ATTACHMENT_LOAD_OP_LOAD);
+
+    return *this;
+}
+
+RGPassBuilder& RGPassBuilder::use(RGImage image, RGAccess access)
+{
+    m_graph->add_use(m_pass_index, image.index, access, false);
+    return *this;
+}
+
+RGPassBuilder& RGPassBuilder::use(RGBuffer buffer, RGAccess access)
+{
+    m_graph->add_use(m_pass_index, buffer.index, access, false);
+    return *this;
+}
+
+RGPassBuilder& RGPassBuilder::set_side_effects()
+{
+    m_graph->m_passes[m_pass_index].side_effects = true;
+    return *this;
+}
+
+RGPassBuilder& RGPassBuilder::set_execute(std::function<void(RGPassContext& context)> execute)
+{
+    m_graph->m_passes[m_pass_index].execute = std::move(execute);
+    return *this;
+}
+
+void RenderGraph::init(RenderGraphInfo const& info)
+{
+    m_device = info.device;
+    m_allocator = info.allocator;
+    m_defer_destroy = info.defer_destroy;
+}
+
+void RenderGraph::deinit()
+{
+    destroy_transients(false);
+    reset();
+}
+
+void RenderGraph::reset()
+{
+    m_resources.clear();
+    m_passes.clear();
+}
+
+RGImage RenderGraph::import_image(std::string_view name, RGImportedImageInfo const& info)
+{
+    Resource resource {};
+    resource.name = name;
+    resource.is_image = true;
+    resource.imported = true;
+    resource.image = info.image;
+    resource.image_view = info.image_view;
+    resource.format = info.format;
+    resource.extent = info.extent;
+    resource.aspect = get_aspect(info.format);
+    resource.final_access = info.final_access;
+    resource.state.layout = info.initial_layout;
+    resource.state.write_stage = info.initial_stage;
+    resource.state.write_access = info.initial_access;
+
+    m_resources.push_back(std::move(resource));
+    return { static_cast<uint32_t>(m_resources.size() - 1) };
+}
+
+RGBuffer RenderGraph::import_buffer(std::string_view name, RGImportedBufferInfo const& info)
+{
+    Resource resource {};
+    resource.name = name;
+    resource.is_image = false;
+    resource.imported = true;
+    resource.buffer = info.buffer;
+    resource.size = info.size;
+    resource.state.write_stage = info.initial_stage;
+    resource.state.write_access = info.initial_access;
+
+    m_resources.push_back(std::move(resource));
+    return { static_cast<uint32_t>(m_resources.size() - 1) };
+}
+
+RGImage RenderGraph::create_image(std::string_view name, RGImageDesc const& desc)
+{
+    Resource resource {};
+    resource.name = name;
+    resource.is_image = true;
+    resource.imported = false;
+    resource.format = desc.format;
+    resource.extent = desc.extent;
+    resource.aspect = get_aspect(desc.format);
+
+    m_resources.push_back(std::move(resource));
+    return { static_cast<uint32_t>(m_resources.size() - 1) };
+}
+
+RGPassBuilder RenderGraph::add_pass(std::string_view name)
+{
+    Pass pass {};
+    pass.name = name;
+
+    m_passes.push_back(std::move(pass));
+    return RGPassBuilder(this, m_passes.size() - 1);
+}
+
+void RenderGraph::execute(VkCommandBuffer cmd_buffer, GPUProfiler* profiler, uint32_t frame_index)
+{
+    m_stats = {};
+    m_stats.pass_count = m_passes.size();
+
+    cull_passes();
+    place_transients();
+
+    std::vector<VkImageMemoryBarrier2> image_barriers;
+    std::vector<VkBufferMemoryBarrier2> buffer_barriers;
+
+    // pipeline statistics queries may span several rendering instances as long as they start and end outside of them.
+    profiler->begin_pipeline_statistics(cmd_buffer, frame_index);
+
+    for (uint32_t i { 0 }; i < m_passes.size(); i++) {
+        auto const& pass = m_passes[i];
+        if (pass.culled) {
+            m_stats.culled_pass_count++;
+            continue;
+        }
+
+        profiler->push_scope(cmd_buffer, frame_index, pass.name);
+
+        for (auto const& use : pass.uses) {
+            auto& resource = m_resources[use.resource];
+
+            // the first use of a transient image has to wait for whatever last touched its memory.
+            if (resource.transient_index != UINT32_MAX && resource.first_pass == i) {
+                auto const& block = m_transient_blocks[m_transient_images[resource.transient_index].block];
+                resource.state = {};
+                resource.state.write_stage = block.stages;
+                resource.state.write_access = block.access;
+            }
+
+            derive_barrier(use, image_barriers, buffer_barriers);
+        }
+
+        flush_barriers(cmd_buffer, image_barriers, buffer_barriers);
+        record_pass(cmd_buffer, pass);
+
+        profiler->pop_scope(cmd_buffer, frame_index);
+    }
+
+    profiler->end_pipeline_statistics(cmd_buffer, frame_index);
+
+    for (uint32_t i { 0 }; i < m_resources.size(); i++) {
+        auto const& resource = m_resources[i];
+        if (!resource.final_access)
+            continue;
+
+        auto info = get_access_info(*resource.final_access);
+        derive_barrier({ i, info.stage, info.access, info.layout, info.reads, info.writes }, image_barriers, buffer_barriers);
+    }
+
+    if (!image_barriers.empty() || !buffer_barriers.empty()) {
+        profiler->push_scope(cmd_buffer, frame_index, "barrier_to_final");
+        flush_barriers(cmd_buffer, image_barriers, buffer_barriers);
+        profiler->pop_scope(cmd_buffer, frame_index);
+    }
+}
+
+void RenderGraph::transition(VkCommandBuffer cmd_buffer, RGImage image, RGAccess access)
+{
+    std::vector<VkImageMemoryBarrier2> image_barriers;
+    std::vector<VkBufferMemoryBarrier2> buffer_barriers;
+
+    auto info = get_access_info(access);
+    derive_barrier({ image.index, info.stage, info.access, info.layout, info.reads, info.writes }, image_barriers, buffer_barriers);
+    flush_barriers(cmd_buffer, image_barriers, buffer_barriers);
+}
+
+void RenderGraph::add_use(uint32_t pass_index, uint32_t resource, RGAccess access, bool load)
+{
+    auto& pass = m_passes[pass_index];
+    auto info = get_access_info(access);
+
+    if (m_resources[resource].is_image)
+        m_resources[resource].usage |= info.usage;
+
+    for (auto& use : pass.uses) {
+        if (use.resource != resource)
+            continue;
+
+        if (m_resources[resource].is_image && use.layout != info.layout) {
+            fmt::println(stderr, "RenderGraph: pass '{}' uses '{}' in two different layouts!", pass.name, m_resources[resource].name);
+            return;
+        }
+
+        use.stage |= info.stage;
+        use.access |= info.access;
+        use.reads |= info.reads || load;
+        use.writes |= info.writes;
+        return;
+    }
+
+    pass.uses.push_back({ resource, info.stage, info.access, info.layout, info.reads || load, info.writes });
+}
+
+void RenderGraph::cull_passes()
+{
+    // walks backwards, a pass survives if it has side effects or writes something a surviving pass reads.
+    std::vector<bool> needed(m_resources.size(), false);
+
+    for (auto i = static_cast<int32_t>(m_passes.size()) - 1; i >= 0; i--) {
+        auto& pass = m_passes[i];
+
+        auto keep = pass.side_effects;
+        for (auto const& use : pass.uses) {
+            if (use.writes && (m_resources[use.resource].imported || needed[use.resource]))
+                keep = true;
+        }
+
+        pass.culled = !keep;
+        if (!keep)
+            continue;
+
+        // a full overwrite ends the dependency chain, earlier writers are dead unless read in between.
+        for (auto const& use : pass.uses) {
+            if (use.writes && !use.reads)
+                needed[use.resource] = false;
+        }
+
+        for (auto const& use : pass.uses) {
+            if (use.reads)
+                needed[use.resource] = true;
+        }
+    }
+
+    for (uint32_t i { 0 }; i < m_passes.size(); i++) {
+        if (m_passes[i].culled)
+            continue;
+
+        for (auto const& use : m_passes[i].uses) {
+            auto& resource = m_resources[use.resource];
+            resource.first_pass = std::min(resource.first_pass, i);
+            resource.last_pass = std::max(resource.last_pass, i);
+        }
+    }
+}
+
+void RenderGraph::place_transients()
+{
+    std::vector<uint32_t> transients;
+    std::vector<uint32_t> signature;
+
+    for (uint32_t i { 0 }; i < m_resources.size(); i++) {
+        auto const& resource = m_resources[i];
+        if (resource.imported || !resource.is_image || resource.first_pass == UINT32_MAX)
+            continue;
+
+        transients.push_back(i);
+        signature.insert(signature.end(), {
+            static_cast<uint32_t>(resource.format),
+            resource.extent.width,
+            resource.extent.height,
+            resource.usage,
+            resource.first_pass,
+            resource.last_pass,
+        });
+    }
+
+    // the same set of transients with the same lifetimes keeps its images and placement across frames.
+    if (signature != m_transient_signature) {
+        destroy_transients(true);
+
+        std::vector<VkMemoryRequirements> requirements(transients.size());
+        m_transient_images.resize(transients.size());
+
+        for (auto i { 0 }; i < transients.size(); i++) {
+            auto const& resource = m_resources[transients[i]];
+
+            VkImageCreateInfo image_create_info {};
+            image_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+            image_create_info.imageType = VK_IMAGE_TYPE_2D;
+            image_create_info.format = resource.format;
+            image_create_info.extent = { resource.extent.width, resource.extent.height, 1 };
+            image_create_info.mipLevels = 1;
+            image_create_info.arrayLayers = 1;
+            image_create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+            image_create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+            image_create_info.usage = resource.usage;
+            image_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            image_create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+            VK_CHECK(vkCreateImage(m_device, &image_create_info, nullptr, &m_transient_images[i].image));
+            vkGetImageMemoryRequirements(m_device, m_transient_images[i].image, &requirements[i]);
+        }
+
+        // largest first, each image goes into the first block it fits whose images are all dead or not yet alive.
+        std::vector<uint32_t> order(transients.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+            return requirements[a].size > requirements[b].size;
+        });
+
+        std::vector<std::vector<uint32_t>> block_members;
+        m_transient_memory_size_unaliased = 0;
+
+        for (auto i : order) {
+            auto const& resource = m_resources[transients[i]];
+            auto const& requirement = requirements[i];
+            m_transient_memory_size_unaliased += requirement.size;
+
+            auto block_index = UINT32_MAX;
+            for (uint32_t b { 0 }; b < m_transient_blocks.size() && block_index == UINT32_MAX; b++) {
+                auto const& block = m_transient_blocks[b];
+                if ((block.type_bits & requirement.memoryTypeBits) == 0 || block.size < requirement.size)
+                    continue;
+
+                auto overlaps = std::any_of(block_members[b].begin(), block_members[b].end(), [&](uint32_t member) {
+                    auto const& other = m_resources[transients[member]];
+                    return resource.first_pass <= other.last_pass && other.first_pass <= resource.last_pass;
+                });
+
+                if (!overlaps)
+                    block_index = b;
+            }
+
+            if (block_index == UINT32_MAX) {
+                block_index = m_transient_blocks.size();
+                m_transient_blocks.push_back({ {}, requirement.size, 1, requirement.memoryTypeBits, VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE });
+                block_members.emplace_back();
+            }
+
+            m_transient_blocks[block_index].type_bits &= requirement.memoryTypeBits;
+            m_transient_blocks[block_index].alignment = std::max(m_transient_blocks[block_index].alignment, requirement.alignment);
+            block_members[block_index].push_back(i);
+            m_transient_images[i].block = block_index;
+        }
+
+        for (auto& block : m_transient_blocks)
+            block.allocation = m_allocator->allocate({ block.size, block.alignment, block.type_bits }, VKHMemoryUsage::GPUOnly, false);
+
+        for (auto i { 0 }; i < transients.size(); i++) {
+            auto const& resource = m_resources[transients[i]];
+            auto& transient = m_transient_images[i];
+
+            auto const& allocation = m_transient_blocks[transient.block].allocation;
+            VK_CHECK(vkBindImageMemory(m_device, transient.image, allocation.memory, allocation.offset));
+
+            VkImageViewCreateInfo image_view_create_info {};
+            image_view_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+            image_view_create_info.image = transient.image;
+            image_view_create_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+            image_view_create_info.format = resource.format;
+            image_view_create_info.components = {
+                VK_COMPONENT_SWIZZLE_IDENTITY,
+                VK_COMPONENT_SWIZZLE_IDENTITY,
+                VK_COMPONENT_SWIZZLE_IDENTITY,
+                VK_COMPONENT_SWIZZLE_IDENTITY,
+            };
+            image_view_create_info.subresourceRange = { resource.aspect, 0, 1, 0, 1 };
+
+            VK_CHECK(vkCreateImageView(m_device, &image_view_create_info, nullptr, &transient.image_view));
+        }
+
+        m_transient_signature = std::move(signature);
+    }
+
+    for (auto i { 0 }; i < transients.size(); i++) {
+        auto& resource = m_resources[transients[i]];
+        resource.image = m_transient_images[i].image;
+        resource.image_view = m_transient_images[i].image_view;
+        resource.transient_index = i;
+    }
+
+    m_stats.transient_image_count = m_transient_images.size();
+    m_stats.transient_memory_size_unaliased = m_transient_memory_size_unaliased;
+    for (auto const& block : m_transient_blocks)
+        m_stats.transient_memory_size += block.size;
+}
+
+void RenderGraph::destroy_transients(bool deferred)
+{
+    auto destroy = [device = m_device, allocator = m_allocator, images = std::move(m_transient_images), blocks = std::move(m_transient_blocks)]() mutable {
+        for (auto const& image : images) {
+            vkDestroyImageView(device, image.image_view, nullptr);
+            vkDestroyImage(device, image.image, nullptr);
+        }
+
+        for (auto& block : blocks)
+            allocator->free(block.allocation);
+    };
+
+    if (deferred && m_defer_destroy) {
+        m_defer_destroy(std::move(destroy));
+    } else {
+        destroy();
+    }
+
+    m_transient_images.clear();
+    m_transient_blocks.clear();
+    m_transient_signature.clear();
+}
+
+void RenderGraph::derive_barrier(
+    Use const& use,
+    std::vector<VkImageMemoryBarrier2>& image_barriers,
+    std::vector<VkBufferMemoryBarrier2>& buffer_barriers)
+{
+    auto& resource = m_resources[use.resource];
+    auto& state = resource.state;
+
+    auto layout_changes = resource.is_image && state.layout != use.layout;
+    auto previous_stages = state.write_stage | state.read_stages;
+
+    VkPipelineStageFlags2 src_stage { VK_PIPELINE_STAGE_2_NONE };
+    VkAccessFlags2 src_access { VK_ACCESS_2_NONE };
+    auto needs_barrier = false;
+
+    if (layout_changes || use.writes) {
+        // writes wait on every earlier read and write, a layout transition counts as a write.
+        needs_barrier = layout_changes || previous_stages != VK_PIPELINE_STAGE_2_NONE;
+        src_stage = previous_stages;
+        src_access = state.write_access;
+
+        state.write_stage = use.stage;
+        state.write_access = use.writes ? use.access & WRITE_ACCESS_MASK : VK_ACCESS_2_NONE;
+        state.read_stages = use.writes ? VK_PIPELINE_STAGE_2_NONE : use.stage;
+        state.visible_stages = use.writes ? VK_PIPELINE_STAGE_2_NONE : use.stage;
+        state.visible_access = use.writes ? VK_ACCESS_2_NONE : use.access;
+    } else {
+        // reads only wait on the last write, and only once per stage and access it is made visible to.
+        needs_barrier = state.write_stage != VK_PIPELINE_STAGE_2_NONE
+            && ((use.stage & ~state.visible_stages) != 0 || (use.access & ~state.visible_access) != 0);
+        src_stage = state.write_stage;
+        src_access = state.write_access;
+
+        state.read_stages |= use.stage;
+        if (needs_barrier) {
+            state.visible_stages |= use.stage;
+            state.visible_access |= use.access;
+        }
+    }
+
+    if (resource.transient_index != UINT32_MAX) {
+        auto& block = m_transient_blocks[m_transient_images[resource.transient_index].block];
+        block.stages = state.write_stage | state.read_stages;
+        block.access = state.write_access;
+    }
+
+    if (!needs_barrier)
+        return;
+
+    m_stats.barrier_count++;
+
+    if (resource.is_image) {
+        VkImageMemoryBarrier2 image_barrier {};
+        image_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+        image_barrier.srcStageMask = src_stage;
+        image_barrier.srcAccessMask = src_access;
+        image_barrier.dstStageMask = use.stage;
+        image_barrier.dstAccessMask = use.access;
+        image_barrier.oldLayout = layout_changes ? state.layout : use.layout;
+        image_barrier.newLayout = use.layout;
+        image_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        image_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        image_barrier.image = resource.image;
+        image_barrier.subresourceRange = {
+            resource.aspect,
+            0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS
+        };
+        image_barriers.push_back(image_barrier);
+    } else {
+        VkBufferMemoryBarrier2 buffer_barrier {};
+        buffer_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2;
+        buffer_barrier.srcStageMask = src_stage;
+        buffer_barrier.srcAccessMask = src_access;
+        buffer_barrier.dstStageMask = use.stage;
+        buffer_barrier.dstAccessMask = use.access;
+        buffer_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        buffer_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        buffer_barrier.buffer = resource.buffer;
+        buffer_barrier.offset = 0;
+        buffer_barrier.size = VK_WHOLE_SIZE;
+        buffer_barriers.push_back(buffer_barrier);
+    }
+
+    if (resource.is_image)
+        state.layout = use.layout;
+}
+
+void RenderGraph::flush_barriers(
+    VkCommandBuffer cmd_buffer,
+    std::vector<VkImageMemoryBarrier2>& image_barriers,
+    std::vector<VkBufferMemoryBarrier2>& buffer_barriers)
+{
+    if (image_barriers.empty() && buffer_barriers.empty())
+        return;
+
+    VkDependencyInfo dep_info {};
+    dep_info.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+    dep_info.imageMemoryBarrierCount = image_barriers.size();
+    dep_info.pImageMemoryBarriers = image_barriers.data();
+    dep_info.bufferMemoryBarrierCount = buffer_barriers.size();
+    dep_info.pBufferMemoryBarriers = buffer_barriers.data();
+    vkCmdPipelineBarrier2(cmd_buffer, &dep_info);
+
+    m_stats.barrier_batch_count++;
+
+    image_barriers.clear();
+    buffer_barriers.clear();
+}
+
+void RenderGraph::record_pass(VkCommandBuffer cmd_buffer, Pass const& pass)
+{
+    auto renders = !pass.color_attachments.empty() || pass.depth_attachment;
+
+    VkExtent2D extent {};
+    if (!pass.color_attachments.empty()) {
+        extent = m_resources[pass.color_attachments.front().resource].extent;
+    } else if (pass.depth_attachment) {
+        extent = m_resources[pass.depth_attachment->resource].extent;
+    }
+
+    if (renders) {
+        std::vector<VkRenderingAttachmentInfo> color_attachments;
+        color_attachments.reserve(pass.color_attachments.size());
+
+        for (auto const& attachment : pass.color_attachments) {
+            VkRenderingAttachmentInfo color_attachment {};
+            color_attachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+            color_attachment.imageView = m_resources[attachment.resource].image_view;
+            color_attachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+            color_attachment.resolveMode = VK_RESOLVE_MODE_NONE;
+            color_attachment.loadOp = attachment.load_op;
+            color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+            color_attachment.clearValue = attachment.clear_value;
+            color_attachments.push_back(color_attachment);
+        }
+
+        VkRenderingAttachmentInfo depth_attachment {};
+        if (pass.depth_attachment) {
+            auto const& resource = m_resources[pass.depth_attachment->resource];
+            depth_attachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+            depth_attachment.imageView = resource.image_view;
+            depth_attachment.imageLayout = resource.state.layout;
+            depth_attachment.resolveMode = VK_RESOLVE_MODE_NONE;
+            depth_attachment.loadOp = pass.depth_attachment->load_op;
+            depth_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+            depth_attachment.clearValue = pass.depth_attachment->clear_value;
+        }
+
+        VkRenderingInfo rendering_info {};
+        rendering_info.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+        rendering_info.renderArea = { { 0, 0 }, extent };
+        rendering_info.layerCount = 1;
+        rendering_info.viewMask = 0;
+        rendering_info.colorAttachmentCount = color_attachments.size();
+        rendering_info.pColorAttachments = color_attachments.data();
+        rendering_info.pDepthAttachment = pass.depth_attachment ? &depth_attachment : nullptr;
+        vkCmdBeginRendering(cmd_buffer, &rendering_info);
+
+        VkViewport viewport {};
+        viewport.x = 0.0f;
+        viewport.y = 0.0f;
+        viewport.width = static_cast<float>(extent.width);
+        viewport.height = static_cast<float>(extent.height);
+        viewport.minDepth = 0.0f;
+        viewport.maxDepth = 1.0f;
+
+        VkRect2D scissor {};
+        scissor.offset = { 0, 0 };
+        scissor.extent = extent;
+
+        vkCmdSetViewport(cmd_buffer, 0, 1, &viewport);
+        vkCmdSetScissor(cmd_buffer, 0, 1, &scissor);
+    }
+
+    RGPassContext context(this, cmd_buffer, extent);
+    if (pass.execute)
+        pass.execute(context);
+
+    if (renders)
+        vkCmdEndRendering(cmd_buffer);
+}
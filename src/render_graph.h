@@ -0,0 +1,308 @@
+#pragma once
+
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "helper.h"
+#include "vulkan.h"
+#include "vulkan_allocator.h"
+
+class GPUProfiler;
+class RenderGraph;
+
+struct RGImage {
+    uint32_t index { UINT32_MAX };
+
+    operator bool() const { return index != UINT32_MAX; }
+};
+
+struct RGBuffer {
+    uint32_t index { UINT32_MAX };
+
+    operator bool() const { return index != UINT32_MAX; }
+};
+
+// every way a pass can touch a resource, the graph derives stages, access masks and layouts from these.
+enum class RGAccess {
+    ColorAttachmentWrite,
+    DepthAttachmentWrite,
+    DepthAttachmentRead,
+    FragmentSampled,
+    ComputeSampled,
+    ComputeStorageRead,
+    ComputeStorageWrite,
+    VertexStorageRead,
+    VertexAttributeRead,
+    IndexRead,
+    IndirectRead,
+    TransferRead,
+    TransferWrite,
+    Present,
+};
+
+struct RGImportedImageInfo {
+    VkImage image;
+    VkImageView image_view;
+    VkFormat format;
+    VkExtent2D extent;
+
+    VkImageLayout initial_layout { VK_IMAGE_LAYOUT_UNDEFINED };
+
+    // the first barrier waits on these, e.g. the stage a swapchain acquire semaphore is waited at.
+    VkPipelineStageFlags2 initial_stage { VK_PIPELINE_STAGE_2_NONE };
+    VkAccessFlags2 initial_access { VK_ACCESS_2_NONE };
+
+    // state the image is left in once the graph has executed.
+    std::optional<RGAccess> final_access;
+};
+
+struct RGImportedBufferInfo {
+    VkBuffer buffer;
+    VkDeviceSize size;
+
+    VkPipelineStageFlags2 initial_stage { VK_PIPELINE_STAGE_2_NONE };
+    VkAccessFlags2 initial_access { VK_ACCESS_2_NONE };
+};
+
+// transient images live only within one graph execution and may share memory with each other.
+struct RGImageDesc {
+    VkFormat format;
+    VkExtent2D extent;
+};
+
+class RGPassContext {
+public:
+    RGPassContext(RenderGraph const* graph, VkCommandBuffer cmd_buffer, VkExtent2D render_extent)
+        : m_graph(graph)
+        , m_cmd_buffer(cmd_buffer)
+        , m_render_extent(render_extent)
+    {
+    }
+
+    VkCommandBuffer get_cmd_buffer() const { return m_cmd_buffer; }
+
+    // extent of the pass' attachments, zero for passes without any.
+    VkExtent2D get_render_extent() const { return m_render_extent; }
+
+    VkImage get_image(RGImage image) const;
+
+    VkImageView get_image_view(RGImage image) const;
+
+    VkBuffer get_buffer(RGBuffer buffer) const;
+
+private:
+    RenderGraph const* m_graph { nullptr };
+    VkCommandBuffer m_cmd_buffer { nullptr };
+    VkExtent2D m_render_extent {};
+};
+
+class RGPassBuilder {
+public:
+    RGPassBuilder(RenderGraph* graph, uint32_t pass_index)
+        : m_graph(graph)
+        , m_pass_index(pass_index)
+    {
+    }
+
+    // attachments are bound in the order they are added, the pass then runs inside dynamic rendering.
+    RGPassBuilder& add_color_attachment(
+        RGImage image,
+        VkAttachmentLoadOp load_op = VK_ATTACHMENT_LOAD_OP_CLEAR,
+        VkClearColorValue clear_value = {});
+
+    RGPassBuilder& set_depth_attachment(
+        RGImage image,
+        VkAttachmentLoadOp load_op = VK_ATTACHMENT_LOAD_OP_CLEAR,
+        float clear_depth = 1.0f,
+        bool write = true);
+
+    RGPassBuilder& use(RGImage image, RGAccess access);
+
+    RGPassBuilder& use(RGBuffer buffer, RGAccess access);
+
+    // keeps the pass even when nothing it writes is consumed, e.g. readbacks or queries.
+    RGPassBuilder& set_side_effects();
+
+    RGPassBuilder& set_execute(std::function<void(RGPassContext& context)> execute);
+
+private:
+    RenderGraph* m_graph { nullptr };
+    uint32_t m_pass_index {};
+};
+
+struct RenderGraphInfo {
+    VkDevice device;
+    VKHAllocator* allocator;
+
+    // retires transient images once every frame that may still use them has completed.
+    std::function<void(std::function<void()>)> defer_destroy;
+};
+
+struct RenderGraphStats {
+    uint32_t pass_count;
+    uint32_t culled_pass_count;
+    uint32_t barrier_count;
+    uint32_t barrier_batch_count;
+    uint32_t transient_image_count;
+    VkDeviceSize transient_memory_size;
+    VkDeviceSize transient_memory_size_unaliased;
+};
+
+class RenderGraph {
+    MAKE_NON_COPYABLE(RenderGraph);
+    MAKE_NON_MOVABLE(RenderGraph);
+
+public:
+    RenderGraph() = default;
+
+    void init(RenderGraphInfo const& info);
+
+    // destroys the transient images immediately, the device must be idle.
+    void deinit();
+
+    // drops every pass and resource of the previous frame, transient memory is kept when the next frame matches.
+    void reset();
+
+    RGImage import_image(std::string_view name, RGImportedImageInfo const& info);
+
+    RGBuffer import_buffer(std::string_view name, RGImportedBufferInfo const& info);
+
+    RGImage create_image(std::string_view name, RGImageDesc const& desc);
+
+    // passes run in the order they are added, a pass depends on every earlier pass touching the same resources.
+    RGPassBuilder add_pass(std::string_view name);
+
+    // culls passes whose results are never consumed, places transient images, then records every
+    // remaining pass with one batched barrier in front of it. imported images end in their final state.
+    void execute(VkCommandBuffer cmd_buffer, GPUProfiler* profiler, uint32_t frame_index);
+
+    // records the barrier needed to access image outside of any pass.
+    void transition(VkCommandBuffer cmd_buffer, RGImage image, RGAccess access);
+
+    VkImage get_image(RGImage image) const { return m_resources[image.index].image; }
+
+    VkImageView get_image_view(RGImage image) const { return m_resources[image.index].image_view; }
+
+    VkExtent2D get_image_extent(RGImage image) const { return m_resources[image.index].extent; }
+
+    VkBuffer get_buffer(RGBuffer buffer) const { return m_resources[buffer.index].buffer; }
+
+    RenderGraphStats const& get_stats() const { return m_stats; }
+
+private:
+    friend class RGPassBuilder;
+
+    struct State {
+        VkImageLayout layout { VK_IMAGE_LAYOUT_UNDEFINED };
+        VkPipelineStageFlags2 write_stage { VK_PIPELINE_STAGE_2_NONE };
+        VkAccessFlags2 write_access { VK_ACCESS_2_NONE };
+        VkPipelineStageFlags2 read_stages { VK_PIPELINE_STAGE_2_NONE };
+        VkPipelineStageFlags2 visible_stages { VK_PIPELINE_STAGE_2_NONE };
+        VkAccessFlags2 visible_access { VK_ACCESS_2_NONE };
+    };
+
+    struct Resource {
+        std::string name;
+        bool is_image;
+        bool imported;
+
+        VkImage image { nullptr };
+        VkImageView image_view { nullptr };
+        VkFormat format { VK_FORMAT_UNDEFINED };
+        VkExtent2D extent {};
+        VkImageAspectFlags aspect {};
+        VkImageUsageFlags usage {};
+        std::optional<RGAccess> final_access;
+
+        VkBuffer buffer { nullptr };
+        VkDeviceSize size {};
+
+        State state;
+
+        uint32_t first_pass { UINT32_MAX };
+        uint32_t last_pass {};
+        uint32_t transient_index { UINT32_MAX };
+    };
+
+    struct Use {
+        uint32_t resource;
+        VkPipelineStageFlags2 stage;
+        VkAccessFlags2 access;
+        VkImageLayout layout;
+        bool reads;
+        bool writes;
+    };
+
+    struct Attachment {
+        uint32_t resource;
+        VkAttachmentLoadOp load_op;
+        VkClearValue clear_value;
+    };
+
+    struct Pass {
+        std::string name;
+        std::vector<Use> uses;
+        std::vector<Attachment> color_attachments;
+        std::optional<Attachment> depth_attachment;
+        std::function<void(RGPassContext& context)> execute;
+        bool side_effects { false };
+        bool culled { false };
+    };
+
+    struct TransientImage {
+        VkImage image;
+        VkImageView image_view;
+        uint32_t block;
+    };
+
+    struct TransientBlock {
+        VKHAllocation allocation;
+        VkDeviceSize size;
+        VkDeviceSize alignment;
+        uint32_t type_bits;
+
+        // last use of any image placed in this block, the next image's first barrier waits on it.
+        VkPipelineStageFlags2 stages;
+        VkAccessFlags2 access;
+    };
+
+    // load marks attachments whose previous contents are kept, they count as reads for culling.
+    void add_use(uint32_t pass_index, uint32_t resource, RGAccess access, bool load);
+
+    void cull_passes();
+
+    void place_transients();
+
+    void destroy_transients(bool deferred);
+
+    // appends the barrier needed before use, if any, and advances the resource's state.
+    void derive_barrier(
+        Use const& use,
+        std::vector<VkImageMemoryBarrier2>& image_barriers,
+        std::vector<VkBufferMemoryBarrier2>& buffer_barriers);
+
+    void flush_barriers(
+        VkCommandBuffer cmd_buffer,
+        std::vector<VkImageMemoryBarrier2>& image_barriers,
+        std::vector<VkBufferMemoryBarrier2>& buffer_barriers);
+
+    void record_pass(VkCommandBuffer cmd_buffer, Pass const& pass);
+
+private:
+    std::vector<Resource> m_resources;
+    std::vector<Pass> m_passes;
+
+    std::vector<TransientImage> m_transient_images;
+    std::vector<TransientBlock> m_transient_blocks;
+    std::vector<uint32_t> m_transient_signature;
+    VkDeviceSize m_transient_memory_size_unaliased {};
+
+    RenderGraphStats m_stats {};
+
+    VkDevice m_device { nullptr };
+    VKHAllocator* m_allocator { nullptr };
+    std::function<void(std::function<void()>)> m_defer_destroy;
+};
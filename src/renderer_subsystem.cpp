@@ -1,5 +1,6 @@
 #include <fmt/format.h>
 
+#include <algorithm>
 #include <span>
 #include <string>
 #include <vector>
@@ -23,6 +24,133 @@ std::string flatten_vkb_detailed_error(std::vector<std::string> const& errors)
     return full_error;
 }
 
+VkPresentModeKHR to_vk_present_mode(PresentMode mode)
+{
+    switch (mode) {
+    case PresentMode::FifoRelaxed:
+        return VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+    case PresentMode::Mailbox:
+        return VK_PRESENT_MODE_MAILBOX_KHR;
+    case PresentMode::Immediate:
+        return VK_PRESENT_MODE_IMMEDIATE_KHR;
+    default:
+        return VK_PRESENT_MODE_FIFO_KHR;
+    }
+}
+
+std::span<PresentMode const> present_mode_fallbacks(PresentMode mode)
+{
+    static constexpr PresentMode fifo[] = { PresentMode::Fifo };
+    static constexpr PresentMode fifo_relaxed[] = { PresentMode::FifoRelaxed, PresentMode::Fifo };
+    static constexpr PresentMode mailbox[] = { PresentMode::Mailbox, PresentMode::Immediate, PresentMode::Fifo };
+    static constexpr PresentMode immediate[] = { PresentMode::Immediate, PresentMode::Mailbox, PresentMode::FifoRelaxed, PresentMode::Fifo };
+
+    switch (mode) {
+    case PresentMode::FifoRelaxed:
+        return fifo_relaxed;
+    case PresentMode::Mailbox:
+        return mailbox;
+    case PresentMode::Immediate:
+        return immediate;
+    default:
+        return fifo;
+    }
+}
+
+PresentMode negotiate_present_mode(PresentMode requested, std::vector<VkPresentModeKHR> const& supported)
+{
+    for (auto mode : present_mode_fallbacks(requested)) {
+        for (auto supported_mode : supported) {
+            if (supported_mode == to_vk_present_mode(mode))
+                return mode;
+        }
+    }
+
+    return PresentMode::Fifo;
+}
+
+}
+
+SecondaryRenderingInstance::SecondaryRenderingInstance(VkCommandBuffer cmd_buffer, VkExtent2D extent, VKHBindlessDescriptors const* bindless)
+    : m_cmd_buffer(cmd_buffer)
+    , m_extent(extent)
+    , m_bindless(bindless)
+{
+    set_viewport_scissor();
+    m_bindless->bind(m_cmd_buffer);
+}
+
+void SecondaryRenderingInstance::bind_graphics_pipeline(VkPipeline graphics_pipeline)
+{
+    vkCmdBindPipeline(m_cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphics_pipeline);
+}
+
+void SecondaryRenderingInstance::bind_graphics_pipeline(VKHPipeline const& pipeline)
+{
+    vkCmdBindPipeline(m_cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.pipeline);
+}
+
+void SecondaryRenderingInstance::push_constants(void const* data, uint32_t size, uint32_t offset)
+{
+    m_bindless->push_constants(m_cmd_buffer, data, size, offset);
+}
+
+void SecondaryRenderingInstance::draw(uint32_t vertex_count, uint32_t instance_count, uint32_t first_vertex, uint32_t first_instance)
+{
+    vkCmdDraw(m_cmd_buffer, vertex_count, instance_count, first_vertex, first_instance);
+}
+
+void SecondaryRenderingInstance::bind_vertex_buffer(VkBuffer buffer, VkDeviceSize offset)
+{
+    vkCmdBindVertexBuffers(m_cmd_buffer, 0, 1, &buffer, &offset);
+}
+
+void SecondaryRenderingInstance::bind_index_buffer(VkBuffer buffer, VkDeviceSize offset, VkIndexType index_type)
+{
+    vkCmdBindIndexBuffer(m_cmd_buffer, buffer, offset, index_type);
+}
+
+void SecondaryRenderingInstance::draw_indexed(uint32_t index_count, uint32_t instance_count, uint32_t first_index, int32_t vertex_offset, uint32_t first_instance)
+{
+    vkCmdDrawIndexed(m_cmd_buffer, index_count, instance_count, first_index, vertex_offset, first_instance);
+}
+
+void SecondaryRenderingInstance::draw_indirect(VkBuffer buffer, VkDeviceSize offset, uint32_t draw_count)
+{
+    vkCmdDrawIndirect(m_cmd_buffer, buffer, offset, draw_count, sizeof(VkDrawIndirectCommand));
+}
+
+void SecondaryRenderingInstance::draw_indexed_indirect(VkBuffer buffer, VkDeviceSize offset, uint32_t draw_count)
+{
+    vkCmdDrawIndexedIndirect(m_cmd_buffer, buffer, offset, draw_count, sizeof(VkDrawIndexedIndirectCommand));
+}
+
+void SecondaryRenderingInstance::draw_indexed_indirect_count(
+    VkBuffer buffer,
+    VkDeviceSize offset,
+    VkBuffer count_buffer,
+    VkDeviceSize count_offset,
+    uint32_t max_draw_count)
+{
+    vkCmdDrawIndexedIndirectCount(m_cmd_buffer, buffer, offset, count_buffer, count_offset, max_draw_count, sizeof(VkDrawIndexedIndirectCommand));
+}
+
+void SecondaryRenderingInstance::set_viewport_scissor()
+{
+    VkViewport viewport {};
+    viewport.x = 0.0f;
+    viewport.y = 0.0f;
+    viewport.width = static_cast<float>(m_extent.width);
+    viewport.height = static_cast<float>(m_extent.height);
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+
+    VkRect2D scissor {};
+    scissor.offset = { 0, 0 };
+    scissor.extent = m_extent;
+
+    vkCmdSetViewport(m_cmd_buffer, 0, 1, &viewport);
+    vkCmdSetScissor(m_cmd_buffer, 0, 1, &scissor);
 }
 
 RenderingInstance::RenderingInstance(RenderingInstanceInfo const& info)
@@ -31,31 +159,56 @@ RenderingInstance::RenderingInstance(RenderingInstanceInfo const& info)
 {
 }
 
-void RenderingInstance::begin(float r, float g, float b, float a)
+void RenderingInstance::begin(float r, float g, float b, float a, RenderingContents contents)
 {
+    m_contents = contents;
+
     begin_recording();
-    transtition_image(
-        VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, 0,
-        VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
-        VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
-    begin_rendering(r, g, b, a);
-    set_viewport_scissor();
+    m_info.profiler->begin_frame(m_info.cmd_buffer, m_info.frame_index);
+    acquire_uploads();
+    m_info.bindless->bind(m_info.cmd_buffer);
+    transtition_image("barrier_to_color_attachment", RGAccess::ColorAttachmentWrite);
+    push_gpu_scope("rendering");
+    begin_rendering(r, g, b, a, contents);
+
+    // only vkCmdExecuteCommands may be recorded inline when the contents come from secondaries.
+    if (contents == RenderingContents::Inline) {
+        m_info.profiler->begin_pipeline_statistics(m_info.cmd_buffer, m_info.frame_index);
+        set_viewport_scissor();
+    }
 }
 
 void RenderingInstance::end()
 {
+    if (m_contents == RenderingContents::Inline)
+        m_info.profiler->end_pipeline_statistics(m_info.cmd_buffer, m_info.frame_index);
     end_rendering();
-    transtition_image(
-        VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
-        VK_PIPELINE_STAGE_2_BOTTOM_OF_PIPE_BIT, 0,
-        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+    pop_gpu_scope();
+    if (m_info.headless) {
+        transtition_image("barrier_to_transfer_src", RGAccess::TransferRead);
+    } else {
+        transtition_image("barrier_to_present", RGAccess::Present);
+    }
+    m_info.profiler->end_frame(m_info.cmd_buffer, m_info.frame_index);
+    end_recording();
+}
+
+void RenderingInstance::execute_render_graph()
+{
+    begin_recording();
+    m_info.profiler->begin_frame(m_info.cmd_buffer, m_info.frame_index);
+    acquire_uploads();
+    m_info.bindless->bind(m_info.cmd_buffer);
+    m_info.render_graph->execute(m_info.cmd_buffer, m_info.profiler, m_info.frame_index);
+    m_info.profiler->end_frame(m_info.cmd_buffer, m_info.frame_index);
     end_recording();
 }
 
 void RenderingInstance::submit_and_present()
 {
     submit_cmd_buffer();
-    present_surface();
+    if (!m_info.headless)
+        present_surface();
 }
 
 void RenderingInstance::bind_graphics_pipeline(VkPipeline graphics_pipeline)
@@ -63,11 +216,156 @@ void RenderingInstance::bind_graphics_pipeline(VkPipeline graphics_pipeline)
     vkCmdBindPipeline(m_info.cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphics_pipeline);
 }
 
+void RenderingInstance::bind_graphics_pipeline(VKHPipeline const& pipeline)
+{
+    vkCmdBindPipeline(m_info.cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.pipeline);
+}
+
+void RenderingInstance::push_constants(void const* data, uint32_t size, uint32_t offset)
+{
+    m_info.bindless->push_constants(m_info.cmd_buffer, data, size, offset);
+}
+
 void RenderingInstance::draw(uint32_t vertex_count, uint32_t instance_count, uint32_t first_vertex, uint32_t first_instance)
 {
     vkCmdDraw(m_info.cmd_buffer, vertex_count, instance_count, first_vertex, first_instance);
 }
 
+void RenderingInstance::bind_vertex_buffer(VkBuffer buffer, VkDeviceSize offset)
+{
+    vkCmdBindVertexBuffers(m_info.cmd_buffer, 0, 1, &buffer, &offset);
+}
+
+void RenderingInstance::bind_index_buffer(VkBuffer buffer, VkDeviceSize offset, VkIndexType index_type)
+{
+    vkCmdBindIndexBuffer(m_info.cmd_buffer, buffer, offset, index_type);
+}
+
+void RenderingInstance::draw_indexed(uint32_t index_count, uint32_t instance_count, uint32_t first_index, int32_t vertex_offset, uint32_t first_instance)
+{
+    vkCmdDrawIndexed(m_info.cmd_buffer, index_count, instance_count, first_index, vertex_offset, first_instance);
+}
+
+void RenderingInstance::draw_indirect(VkBuffer buffer, VkDeviceSize offset, uint32_t draw_count)
+{
+    vkCmdDrawIndirect(m_info.cmd_buffer, buffer, offset, draw_count, sizeof(VkDrawIndirectCommand));
+}
+
+void RenderingInstance::draw_indexed_indirect(VkBuffer buffer, VkDeviceSize offset, uint32_t draw_count)
+{
+    vkCmdDrawIndexedIndirect(m_info.cmd_buffer, buffer, offset, draw_count, sizeof(VkDrawIndexedIndirectCommand));
+}
+
+void RenderingInstance::draw_indexed_indirect_count(
+    VkBuffer buffer,
+    VkDeviceSize offset,
+    VkBuffer count_buffer,
+    VkDeviceSize count_offset,
+    uint32_t max_draw_count)
+{
+    vkCmdDrawIndexedIndirectCount(m_info.cmd_buffer, buffer, offset, count_buffer, count_offset, max_draw_count, sizeof(VkDrawIndexedIndirectCommand));
+}
+
+bool RenderingInstance::draw_indirect(IndirectDrawBuilder const& builder)
+{
+    if (builder.get_draw_count() == 0)
+        return true;
+
+    auto commands = builder.write(*m_info.frame_ring, m_info.frame_index);
+    if (!commands)
+        return false;
+
+    draw_indirect(commands.buffer, commands.offset, builder.get_draw_count());
+    return true;
+}
+
+bool RenderingInstance::draw_indexed_indirect(IndirectDrawBuilder const& builder)
+{
+    if (builder.get_indexed_draw_count() == 0)
+        return true;
+
+    auto commands = builder.write_indexed(*m_info.frame_ring, m_info.frame_index);
+    if (!commands)
+        return false;
+
+    draw_indexed_indirect(commands.buffer, commands.offset, builder.get_indexed_draw_count());
+    return true;
+}
+
+void RenderingInstance::record_parallel(
+    uint32_t draw_count,
+    std::function<void(SecondaryRenderingInstance& instance, uint32_t first_draw, uint32_t draw_count)> const& fn)
+{
+    if (m_contents != RenderingContents::SecondaryCommandBuffers) {
+        fmt::println(stderr, "RenderingInstance::record_parallel(): rendering was not begun with secondary command buffer contents!");
+        return;
+    }
+
+    if (draw_count == 0)
+        return;
+
+    auto range_count = std::min<uint32_t>(draw_count, m_info.worker_cmd_buffers.size());
+
+    VkCommandBufferInheritanceRenderingInfo inheritance_rendering_info {};
+    inheritance_rendering_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO;
+    inheritance_rendering_info.colorAttachmentCount = 1;
+    inheritance_rendering_info.pColorAttachmentFormats = &m_info.color_format;
+    inheritance_rendering_info.depthAttachmentFormat = VK_FORMAT_UNDEFINED;
+    inheritance_rendering_info.stencilAttachmentFormat = VK_FORMAT_UNDEFINED;
+    inheritance_rendering_info.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    VkCommandBufferInheritanceInfo inheritance_info {};
+    inheritance_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritance_info.pNext = &inheritance_rendering_info;
+
+    std::vector<VkCommandBuffer> secondaries(range_count);
+
+    // range i is recorded into worker i's pool only, so no pool is ever touched by two threads at once.
+    m_info.jobs->parallel_for(range_count, [&](uint32_t i) {
+        auto& worker = m_info.worker_cmd_buffers[i];
+        if (worker.used == worker.cmd_buffers.size()) {
+            VkCommandBufferAllocateInfo allocate_info {};
+            allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocate_info.commandPool = worker.cmd_pool;
+            allocate_info.commandBufferCount = 1;
+            allocate_info.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+
+            VkCommandBuffer cmd_buffer;
+            VK_CHECK(vkAllocateCommandBuffers(m_info.device, &allocate_info, &cmd_buffer));
+            worker.cmd_buffers.push_back(cmd_buffer);
+        }
+
+        auto cmd_buffer = worker.cmd_buffers[worker.used++];
+
+        VkCommandBufferBeginInfo begin_info {};
+        begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        begin_info.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        begin_info.pInheritanceInfo = &inheritance_info;
+        VK_CHECK(vkBeginCommandBuffer(cmd_buffer, &begin_info));
+
+        auto first_draw = static_cast<uint32_t>(uint64_t(draw_count) * i / range_count);
+        auto last_draw = static_cast<uint32_t>(uint64_t(draw_count) * (i + 1) / range_count);
+
+        SecondaryRenderingInstance instance(cmd_buffer, m_info.swapchain_extent, m_info.bindless);
+        fn(instance, first_draw, last_draw - first_draw);
+
+        VK_CHECK(vkEndCommandBuffer(cmd_buffer));
+        secondaries[i] = cmd_buffer;
+    });
+
+    vkCmdExecuteCommands(m_info.cmd_buffer, secondaries.size(), secondaries.data());
+}
+
+void RenderingInstance::push_gpu_scope(std::string_view name)
+{
+    m_info.profiler->push_scope(m_info.cmd_buffer, m_info.frame_index, name);
+}
+
+void RenderingInstance::pop_gpu_scope()
+{
+    m_info.profiler->pop_scope(m_info.cmd_buffer, m_info.frame_index);
+}
+
 void RenderingInstance::begin_recording()
 {
     VkCommandBufferBeginInfo cmd_buffer_begin_info {};
@@ -80,7 +378,7 @@ void RenderingInstance::end_recording()
     VK_CHECK(vkEndCommandBuffer(m_info.cmd_buffer));
 }
 
-void RenderingInstance::begin_rendering(float r, float g, float b, float a)
+void RenderingInstance::begin_rendering(float r, float g, float b, float a, RenderingContents contents)
 {
     VkRenderingAttachmentInfo color_attachment {};
     color_attachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
@@ -98,6 +396,8 @@ void RenderingInstance::begin_rendering(float r, float g, float b, float a)
     rendering_info.viewMask = 0;
     rendering_info.colorAttachmentCount = 1;
     rendering_info.pColorAttachments = &color_attachment;
+    if (contents == RenderingContents::SecondaryCommandBuffers)
+        rendering_info.flags = VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT;
     vkCmdBeginRendering(m_info.cmd_buffer, &rendering_info);
 }
 
@@ -124,50 +424,49 @@ void RenderingInstance::set_viewport_scissor()
     vkCmdSetScissor(m_info.cmd_buffer, 0, 1, &scissor);
 }
 
-void RenderingInstance::transtition_image(
-    VkPipelineStageFlags2 src_stage,
-    VkAccessFlags2 src_access,
-    VkPipelineStageFlags2 dst_stage,
-    VkAccessFlags2 dst_access,
-    VkImageLayout old_layout,
-    VkImageLayout new_layout)
-{
-    VkImageMemoryBarrier2 image_barrier {};
-    image_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
-    image_barrier.srcStageMask = src_stage;
-    image_barrier.srcAccessMask = src_access;
-    image_barrier.dstStageMask = dst_stage;
-    image_barrier.dstAccessMask = dst_access;
-    image_barrier.oldLayout = old_layout;
-    image_barrier.newLayout = new_layout;
-    image_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    image_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    image_barrier.image = m_info.image;
-    image_barrier.subresourceRange = {
-        VK_IMAGE_ASPECT_COLOR_BIT,
-        0, 1, 0, 1
-    };
-
-    VkDependencyInfo dep_info {};
-    dep_info.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
-    dep_info.imageMemoryBarrierCount = 1;
-    dep_info.pImageMemoryBarriers = &image_barrier;
+void RenderingInstance::transtition_image(std::string_view scope_name, RGAccess access)
+{
+    push_gpu_scope(scope_name);
+    m_info.render_graph->transition(m_info.cmd_buffer, m_info.target, access);
+    pop_gpu_scope();
+}
 
-    vkCmdPipelineBarrier2(m_info.cmd_buffer, &dep_info);
+void RenderingInstance::acquire_uploads()
+{
+    push_gpu_scope("acquire_uploads");
+    m_upload_wait_value = m_info.upload_service->record_acquires(m_info.cmd_buffer);
+    pop_gpu_scope();
 }
 
 void RenderingInstance::submit_cmd_buffer()
 {
+    VkSemaphoreSubmitInfo wait_semaphore_infos[2] {};
+    uint32_t wait_semaphore_count {};
+
+    if (!m_info.headless) {
+        auto& wait_semaphore_info = wait_semaphore_infos[wait_semaphore_count++];
+        wait_semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+        wait_semaphore_info.semaphore = m_info.image_acquire_semaphore;
+        wait_semaphore_info.stageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
+    }
 
-    VkSemaphoreSubmitInfo wait_semaphore_info {};
-    wait_semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
-    wait_semaphore_info.semaphore = m_info.image_acquire_semaphore;
-    wait_semaphore_info.stageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
+    // the acquire barriers chain onto this wait, so it has to cover their source stage.
+    if (m_upload_wait_value > 0) {
+        auto& wait_semaphore_info = wait_semaphore_infos[wait_semaphore_count++];
+        wait_semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+        wait_semaphore_info.semaphore = m_info.upload_service->get_timeline_semaphore();
+        wait_semaphore_info.value = m_upload_wait_value;
+        wait_semaphore_info.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+    }
 
-    VkSemaphoreSubmitInfo render_semaphore_info {};
-    render_semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
-    render_semaphore_info.semaphore = m_info.render_completed_semaphore;
-    render_semaphore_info.stageMask = VK_PIPELINE_STAGE_2_ALL_GRAPHICS_BIT;
+    VkSemaphoreSubmitInfo signal_semaphore_infos[2] {};
+    signal_semaphore_infos[0].sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+    signal_semaphore_infos[0].semaphore = m_info.timeline_semaphore;
+    signal_semaphore_infos[0].value = m_info.frame_number;
+    signal_semaphore_infos[0].stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+    signal_semaphore_infos[1].sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+    signal_semaphore_infos[1].semaphore = m_info.present_semaphore;
+    signal_semaphore_infos[1].stageMask = VK_PIPELINE_STAGE_2_ALL_GRAPHICS_BIT;
 
     VkCommandBufferSubmitInfo command_buffer_info {};
     command_buffer_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO;
@@ -175,14 +474,14 @@ void RenderingInstance::submit_cmd_buffer()
 
     VkSubmitInfo2 submit_info {};
     submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
-    submit_info.waitSemaphoreInfoCount = 1;
-    submit_info.pWaitSemaphoreInfos = &wait_semaphore_info;
-    submit_info.signalSemaphoreInfoCount = 1;
-    submit_info.pSignalSemaphoreInfos = &render_semaphore_info;
+    submit_info.waitSemaphoreInfoCount = wait_semaphore_count;
+    submit_info.pWaitSemaphoreInfos = wait_semaphore_infos;
+    submit_info.signalSemaphoreInfoCount = m_info.headless ? 1 : 2;
+    submit_info.pSignalSemaphoreInfos = signal_semaphore_infos;
     submit_info.commandBufferInfoCount = 1;
     submit_info.pCommandBufferInfos = &command_buffer_info;
 
-    VK_CHECK(vkQueueSubmit2(m_info.queue, 1, &submit_info, m_info.fence));
+    VK_CHECK(vkQueueSubmit2(m_info.queue, 1, &submit_info, VK_NULL_HANDLE));
 }
 
 void RenderingInstance::present_surface()
@@ -190,11 +489,19 @@ void RenderingInstance::present_surface()
     VkPresentInfoKHR present_info {};
     present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
     present_info.waitSemaphoreCount = 1;
-    present_info.pWaitSemaphores = &m_info.render_completed_semaphore;
+    present_info.pWaitSemaphores = &m_info.present_semaphore;
     present_info.swapchainCount = 1;
     present_info.pSwapchains = &m_info.swapchain;
     present_info.pImageIndices = &m_info.swapchain_image_index;
 
+    VkPresentIdKHR present_id {};
+    if (m_info.use_present_id) {
+        present_id.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+        present_id.swapchainCount = 1;
+        present_id.pPresentIds = &m_info.frame_number;
+        present_info.pNext = &present_id;
+    }
+
     auto result = vkQueuePresentKHR(m_info.queue, &present_info);
     switch (result) {
     case VK_SUBOPTIMAL_KHR:
@@ -210,49 +517,163 @@ void FrameManager::init(FrameManagerInfo const& info)
 {
     m_device = info.device;
     m_queue_family = info.queue_family;
-
-    VkSurfaceCapabilitiesKHR surface_capabilities {};
-    VK_CHECK(vkGetPhysicalDeviceSurfaceCapabilitiesKHR(info.physical_device, info.surface, &surface_capabilities));
-    m_frames_in_flight = surface_capabilities.minImageCount;
+    m_frames_in_flight = info.frames_in_flight;
 
     init_synchros_and_command_buffers();
+
+    // transient since every secondary is rerecorded each time the slot comes around.
+    VkCommandPoolCreateInfo worker_pool_create_info {};
+    worker_pool_create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    worker_pool_create_info.queueFamilyIndex = m_queue_family;
+    worker_pool_create_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+    m_worker_cmd_buffers.resize(m_frames_in_flight);
+    for (auto& workers : m_worker_cmd_buffers) {
+        workers.resize(info.recording_thread_count);
+        for (auto& worker : workers)
+            VK_CHECK(vkCreateCommandPool(m_device, &worker_pool_create_info, nullptr, &worker.cmd_pool));
+    }
+
+    GPUProfilerInfo profiler_info {};
+    profiler_info.physical_device = info.physical_device;
+    profiler_info.device = info.device;
+    profiler_info.queue_family = info.queue_family;
+    profiler_info.frames_in_flight = m_frames_in_flight;
+    profiler_info.enable_timestamps = info.enable_gpu_timestamps;
+    profiler_info.enable_pipeline_statistics = info.enable_pipeline_statistics;
+    m_profiler.init(profiler_info);
+
+    FrameRingInfo frame_ring_info {};
+    frame_ring_info.physical_device = info.physical_device;
+    frame_ring_info.allocator = info.allocator;
+    frame_ring_info.frames_in_flight = m_frames_in_flight;
+    frame_ring_info.size = info.frame_ring_size;
+    frame_ring_info.bindless = info.bindless;
+    m_frame_ring.init(frame_ring_info);
 }
 
 void FrameManager::deinit()
 {
+    // releases the ring's bindless indices through the deletion queue, so it goes before the flush.
+    m_frame_ring.deinit();
+    m_deletion_queue.flush_all();
+    m_profiler.deinit();
+
     for (auto i { 0 }; i < m_frames_in_flight; i++) {
         vkFreeCommandBuffers(m_device, m_cmd_pools[i], 1, &m_cmd_buffers[i]);
         vkDestroyCommandPool(m_device, m_cmd_pools[i], nullptr);
 
-        vkDestroySemaphore(m_device, m_render_completed_semaphores[i], nullptr);
         vkDestroySemaphore(m_device, m_image_acquired_semaphores[i], nullptr);
-        vkDestroyFence(m_device, m_fences[i], nullptr);
+
+        for (auto& worker : m_worker_cmd_buffers[i]) {
+            if (!worker.cmd_buffers.empty())
+                vkFreeCommandBuffers(m_device, worker.cmd_pool, worker.cmd_buffers.size(), worker.cmd_buffers.data());
+            vkDestroyCommandPool(m_device, worker.cmd_pool, nullptr);
+        }
     }
+
+    for (auto semaphore : m_present_semaphores)
+        vkDestroySemaphore(m_device, semaphore, nullptr);
+
+    vkDestroySemaphore(m_device, m_timeline_semaphore, nullptr);
+
+    m_image_acquired_semaphores.clear();
+    m_present_semaphores.clear();
+    m_cmd_pools.clear();
+    m_cmd_buffers.clear();
+    m_worker_cmd_buffers.clear();
 }
 
 Frame FrameManager::get_frame()
 {
-    auto current_frame = m_current_frame++ % m_frames_in_flight;
-    auto fence = m_fences[current_frame];
-    auto image_acquired_semaphore = m_image_acquired_semaphores[current_frame];
-    auto render_completed_semaphore = m_render_completed_semaphores[current_frame];
-    auto cmd_pool = m_cmd_pools[current_frame];
-    auto cmd_buffer = m_cmd_buffers[current_frame];
+    auto number = m_frame_number + 1;
+    auto index = static_cast<uint32_t>(number % m_frames_in_flight);
+
+    if (number > m_frames_in_flight) {
+        auto wait_value = number - m_frames_in_flight;
+
+        VkSemaphoreWaitInfo wait_info {};
+        wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+        wait_info.semaphoreCount = 1;
+        wait_info.pSemaphores = &m_timeline_semaphore;
+        wait_info.pValues = &wait_value;
+        VK_CHECK(vkWaitSemaphores(m_device, &wait_info, UINT64_MAX));
+    }
+
+    m_deletion_queue.flush(get_completed_frame_number());
+    m_frame_ring.reset(index);
+
+    for (auto& worker : m_worker_cmd_buffers[index]) {
+        if (worker.used > 0)
+            VK_CHECK(vkResetCommandPool(m_device, worker.cmd_pool, 0));
+        worker.used = 0;
+    }
+
+    return {
+        number,
+        m_timeline_semaphore,
+        m_image_acquired_semaphores[index],
+        m_cmd_pools[index],
+        m_cmd_buffers[index],
+        m_worker_cmd_buffers[index],
+        index,
+    };
+}
+
+bool FrameManager::is_frame_complete(uint64_t frame_number) const
+{
+    return get_completed_frame_number() >= frame_number;
+}
 
-    return { fence, image_acquired_semaphore, render_completed_semaphore, cmd_pool, cmd_buffer };
+bool FrameManager::is_next_frame_ready() const
+{
+    auto number = m_frame_number + 1;
+    return number <= m_frames_in_flight || is_frame_complete(number - m_frames_in_flight);
+}
+
+uint64_t FrameManager::get_completed_frame_number() const
+{
+    uint64_t value {};
+    VK_CHECK(vkGetSemaphoreCounterValue(m_device, m_timeline_semaphore, &value));
+    return value;
+}
+
+void FrameManager::recreate_present_semaphores(uint32_t image_count)
+{
+    // a present of the old swapchain may still wait on them, even when the image count is unchanged.
+    if (!m_present_semaphores.empty()) {
+        defer_destroy([device = m_device, semaphores = std::move(m_present_semaphores)] {
+            for (auto semaphore : semaphores)
+                vkDestroySemaphore(device, semaphore, nullptr);
+        });
+    }
+
+    m_present_semaphores.clear();
+    m_present_semaphores.resize(image_count);
+
+    VkSemaphoreCreateInfo semaphore_create_info {};
+    semaphore_create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+    for (auto& semaphore : m_present_semaphores)
+        VK_CHECK(vkCreateSemaphore(m_device, &semaphore_create_info, nullptr, &semaphore));
 }
 
 void FrameManager::init_synchros_and_command_buffers()
 {
-    m_fences.resize(m_frames_in_flight);
     m_image_acquired_semaphores.resize(m_frames_in_flight);
-    m_render_completed_semaphores.resize(m_frames_in_flight);
     m_cmd_pools.resize(m_frames_in_flight);
     m_cmd_buffers.resize(m_frames_in_flight);
 
-    VkFenceCreateInfo fence_create_info {};
-    fence_create_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-    fence_create_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+    VkSemaphoreTypeCreateInfo timeline_type_create_info {};
+    timeline_type_create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    timeline_type_create_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    timeline_type_create_info.initialValue = 0;
+
+    VkSemaphoreCreateInfo timeline_create_info {};
+    timeline_create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    timeline_create_info.pNext = &timeline_type_create_info;
+
+    VK_CHECK(vkCreateSemaphore(m_device, &timeline_create_info, nullptr, &m_timeline_semaphore));
 
     VkSemaphoreCreateInfo semaphore_create_info {};
     semaphore_create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
@@ -263,9 +684,7 @@ void FrameManager::init_synchros_and_command_buffers()
     cmd_pool_create_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 
     for (auto i { 0 }; i < m_frames_in_flight; i++) {
-        VK_CHECK(vkCreateFence(m_device, &fence_create_info, nullptr, &m_fences[i]));
         VK_CHECK(vkCreateSemaphore(m_device, &semaphore_create_info, nullptr, &m_image_acquired_semaphores[i]));
-        VK_CHECK(vkCreateSemaphore(m_device, &semaphore_create_info, nullptr, &m_render_completed_semaphores[i]));
 
         VK_CHECK(vkCreateCommandPool(m_device, &cmd_pool_create_info, nullptr, &m_cmd_pools[i]));
 
@@ -279,17 +698,29 @@ void FrameManager::init_synchros_and_command_buffers()
     }
 }
 
-Subsystem::InitResult<void> RendererSubsystem::init(WindowSubsystem* window)
+Subsystem::InitResult<void> RendererSubsystem::init(RendererSubsystemInfo const& info)
 {
     if (m_initialized)
         return MAKE_SUBSYSTEM_INIT_SUCCESS();
 
-    m_window = window;
+    if (!info.headless && !info.window)
+        return MAKE_SUBSYSTEM_INIT_ERROR("a window is required unless the renderer is headless");
+
+    if (!info.jobs)
+        return MAKE_SUBSYSTEM_INIT_ERROR("a job subsystem is required");
+
+    if (info.frames_in_flight == 0)
+        return MAKE_SUBSYSTEM_INIT_ERROR("at least one frame in flight is required");
+
+    m_window = info.headless ? nullptr : info.window;
+    m_jobs = info.jobs;
+    m_headless = info.headless;
+    m_present_policy = info.present_policy;
 
     volkInitialize();
 
     vkb::Instance vkb_instance;
-    if (auto result = init_instance(window); !result) {
+    if (auto result = init_instance(); !result) {
         return MAKE_SUBSYSTEM_INIT_ERROR("{}", std::move(result.message));
     } else {
         vkb_instance = std::move(result.value);
@@ -297,13 +728,39 @@ Subsystem::InitResult<void> RendererSubsystem::init(WindowSubsystem* window)
 
     volkLoadInstance(vkb_instance.instance);
 
+    VkSurfaceKHR surface { nullptr };
+    if (!m_headless)
+        surface = m_window->create_window_surface(vkb_instance.instance);
+
     vkb::PhysicalDevice vkb_physical_device;
-    if (auto result = init_physical_device(window->create_window_surface(vkb_instance.instance), vkb_instance); !result) {
+    if (auto result = init_physical_device(surface, vkb_instance); !result) {
         return MAKE_SUBSYSTEM_INIT_ERROR("{}", std::move(result.message));
     } else {
         vkb_physical_device = std::move(result.value);
     }
 
+    bool pipeline_statistics { false };
+    if (info.gpu_pipeline_statistics) {
+        VkPhysicalDeviceFeatures features {};
+        features.pipelineStatisticsQuery = VK_TRUE;
+        pipeline_statistics = vkb_physical_device.enable_features_if_present(features);
+    }
+
+    if (!m_headless
+        && vkb_physical_device.enable_extension_if_present(VK_KHR_PRESENT_ID_EXTENSION_NAME)
+        && vkb_physical_device.enable_extension_if_present(VK_KHR_PRESENT_WAIT_EXTENSION_NAME)) {
+        VkPhysicalDevicePresentIdFeaturesKHR present_id_features {};
+        present_id_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+        present_id_features.presentId = VK_TRUE;
+
+        VkPhysicalDevicePresentWaitFeaturesKHR present_wait_features {};
+        present_wait_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+        present_wait_features.presentWait = VK_TRUE;
+
+        m_present_wait_supported = vkb_physical_device.enable_extension_features_if_present(present_id_features)
+            && vkb_physical_device.enable_extension_features_if_present(present_wait_features);
+    }
+
     vkb::Device vkb_device;
     if (auto result = init_device(vkb_physical_device); !result) {
         return MAKE_SUBSYSTEM_INIT_ERROR("{}", std::move(result.message));
@@ -335,15 +792,83 @@ Subsystem::InitResult<void> RendererSubsystem::init(WindowSubsystem* window)
     m_queue = queue;
     m_queue_family = queue_family;
 
-    init_swapchain();
+    // prefers a transfer-only family, then any family without graphics, so uploads run beside rendering.
+    m_transfer_queue = queue;
+    m_transfer_queue_family = queue_family;
+    if (auto result = vkb_device.get_dedicated_queue(vkb::QueueType::transfer); result) {
+        m_transfer_queue = result.value();
+        m_transfer_queue_family = vkb_device.get_dedicated_queue_index(vkb::QueueType::transfer).value();
+    } else if (auto result = vkb_device.get_queue(vkb::QueueType::transfer); result) {
+        m_transfer_queue = result.value();
+        m_transfer_queue_family = vkb_device.get_queue_index(vkb::QueueType::transfer).value();
+    }
+
+    VKHAllocatorInfo allocator_info {};
+    allocator_info.physical_device = m_physical_device;
+    allocator_info.device = m_device;
+    m_allocator.init(allocator_info);
+
+    VKHPipelineCacheInfo pipeline_cache_info {};
+    pipeline_cache_info.physical_device = m_physical_device;
+    pipeline_cache_info.device = m_device;
+    pipeline_cache_info.path = info.pipeline_cache_path;
+    m_pipeline_cache.init(pipeline_cache_info);
+
+    m_pipeline_registry.init(m_device, &m_pipeline_cache, m_jobs);
+
+    VKHBindlessInfo bindless_info {};
+    bindless_info.physical_device = m_physical_device;
+    bindless_info.device = m_device;
+    bindless_info.registry = &m_pipeline_registry;
+    bindless_info.defer_destroy = [this](std::function<void()> deleter) { defer_destroy(std::move(deleter)); };
+    m_bindless.init(bindless_info);
 
     FrameManagerInfo frame_manager_info {};
-    frame_manager_info.surface = m_surface;
     frame_manager_info.physical_device = m_physical_device;
     frame_manager_info.device = m_device;
+    frame_manager_info.allocator = &m_allocator;
+    frame_manager_info.bindless = &m_bindless;
     frame_manager_info.queue_family = m_queue_family;
+    frame_manager_info.frames_in_flight = info.frames_in_flight;
+    frame_manager_info.recording_thread_count = m_jobs->get_worker_count() + 1;
+    frame_manager_info.frame_ring_size = info.frame_ring_size;
+    frame_manager_info.enable_gpu_timestamps = info.gpu_timestamps;
+    frame_manager_info.enable_pipeline_statistics = pipeline_statistics;
     m_frame_manager.init(frame_manager_info);
 
+    RenderGraphInfo render_graph_info {};
+    render_graph_info.device = m_device;
+    render_graph_info.allocator = &m_allocator;
+    render_graph_info.defer_destroy = [this](std::function<void()> deleter) { defer_destroy(std::move(deleter)); };
+    m_render_graph.init(render_graph_info);
+
+    UploadServiceInfo upload_service_info {};
+    upload_service_info.device = m_device;
+    upload_service_info.allocator = &m_allocator;
+    upload_service_info.transfer_queue = m_transfer_queue;
+    upload_service_info.transfer_queue_family = m_transfer_queue_family;
+    upload_service_info.graphics_queue_family = m_queue_family;
+    upload_service_info.staging_size = info.upload_staging_size;
+    m_upload_service.init(upload_service_info);
+
+    GPUCullerInfo gpu_culler_info {};
+    gpu_culler_info.device = m_device;
+    gpu_culler_info.allocator = &m_allocator;
+    gpu_culler_info.registry = &m_pipeline_registry;
+    gpu_culler_info.bindless = &m_bindless;
+    gpu_culler_info.defer_destroy = [this](std::function<void()> deleter) { defer_destroy(std::move(deleter)); };
+    gpu_culler_info.frames_in_flight = info.frames_in_flight;
+    gpu_culler_info.shader_dir = info.shader_dir;
+    if (!m_gpu_culler.init(gpu_culler_info))
+        return MAKE_SUBSYSTEM_INIT_ERROR("failed to load the culling shaders from '{}'", info.shader_dir);
+
+    if (m_headless) {
+        m_offscreen_extent = info.headless_extent;
+        init_offscreen_images(info.frames_in_flight);
+    } else {
+        init_swapchain();
+    }
+
     m_initialized = true;
     return MAKE_SUBSYSTEM_INIT_SUCCESS();
 }
@@ -355,24 +880,99 @@ void RendererSubsystem::deinit()
 
     vkDeviceWaitIdle(m_device);
 
+    // queues bindless releases and pyramid views, so it goes before the frame manager flushes them.
+    m_gpu_culler.deinit();
     m_frame_manager.deinit();
+    m_render_graph.deinit();
+    m_upload_service.deinit();
+
+    deinit_offscreen_images();
 
     for (auto image_view : m_swapchain_image_views)
         vkDestroyImageView(m_device, image_view, nullptr);
 
-    vkDestroySwapchainKHR(m_device, m_swapchain, nullptr);
+    if (m_swapchain)
+        vkDestroySwapchainKHR(m_device, m_swapchain, nullptr);
+
+    m_bindless.deinit();
+    m_pipeline_registry.deinit();
+    m_pipeline_cache.deinit();
+    m_allocator.deinit();
 
     vkDestroyDevice(m_device, nullptr);
-    vkDestroySurfaceKHR(m_instance, m_surface, nullptr);
+    if (m_surface)
+        vkDestroySurfaceKHR(m_instance, m_surface, nullptr);
     vkDestroyDebugUtilsMessengerEXT(m_instance, m_debug_messenger, nullptr);
     vkDestroyInstance(m_instance, nullptr);
 
     m_initialized = false;
 }
 
+void RendererSubsystem::defer_destroy_buffer(VkBuffer buffer)
+{
+    defer_destroy([device = m_device, buffer] { vkDestroyBuffer(device, buffer, nullptr); });
+}
+
+void RendererSubsystem::defer_destroy_buffer(VKHBuffer buffer)
+{
+    defer_destroy([this, buffer]() mutable { m_allocator.destroy_buffer(buffer); });
+}
+
+void RendererSubsystem::defer_destroy_image(VkImage image)
+{
+    defer_destroy([device = m_device, image] { vkDestroyImage(device, image, nullptr); });
+}
+
+void RendererSubsystem::defer_destroy_image(VKHImage image)
+{
+    defer_destroy([this, image]() mutable { m_allocator.destroy_image(image); });
+}
+
+void RendererSubsystem::defer_destroy_image_view(VkImageView image_view)
+{
+    defer_destroy([device = m_device, image_view] { vkDestroyImageView(device, image_view, nullptr); });
+}
+
+void RendererSubsystem::defer_destroy_pipeline(VkPipeline pipeline)
+{
+    defer_destroy([device = m_device, pipeline] { vkDestroyPipeline(device, pipeline, nullptr); });
+}
+
 void RendererSubsystem::request_recreate_swapchain()
 {
-    m_request_recreate_swapchain = true;
+    if (!m_headless)
+        m_request_recreate_swapchain = true;
+}
+
+void RendererSubsystem::set_present_policy(PresentPolicy const& policy)
+{
+    m_present_policy = policy;
+    request_recreate_swapchain();
+}
+
+void RendererSubsystem::wait_for_present_latency()
+{
+    if (m_headless || !m_present_policy.limit_latency || !m_present_wait_supported)
+        return;
+
+    if (m_last_present_id == 0 || m_request_recreate_swapchain)
+        return;
+
+    // bounded so a present that never reached the display (e.g. out of date) cannot hang the loop.
+    constexpr uint64_t timeout_ns = 100'000'000;
+
+    auto result = vkWaitForPresentKHR(m_device, m_swapchain, m_last_present_id, timeout_ns);
+    switch (result) {
+    case VK_SUCCESS:
+    case VK_TIMEOUT:
+        break;
+    case VK_SUBOPTIMAL_KHR:
+    case VK_ERROR_OUT_OF_DATE_KHR:
+        request_recreate_swapchain();
+        break;
+    default:
+        VK_CHECK(result);
+    }
 }
 
 RenderingInstance RendererSubsystem::try_get_frame()
@@ -382,8 +982,48 @@ RenderingInstance RendererSubsystem::try_get_frame()
 
     auto frame = m_frame_manager.get_frame();
 
-    VK_CHECK(vkWaitForFences(m_device, 1, &frame.fence, VK_TRUE, UINT64_MAX));
-    VK_CHECK(vkResetFences(m_device, 1, &frame.fence));
+    m_frame_manager.get_profiler()->collect(frame.index);
+
+    // submitted before this frame records its acquires, so everything uploaded so far is visible to it.
+    m_upload_service.flush();
+
+    if (m_headless) {
+        RenderingInstanceInfo rendering_instance_info {};
+        rendering_instance_info.device = m_device;
+        rendering_instance_info.image = m_offscreen_images[frame.index].image;
+        rendering_instance_info.image_view = m_offscreen_image_views[frame.index];
+        rendering_instance_info.color_format = get_surface_format().format;
+        rendering_instance_info.cmd_buffer = frame.cmd_buffer;
+        rendering_instance_info.worker_cmd_buffers = frame.worker_cmd_buffers;
+        rendering_instance_info.jobs = m_jobs;
+        rendering_instance_info.timeline_semaphore = frame.timeline_semaphore;
+        rendering_instance_info.frame_number = frame.number;
+        rendering_instance_info.queue = m_queue;
+        rendering_instance_info.queue_family = m_queue_family;
+        rendering_instance_info.swapchain_image_index = frame.index;
+        rendering_instance_info.swapchain_extent = m_offscreen_extent;
+        rendering_instance_info.headless = true;
+        rendering_instance_info.profiler = m_frame_manager.get_profiler();
+        rendering_instance_info.upload_service = &m_upload_service;
+        rendering_instance_info.frame_ring = m_frame_manager.get_frame_ring();
+        rendering_instance_info.bindless = &m_bindless;
+        rendering_instance_info.frame_index = frame.index;
+
+        RGImportedImageInfo target_info {};
+        target_info.image = rendering_instance_info.image;
+        target_info.image_view = rendering_instance_info.image_view;
+        target_info.format = rendering_instance_info.color_format;
+        target_info.extent = m_offscreen_extent;
+        target_info.initial_stage = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
+        target_info.final_access = RGAccess::TransferRead;
+
+        m_render_graph.reset();
+        rendering_instance_info.render_graph = &m_render_graph;
+        rendering_instance_info.target = m_render_graph.import_image("offscreen", target_info);
+
+        m_frame_manager.advance();
+        return RenderingInstance(rendering_instance_info);
+    }
 
     uint32_t swapchain_image_index {};
 
@@ -405,34 +1045,65 @@ RenderingInstance RendererSubsystem::try_get_frame()
     auto image_view = m_swapchain_image_views[swapchain_image_index];
 
     RenderingInstanceInfo rendering_instance_info {};
+    rendering_instance_info.device = m_device;
     rendering_instance_info.image = image;
     rendering_instance_info.image_view = image_view;
+    rendering_instance_info.color_format = get_surface_format().format;
     rendering_instance_info.cmd_buffer = frame.cmd_buffer;
-    rendering_instance_info.fence = frame.fence;
+    rendering_instance_info.worker_cmd_buffers = frame.worker_cmd_buffers;
+    rendering_instance_info.jobs = m_jobs;
+    rendering_instance_info.timeline_semaphore = frame.timeline_semaphore;
+    rendering_instance_info.frame_number = frame.number;
     rendering_instance_info.image_acquire_semaphore = frame.image_acquired_semaphore;
-    rendering_instance_info.render_completed_semaphore = frame.render_completed_semaphore;
+    rendering_instance_info.present_semaphore = m_frame_manager.get_present_semaphore(swapchain_image_index);
     rendering_instance_info.surface = m_surface;
     rendering_instance_info.queue = m_queue;
     rendering_instance_info.queue_family = m_queue_family;
     rendering_instance_info.swapchain = m_swapchain;
     rendering_instance_info.swapchain_image_index = swapchain_image_index;
     rendering_instance_info.swapchain_extent = m_swapchain_extent;
-
+    rendering_instance_info.use_present_id = m_present_wait_supported;
+    rendering_instance_info.profiler = m_frame_manager.get_profiler();
+    rendering_instance_info.upload_service = &m_upload_service;
+    rendering_instance_info.frame_ring = m_frame_manager.get_frame_ring();
+    rendering_instance_info.bindless = &m_bindless;
+    rendering_instance_info.frame_index = frame.index;
+
+    // the acquire semaphore is waited at color attachment output, so the first barrier has to chain onto that stage.
+    RGImportedImageInfo target_info {};
+    target_info.image = image;
+    target_info.image_view = image_view;
+    target_info.format = rendering_instance_info.color_format;
+    target_info.extent = m_swapchain_extent;
+    target_info.initial_stage = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
+    target_info.final_access = RGAccess::Present;
+
+    m_render_graph.reset();
+    rendering_instance_info.render_graph = &m_render_graph;
+    rendering_instance_info.target = m_render_graph.import_image("swapchain", target_info);
+
+    m_last_present_id = m_present_wait_supported ? frame.number : 0;
+
+    m_frame_manager.advance();
     return RenderingInstance(rendering_instance_info);
 }
 
-Subsystem::InitResult<vkb::Instance> RendererSubsystem::init_instance(WindowSubsystem* window)
+Subsystem::InitResult<vkb::Instance> RendererSubsystem::init_instance()
 {
-    uint32_t required_ext_count {};
-    char const** required_exts = glfwGetRequiredInstanceExtensions(&required_ext_count);
+    vkb::InstanceBuilder builder;
+    builder.require_api_version(1, 3)
+        .request_validation_layers()
+        .use_default_debug_messenger();
 
-    if (auto result = vkb::InstanceBuilder()
-            .require_api_version(1, 3)
-            .enable_extensions(std::span(required_exts, required_ext_count))
-            .request_validation_layers()
-            .use_default_debug_messenger()
-            .build();
-        !result) {
+    if (m_headless) {
+        builder.set_headless();
+    } else {
+        uint32_t required_ext_count {};
+        char const** required_exts = glfwGetRequiredInstanceExtensions(&required_ext_count);
+        builder.enable_extensions(std::span(required_exts, required_ext_count));
+    }
+
+    if (auto result = builder.build(); !result) {
         return MAKE_SUBSYSTEM_INIT_ERROR_TYPED("{}", flatten_vkb_detailed_error(result.detailed_failure_reasons()));
     } else {
         return MAKE_SUBSYSTEM_INIT_SUCCESS_TYPED(std::move(result.value()));
@@ -441,14 +1112,34 @@ Subsystem::InitResult<vkb::Instance> RendererSubsystem::init_instance(WindowSubs
 
 Subsystem::InitResult<vkb::PhysicalDevice> RendererSubsystem::init_physical_device(VkSurfaceKHR surface, vkb::Instance& instance)
 {
+    VkPhysicalDeviceVulkan12Features vk12_features {};
+    vk12_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    vk12_features.timelineSemaphore = VK_TRUE;
+    vk12_features.drawIndirectCount = VK_TRUE;
+    vk12_features.descriptorIndexing = VK_TRUE;
+    vk12_features.runtimeDescriptorArray = VK_TRUE;
+    vk12_features.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+    vk12_features.shaderStorageBufferArrayNonUniformIndexing = VK_TRUE;
+    vk12_features.descriptorBindingPartiallyBound = VK_TRUE;
+    vk12_features.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+    vk12_features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    vk12_features.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+    vk12_features.descriptorBindingStorageImageUpdateAfterBind = VK_TRUE;
+
+    // many draws per indirect call, with firstInstance carrying the draw id.
+    VkPhysicalDeviceFeatures features {};
+    features.multiDrawIndirect = VK_TRUE;
+    features.drawIndirectFirstInstance = VK_TRUE;
+
     VkPhysicalDeviceVulkan13Features vk13_features {};
     vk13_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
     vk13_features.dynamicRendering = VK_TRUE;
     vk13_features.synchronization2 = VK_TRUE;
 
-    if (auto result = vkb::PhysicalDeviceSelector(instance)
+    if (auto result = vkb::PhysicalDeviceSelector(instance, surface)
+            .set_required_features(features)
+            .set_required_features_12(vk12_features)
             .set_required_features_13(vk13_features)
-            .set_surface(surface)
             .select();
         !result) {
         return MAKE_SUBSYSTEM_INIT_ERROR_TYPED("{}", flatten_vkb_detailed_error(result.detailed_failure_reasons()));
@@ -468,9 +1159,6 @@ Subsystem::InitResult<vkb::Device> RendererSubsystem::init_device(vkb::PhysicalD
 
 void RendererSubsystem::init_swapchain()
 {
-    if (m_request_recreate_swapchain)
-        VK_CHECK(vkDeviceWaitIdle(m_device));
-
     auto [width, height] = m_window->get_framebuffer_size();
     while (width == 0 || height == 0) {
         auto new_framebuffer_size = m_window->get_framebuffer_size();
@@ -484,12 +1172,23 @@ void RendererSubsystem::init_swapchain()
     VkSurfaceCapabilitiesKHR surface_capabilities {};
     VK_CHECK(vkGetPhysicalDeviceSurfaceCapabilitiesKHR(m_physical_device, m_surface, &surface_capabilities));
 
+    uint32_t present_mode_count {};
+    VK_CHECK(vkGetPhysicalDeviceSurfacePresentModesKHR(m_physical_device, m_surface, &present_mode_count, nullptr));
+    std::vector<VkPresentModeKHR> present_modes(present_mode_count);
+    VK_CHECK(vkGetPhysicalDeviceSurfacePresentModesKHR(m_physical_device, m_surface, &present_mode_count, present_modes.data()));
+
+    m_present_mode = negotiate_present_mode(m_present_policy.mode, present_modes);
+
+    auto image_count = std::max(m_present_policy.image_count, surface_capabilities.minImageCount);
+    if (surface_capabilities.maxImageCount != 0)
+        image_count = std::min(image_count, surface_capabilities.maxImageCount);
+
     auto old_swapchain = m_swapchain;
 
     VkSwapchainCreateInfoKHR create_info {};
     create_info.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
     create_info.surface = m_surface;
-    create_info.minImageCount = surface_capabilities.minImageCount;
+    create_info.minImageCount = image_count;
     create_info.imageFormat = format;
     create_info.imageColorSpace = color_space;
     create_info.imageExtent = { static_cast<uint32_t>(width), static_cast<uint32_t>(height) };
@@ -497,18 +1196,21 @@ void RendererSubsystem::init_swapchain()
     create_info.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
     create_info.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
     create_info.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
-    create_info.presentMode = VK_PRESENT_MODE_FIFO_KHR;
+    create_info.presentMode = to_vk_present_mode(m_present_mode);
     create_info.clipped = VK_TRUE;
     create_info.preTransform = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR;
     create_info.oldSwapchain = old_swapchain;
 
     VK_CHECK(vkCreateSwapchainKHR(m_device, &create_info, nullptr, &m_swapchain));
 
-    for (auto image_view : m_swapchain_image_views)
-        vkDestroyImageView(m_device, image_view, nullptr);
+    if (old_swapchain != VK_NULL_HANDLE) {
+        defer_destroy([device = m_device, old_swapchain, image_views = std::move(m_swapchain_image_views)] {
+            for (auto image_view : image_views)
+                vkDestroyImageView(device, image_view, nullptr);
 
-    if (old_swapchain != VK_NULL_HANDLE)
-        vkDestroySwapchainKHR(m_device, old_swapchain, nullptr);
+            vkDestroySwapchainKHR(device, old_swapchain, nullptr);
+        });
+    }
 
     m_swapchain_images.clear();
     m_swapchain_image_views.clear();
@@ -533,5 +1235,56 @@ void RendererSubsystem::init_swapchain()
 
     m_swapchain_extent = create_info.imageExtent;
 
+    m_frame_manager.recreate_present_semaphores(swapchain_image_count);
+
+    // present ids restart with the new swapchain, the old one is never waited on again.
+    m_last_present_id = 0;
+
     m_request_recreate_swapchain = false;
 }
+
+void RendererSubsystem::init_offscreen_images(uint32_t image_count)
+{
+    auto [format, color_space] = get_surface_format();
+
+    m_offscreen_images.resize(image_count);
+    m_offscreen_image_views.resize(image_count);
+
+    for (auto i { 0 }; i < image_count; i++) {
+        VkImageCreateInfo image_create_info {};
+        image_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        image_create_info.imageType = VK_IMAGE_TYPE_2D;
+        image_create_info.format = format;
+        image_create_info.extent = { m_offscreen_extent.width, m_offscreen_extent.height, 1 };
+        image_create_info.mipLevels = 1;
+        image_create_info.arrayLayers = 1;
+        image_create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+        image_create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+        image_create_info.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        image_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        image_create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+        m_offscreen_images[i] = m_allocator.create_image(image_create_info, VKHMemoryUsage::GPUOnly);
+
+        VkImageViewCreateInfo image_view_create_info {};
+        image_view_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        image_view_create_info.image = m_offscreen_images[i].image;
+        image_view_create_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        image_view_create_info.format = format;
+        image_view_create_info.components = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B, VK_COMPONENT_SWIZZLE_A };
+        image_view_create_info.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+        VK_CHECK(vkCreateImageView(m_device, &image_view_create_info, nullptr, &m_offscreen_image_views[i]));
+    }
+}
+
+void RendererSubsystem::deinit_offscreen_images()
+{
+    for (auto i { 0 }; i < m_offscreen_images.size(); i++) {
+        vkDestroyImageView(m_device, m_offscreen_image_views[i], nullptr);
+        m_allocator.destroy_image(m_offscreen_images[i]);
+    }
+
+    m_offscreen_images.clear();
+    m_offscreen_image_views.clear();
+}
@@ -1,24 +1,112 @@
 #pragma once
 
+#include <functional>
+#include <span>
+#include <string>
+#include <string_view>
 #include <vector>
 
+#include "deletion_queue.h"
+#include "frame_ring.h"
+#include "gpu_culling.h"
+#include "gpu_profiler.h"
+#include "indirect_draw.h"
 #include "helper.h"
+#include "job_subsystem.h"
+#include "render_graph.h"
 #include "subsystem.h"
+#include "upload_service.h"
+#include "vulkan_bindless.h"
+#include "vulkan_allocator.h"
+#include "vulkan_helper.h"
 #include "window_subsystem.h"
 
+#if !defined(VULKRAFT_SHADER_DIR)
+#    define VULKRAFT_SHADER_DIR "shaders"
+#endif
+
+struct WorkerCommandBuffers {
+    VkCommandPool cmd_pool;
+    std::vector<VkCommandBuffer> cmd_buffers;
+    uint32_t used;
+};
+
 struct RenderingInstanceInfo {
+    VkDevice device;
     VkImage image;
     VkImageView image_view;
+    VkFormat color_format;
     VkCommandBuffer cmd_buffer;
-    VkFence fence;
+    std::span<WorkerCommandBuffers> worker_cmd_buffers;
+    JobSubsystem* jobs;
+    VkSemaphore timeline_semaphore;
+    uint64_t frame_number;
     VkSemaphore image_acquire_semaphore;
-    VkSemaphore render_completed_semaphore;
+    VkSemaphore present_semaphore;
     VkSurfaceKHR surface;
     VkQueue queue;
     uint32_t queue_family;
     VkSwapchainKHR swapchain;
     uint32_t swapchain_image_index;
     VkExtent2D swapchain_extent;
+    bool use_present_id;
+    bool headless;
+    GPUProfiler* profiler;
+    RenderGraph* render_graph;
+    RGImage target;
+    UploadService* upload_service;
+    FrameRing* frame_ring;
+    VKHBindlessDescriptors* bindless;
+    uint32_t frame_index;
+};
+
+enum class RenderingContents {
+    Inline,
+    // the pass is recorded by record_parallel() only, nothing may be recorded inline between begin() and end().
+    SecondaryCommandBuffers,
+};
+
+class SecondaryRenderingInstance {
+public:
+    SecondaryRenderingInstance(VkCommandBuffer cmd_buffer, VkExtent2D extent, VKHBindlessDescriptors const* bindless);
+
+    void bind_graphics_pipeline(VkPipeline graphics_pipeline);
+
+    void bind_graphics_pipeline(VKHPipeline const& pipeline);
+
+    // into the bindless push constant range, the set itself is already bound.
+    void push_constants(void const* data, uint32_t size, uint32_t offset = 0);
+
+    // binding 0.
+    void bind_vertex_buffer(VkBuffer buffer, VkDeviceSize offset);
+
+    void draw(uint32_t vertex_count, uint32_t instance_count, uint32_t first_vertex, uint32_t first_instance);
+
+    void bind_index_buffer(VkBuffer buffer, VkDeviceSize offset, VkIndexType index_type);
+
+    void draw_indexed(uint32_t index_count, uint32_t instance_count, uint32_t first_index, int32_t vertex_offset, uint32_t first_instance);
+
+    void draw_indirect(VkBuffer buffer, VkDeviceSize offset, uint32_t draw_count);
+
+    void draw_indexed_indirect(VkBuffer buffer, VkDeviceSize offset, uint32_t draw_count);
+
+    // the draw count is read from count_buffer on the GPU and clamped to max_draw_count.
+    void draw_indexed_indirect_count(
+        VkBuffer buffer,
+        VkDeviceSize offset,
+        VkBuffer count_buffer,
+        VkDeviceSize count_offset,
+        uint32_t max_draw_count);
+
+    VkCommandBuffer get_cmd_buffer() const { return m_cmd_buffer; }
+
+private:
+    void set_viewport_scissor();
+
+private:
+    VkCommandBuffer m_cmd_buffer { nullptr };
+    VkExtent2D m_extent {};
+    VKHBindlessDescriptors const* m_bindless { nullptr };
 };
 
 class RenderingInstance {
@@ -27,16 +115,75 @@ public:
 
     RenderingInstance(RenderingInstanceInfo const& info);
 
-    void begin(float r, float g, float b, float a);
+    void begin(float r, float g, float b, float a, RenderingContents contents = RenderingContents::Inline);
 
     void end();
 
+    // records every pass added to the render graph instead of using begin() and end().
+    void execute_render_graph();
+
     void submit_and_present();
 
+    RenderGraph* get_render_graph() const { return m_info.render_graph; }
+
+    // the swapchain or offscreen image this frame presents, imported into the render graph.
+    RGImage get_target() const { return m_info.target; }
+
     void bind_graphics_pipeline(VkPipeline graphics_pipeline);
 
+    void bind_graphics_pipeline(VKHPipeline const& pipeline);
+
+    // into the bindless push constant range, the set itself is bound once per command buffer.
+    void push_constants(void const* data, uint32_t size, uint32_t offset = 0);
+
+    // binding 0.
+    void bind_vertex_buffer(VkBuffer buffer, VkDeviceSize offset);
+
     void draw(uint32_t vertex_count, uint32_t instance_count, uint32_t first_vertex, uint32_t first_instance);
 
+    void bind_index_buffer(VkBuffer buffer, VkDeviceSize offset, VkIndexType index_type);
+
+    void draw_indexed(uint32_t index_count, uint32_t instance_count, uint32_t first_index, int32_t vertex_offset, uint32_t first_instance);
+
+    void draw_indirect(VkBuffer buffer, VkDeviceSize offset, uint32_t draw_count);
+
+    void draw_indexed_indirect(VkBuffer buffer, VkDeviceSize offset, uint32_t draw_count);
+
+    // the draw count is read from count_buffer on the GPU and clamped to max_draw_count.
+    void draw_indexed_indirect_count(
+        VkBuffer buffer,
+        VkDeviceSize offset,
+        VkBuffer count_buffer,
+        VkDeviceSize count_offset,
+        uint32_t max_draw_count);
+
+    // pack the builder's non-indexed or indexed draws into this frame's ring and issue them with a single
+    // call, return false when the ring overflowed and nothing was drawn.
+    bool draw_indirect(IndirectDrawBuilder const& builder);
+
+    bool draw_indexed_indirect(IndirectDrawBuilder const& builder);
+
+    void push_gpu_scope(std::string_view name);
+
+    void pop_gpu_scope();
+
+    // splits [0, draw_count) into contiguous ranges recorded concurrently into secondary command buffers,
+    // one command pool per worker, then executes them in order. requires RenderingContents::SecondaryCommandBuffers.
+    void record_parallel(
+        uint32_t draw_count,
+        std::function<void(SecondaryRenderingInstance& instance, uint32_t first_draw, uint32_t draw_count)> const& fn);
+
+    uint64_t get_frame_number() const { return m_info.frame_number; }
+
+    // per-frame uniform, storage or indirect data, valid until this frame completes on the GPU.
+    FrameRingAllocation allocate_frame_data(VkDeviceSize size, VkDeviceSize alignment = 0)
+    {
+        return m_info.frame_ring->allocate(m_info.frame_index, size, alignment);
+    }
+
+    template <typename T>
+    FrameRingAllocation push_frame_data(T const& value) { return m_info.frame_ring->push(m_info.frame_index, value); }
+
     operator bool() const { return m_success; }
 
 private:
@@ -44,19 +191,15 @@ private:
 
     void end_recording();
 
-    void begin_rendering(float r, float g, float b, float a);
+    void begin_rendering(float r, float g, float b, float a, RenderingContents contents);
 
     void end_rendering();
 
     void set_viewport_scissor();
 
-    void transtition_image(
-        VkPipelineStageFlags2 src_stage,
-        VkAccessFlags2 src_access,
-        VkPipelineStageFlags2 dst_stage,
-        VkAccessFlags2 dst_access,
-        VkImageLayout old_layout,
-        VkImageLayout new_layout);
+    void transtition_image(std::string_view scope_name, RGAccess access);
+
+    void acquire_uploads();
 
     void submit_cmd_buffer();
 
@@ -64,23 +207,33 @@ private:
 
 private:
     RenderingInstanceInfo m_info {};
+    RenderingContents m_contents { RenderingContents::Inline };
+    uint64_t m_upload_wait_value {};
 
     bool m_success { false };
 };
 
 struct Frame {
-    VkFence fence;
+    uint64_t number;
+    VkSemaphore timeline_semaphore;
     VkSemaphore image_acquired_semaphore;
-    VkSemaphore render_completed_semaphore;
     VkCommandPool cmd_pool;
     VkCommandBuffer cmd_buffer;
+    std::span<WorkerCommandBuffers> worker_cmd_buffers;
+    uint32_t index;
 };
 
 struct FrameManagerInfo {
-    VkSurfaceKHR surface;
     VkPhysicalDevice physical_device;
     VkDevice device;
+    VKHAllocator* allocator;
+    VKHBindlessDescriptors* bindless;
     uint32_t queue_family;
+    uint32_t frames_in_flight;
+    uint32_t recording_thread_count;
+    VkDeviceSize frame_ring_size;
+    bool enable_gpu_timestamps;
+    bool enable_pipeline_statistics;
 };
 
 class FrameManager {
@@ -94,24 +247,109 @@ public:
 
     void deinit();
 
+    // waits until the frame slot is free again, the returned frame is only
+    // consumed once advance() is called after its work has been submitted.
     Frame get_frame();
 
+    void advance() { m_frame_number++; }
+
+    bool is_frame_complete(uint64_t frame_number) const;
+
+    bool is_next_frame_ready() const;
+
+    uint64_t get_frame_number() const { return m_frame_number; }
+
+    uint64_t get_completed_frame_number() const;
+
+    uint32_t get_frames_in_flight() const { return m_frames_in_flight; }
+
+    // one per swapchain image, called on every swapchain (re)creation. the old ones go through the deletion queue.
+    void recreate_present_semaphores(uint32_t image_count);
+
+    // destroys the object once every frame submitted so far has completed on the GPU.
+    void defer_destroy(std::function<void()> deleter) { m_deletion_queue.push(m_frame_number, std::move(deleter)); }
+
+    VkSemaphore get_present_semaphore(uint32_t image_index) const { return m_present_semaphores[image_index]; }
+
+    GPUProfiler* get_profiler() { return &m_profiler; }
+
+    GPUProfiler const* get_profiler() const { return &m_profiler; }
+
+    FrameRing* get_frame_ring() { return &m_frame_ring; }
+
+    FrameRing const* get_frame_ring() const { return &m_frame_ring; }
+
 private:
     void init_synchros_and_command_buffers();
 
 private:
-    std::vector<VkFence> m_fences;
+    VkSemaphore m_timeline_semaphore { nullptr };
     std::vector<VkSemaphore> m_image_acquired_semaphores;
-    std::vector<VkSemaphore> m_render_completed_semaphores;
+    std::vector<VkSemaphore> m_present_semaphores;
     std::vector<VkCommandPool> m_cmd_pools;
     std::vector<VkCommandBuffer> m_cmd_buffers;
-    uint32_t m_current_frame { 0 };
+    std::vector<std::vector<WorkerCommandBuffers>> m_worker_cmd_buffers;
+    uint64_t m_frame_number { 0 };
     uint32_t m_frames_in_flight {};
 
+    GPUProfiler m_profiler;
+    FrameRing m_frame_ring;
+    DeletionQueue m_deletion_queue;
+
     VkDevice m_device { nullptr };
     uint32_t m_queue_family {};
 };
 
+enum class PresentMode {
+    Fifo,
+    FifoRelaxed,
+    Mailbox,
+    Immediate,
+};
+
+struct PresentPolicy {
+    // falls back towards Fifo when the surface does not support the requested mode.
+    PresentMode mode { PresentMode::Fifo };
+
+    // 0 picks the surface's minimum image count, otherwise clamped to what the surface allows.
+    uint32_t image_count { 0 };
+
+    // waits for the previous present to reach the display before the next frame samples
+    // input, only honored when VK_KHR_present_id and VK_KHR_present_wait are available.
+    bool limit_latency { false };
+};
+
+struct RendererSubsystemInfo {
+    WindowSubsystem* window { nullptr };
+
+    // runs pipeline compiles and parallel recording, recording uses every worker plus the calling thread.
+    JobSubsystem* jobs { nullptr };
+
+    // renders into offscreen images owned by the renderer, no window or swapchain is created.
+    bool headless { false };
+    VkExtent2D headless_extent { 800, 600 };
+
+    // independent of the swapchain image count, headless mode owns one offscreen image per frame.
+    uint32_t frames_in_flight { 2 };
+
+    PresentPolicy present_policy {};
+
+    // empty disables loading and saving the pipeline cache.
+    std::string pipeline_cache_path { "pipeline_cache.bin" };
+
+    // compiled SPIR-V, defaults to the build tree's shader output.
+    std::string shader_dir { VULKRAFT_SHADER_DIR };
+
+    // uploads that do not fit until earlier ones complete are refused rather than waited on.
+    VkDeviceSize upload_staging_size { UPLOAD_SERVICE_DEFAULT_STAGING_SIZE };
+
+    // initial size of each frame's transient data buffer, grown after a frame overflows it.
+    VkDeviceSize frame_ring_size { FRAME_RING_DEFAULT_SIZE };
+
+    bool gpu_timestamps { true };
+    bool gpu_pipeline_statistics { false };
+};
+
 class RendererSubsystem {
     MAKE_NON_COPYABLE(RendererSubsystem);
     MAKE_NON_MOVABLE(RendererSubsystem);
@@ -123,7 +361,7 @@ public:
         return &instance;
     }
 
-    Subsystem::InitResult<void> init(WindowSubsystem* window);
+    Subsystem::InitResult<void> init(RendererSubsystemInfo const& info);
 
     void deinit();
 
@@ -131,12 +369,66 @@ public:
 
     RenderingInstance try_get_frame();
 
+    void set_present_policy(PresentPolicy const& policy);
+
+    PresentPolicy get_present_policy() const { return m_present_policy; }
+
+    PresentMode get_present_mode() const { return m_present_mode; }
+
+    bool is_latency_limiting_supported() const { return m_present_wait_supported; }
+
+    // call before sampling input, blocks until the last presented frame is on screen when latency limiting is enabled.
+    void wait_for_present_latency();
+
+    bool is_headless() const { return m_headless; }
+
+    uint64_t get_frame_number() const { return m_frame_manager.get_frame_number(); }
+
+    bool is_frame_complete(uint64_t frame_number) const { return m_frame_manager.is_frame_complete(frame_number); }
+
+    // true when try_get_frame() would not have to wait on the GPU.
+    bool is_next_frame_ready() const { return m_frame_manager.is_next_frame_ready(); }
+
+    std::vector<GPUScopeTiming> get_gpu_timings() const { return m_frame_manager.get_profiler()->get_timings(); }
+
+    GPUPipelineStatistics get_gpu_pipeline_statistics() const { return m_frame_manager.get_profiler()->get_pipeline_statistics(); }
+
+    FrameRingStats get_frame_ring_stats() const { return m_frame_manager.get_frame_ring()->get_stats(); }
+
+    void defer_destroy(std::function<void()> deleter) { m_frame_manager.defer_destroy(std::move(deleter)); }
+
+    void defer_destroy_buffer(VkBuffer buffer);
+
+    void defer_destroy_buffer(VKHBuffer buffer);
+
+    void defer_destroy_image(VkImage image);
+
+    void defer_destroy_image(VKHImage image);
+
+    void defer_destroy_image_view(VkImageView image_view);
+
+    void defer_destroy_pipeline(VkPipeline pipeline);
+
+    VkDevice get_device() const { return m_device; }
+
+    VKHAllocator* get_allocator() { return &m_allocator; }
+
+    UploadService* get_upload_service() { return &m_upload_service; }
+
+    VKHBindlessDescriptors* get_bindless() { return &m_bindless; }
+
+    GPUCuller* get_gpu_culler() { return &m_gpu_culler; }
+
+    VKHPipelineCache* get_pipeline_cache() { return &m_pipeline_cache; }
+
+    VKHPipelineRegistry* get_pipeline_registry() { return &m_pipeline_registry; }
+
     VkSurfaceFormatKHR get_surface_format() const { return { VK_FORMAT_B8G8R8A8_SRGB, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR }; }
 
 private:
     RendererSubsystem() = default;
 
-    Subsystem::InitResult<vkb::Instance> init_instance(WindowSubsystem* window);
+    Subsystem::InitResult<vkb::Instance> init_instance();
 
     Subsystem::InitResult<vkb::PhysicalDevice> init_physical_device(VkSurfaceKHR surface, vkb::Instance& instance);
 
@@ -144,9 +436,21 @@ private:
 
     void init_swapchain();
 
+    void init_offscreen_images(uint32_t image_count);
+
+    void deinit_offscreen_images();
+
 private:
     WindowSubsystem* m_window { nullptr };
+    JobSubsystem* m_jobs { nullptr };
+    VKHAllocator m_allocator {};
     FrameManager m_frame_manager {};
+    RenderGraph m_render_graph {};
+    UploadService m_upload_service {};
+    VKHPipelineCache m_pipeline_cache {};
+    VKHPipelineRegistry m_pipeline_registry {};
+    VKHBindlessDescriptors m_bindless {};
+    GPUCuller m_gpu_culler {};
 
     VkInstance m_instance { nullptr };
     VkDebugUtilsMessengerEXT m_debug_messenger { nullptr };
@@ -155,12 +459,24 @@ private:
     VkDevice m_device { nullptr };
     VkQueue m_queue { nullptr };
     uint32_t m_queue_family {};
+    VkQueue m_transfer_queue { nullptr };
+    uint32_t m_transfer_queue_family {};
 
     VkSwapchainKHR m_swapchain { nullptr };
     std::vector<VkImage> m_swapchain_images;
     std::vector<VkImageView> m_swapchain_image_views;
     VkExtent2D m_swapchain_extent {};
 
+    PresentPolicy m_present_policy {};
+    PresentMode m_present_mode { PresentMode::Fifo };
+    uint64_t m_last_present_id { 0 };
+    bool m_present_wait_supported { false };
+
+    std::vector<VKHImage> m_offscreen_images;
+    std::vector<VkImageView> m_offscreen_image_views;
+    VkExtent2D m_offscreen_extent {};
+
+    bool m_headless { false };
     bool m_request_recreate_swapchain { false };
     bool m_initialized { false };
 };
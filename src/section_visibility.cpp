@@ -0,0 +1,249 @@
+#include <algorithm>
+
+#include "section_visibility.h"
+
+// faces in the order of the mesher, the opposite of a face is face ^ 1.
+#define SECTION_FACE_COUNT 6
+#define SECTION_ALL_FACES 0x3fu
+
+// marks sections is_visible rejected in SectionVisibilityGraph::m_entered, they are never walked through.
+#define SECTION_REJECTED 0x80u
+
+namespace {
+
+constexpr int32_t g_face_directions[SECTION_FACE_COUNT][3] = {
+    { 1, 0, 0 },
+    { -1, 0, 0 },
+    { 0, 1, 0 },
+    { 0, -1, 0 },
+    { 0, 0, 1 },
+    { 0, 0, -1 },
+};
+
+uint32_t get_pair_bit(uint32_t face_a, uint32_t face_b)
+{
+    auto a = std::min(face_a, face_b);
+    auto b = std::max(face_a, face_b);
+    return a * SECTION_FACE_COUNT - a * (a + 1) / 2 + (b - a - 1);
+}
+
+uint16_t connect_faces(uint32_t faces)
+{
+    uint16_t visibility {};
+    for (auto a { 0u }; a < SECTION_FACE_COUNT; a++) {
+        for (auto b { a + 1 }; b < SECTION_FACE_COUNT; b++) {
+            if ((faces >> a & 1) && (faces >> b & 1))
+                visibility |= 1u << get_pair_bit(a, b);
+        }
+    }
+    return visibility;
+}
+
+uint32_t get_exit_faces(uint16_t visibility, uint32_t entered)
+{
+    uint32_t exits {};
+    for (auto entry { 0u }; entry < SECTION_FACE_COUNT; entry++) {
+        if (!(entered >> entry & 1))
+            continue;
+        for (auto face { 0u }; face < SECTION_FACE_COUNT; face++) {
+            if (face != entry && (visibility >> get_pair_bit(entry, face) & 1))
+                exits |= 1u << face;
+        }
+    }
+    return exits;
+}
+
+struct FloodRow {
+    uint8_t y;
+    uint8_t z;
+    uint16_t bits;
+};
+
+}
+
+uint16_t compute_section_visibility(ChunkSection const& section)
+{
+    if (section.is_uniform())
+        return is_block_opaque(section.get_uniform_block()) ? 0 : SECTION_VISIBILITY_ALL;
+
+    // open[y][z] holds the non-opaque blocks of a row in its bits, x is the bit index.
+    uint16_t open[CHUNK_SECTION_SIZE][CHUNK_SECTION_SIZE] {};
+    uint16_t visited[CHUNK_SECTION_SIZE][CHUNK_SECTION_SIZE] {};
+    for (auto y { 0u }; y < CHUNK_SECTION_SIZE; y++) {
+        for (auto z { 0u }; z < CHUNK_SECTION_SIZE; z++) {
+            for (auto x { 0u }; x < CHUNK_SECTION_SIZE; x++) {
+                if (!is_block_opaque(section.get(x, y, z)))
+                    open[y][z] |= 1u << x;
+            }
+        }
+    }
+
+    uint16_t visibility {};
+    std::vector<FloodRow> stack;
+    for (auto y { 0u }; y < CHUNK_SECTION_SIZE && visibility != SECTION_VISIBILITY_ALL; y++) {
+        for (auto z { 0u }; z < CHUNK_SECTION_SIZE; z++) {
+            while (auto remaining = static_cast<uint16_t>(open[y][z] & ~visited[y][z])) {
+                // one connected region, seeded with its lowest block in the row.
+                uint32_t faces {};
+                stack.push_back({ static_cast<uint8_t>(y), static_cast<uint8_t>(z), static_cast<uint16_t>(remaining & -remaining) });
+
+                while (!stack.empty()) {
+                    auto row = stack.back();
+                    stack.pop_back();
+
+                    auto available = static_cast<uint16_t>(open[row.y][row.z] & ~visited[row.y][row.z]);
+                    uint32_t bits = row.bits & available;
+                    if (bits == 0)
+                        continue;
+
+                    // spreads along the row until it hits opaque or visited blocks.
+                    for (auto previous { 0u }; bits != previous;) {
+                        previous = bits;
+                        bits |= ((bits << 1) | (bits >> 1)) & available;
+                    }
+                    visited[row.y][row.z] |= bits;
+
+                    if (bits & (1u << (CHUNK_SECTION_SIZE - 1)))
+                        faces |= 1u << 0;
+                    if (bits & 1u)
+                        faces |= 1u << 1;
+                    if (row.y == CHUNK_SECTION_SIZE - 1)
+                        faces |= 1u << 2;
+                    if (row.y == 0)
+                        faces |= 1u << 3;
+                    if (row.z == CHUNK_SECTION_SIZE - 1)
+                        faces |= 1u << 4;
+                    if (row.z == 0)
+                        faces |= 1u << 5;
+
+                    auto push = [&](uint32_t next_y, uint32_t next_z) {
+                        if (bits & open[next_y][next_z] & ~visited[next_y][next_z])
+                            stack.push_back({ static_cast<uint8_t>(next_y), static_cast<uint8_t>(next_z), static_cast<uint16_t>(bits) });
+                    };
+                    if (row.y > 0)
+                        push(row.y - 1, row.z);
+                    if (row.y < CHUNK_SECTION_SIZE - 1)
+                        push(row.y + 1, row.z);
+                    if (row.z > 0)
+                        push(row.y, row.z - 1);
+                    if (row.z < CHUNK_SECTION_SIZE - 1)
+                        push(row.y, row.z + 1);
+                }
+
+                visibility |= connect_faces(faces);
+            }
+        }
+    }
+    return visibility;
+}
+
+bool are_faces_connected(uint16_t visibility, uint32_t face_a, uint32_t face_b)
+{
+    return face_a != face_b && (visibility >> get_pair_bit(face_a, face_b) & 1);
+}
+
+void SectionVisibilityGraph::set(ChunkPosition position, uint32_t section_index, uint16_t visibility)
+{
+    auto [it, inserted] = m_columns.try_emplace(position);
+    if (inserted)
+        it->second.fill(SECTION_VISIBILITY_UNKNOWN | SECTION_VISIBILITY_ALL);
+    it->second[section_index] = visibility;
+}
+
+void SectionVisibilityGraph::update(Chunk const& chunk, uint32_t section_index)
+{
+    set(chunk.get_position(), section_index, compute_section_visibility(chunk.get_section(section_index)));
+}
+
+void SectionVisibilityGraph::remove(ChunkPosition position)
+{
+    m_columns.erase(position);
+}
+
+void SectionVisibilityGraph::cull(
+    int32_t camera_x,
+    int32_t camera_y,
+    int32_t camera_z,
+    uint32_t view_distance,
+    std::function<bool(SectionPosition)> const& is_visible,
+    std::vector<SectionPosition>& visible)
+{
+    m_stats = {};
+    m_stats.column_count = m_columns.size();
+
+    // a camera above or below the world starts in the outermost section of its column.
+    auto reach = static_cast<int32_t>(view_distance);
+    auto width = reach * 2 + 1;
+    auto origin_x = (camera_x >> 4) - reach;
+    auto origin_z = (camera_z >> 4) - reach;
+    auto camera_section_y = std::clamp(camera_y >> 4, 0, CHUNK_SECTION_COUNT - 1);
+
+    // copied once, so the walk does not hash every section it visits.
+    auto size = static_cast<size_t>(width) * width * CHUNK_SECTION_COUNT;
+    m_window.assign(size, SECTION_VISIBILITY_UNKNOWN | SECTION_VISIBILITY_ALL);
+    m_entered.assign(size, 0);
+    for (auto z { 0 }; z < width; z++) {
+        for (auto x { 0 }; x < width; x++) {
+            auto it = m_columns.find({ origin_x + x, origin_z + z });
+            if (it != m_columns.end())
+                std::copy(it->second.begin(), it->second.end(), m_window.begin() + (z * width + x) * CHUNK_SECTION_COUNT);
+        }
+    }
+
+    auto get_index = [&](int32_t x, int32_t y, int32_t z) { return static_cast<uint32_t>((z * width + x) * CHUNK_SECTION_COUNT + y); };
+
+    auto visit = [&](int32_t x, int32_t y, int32_t z) {
+        m_stats.visited_count++;
+        if (m_window[get_index(x, y, z)] & SECTION_VISIBILITY_UNKNOWN)
+            return;
+        visible.push_back({ origin_x + x, y, origin_z + z });
+        m_stats.visible_count++;
+    };
+
+    // every step leads away from the camera, so all faces of a section are entered from the previous
+    // layer of the walk and a section is queued once, after the first of them.
+    m_queue.clear();
+    auto start = get_index(reach, camera_section_y, reach);
+    m_entered[start] = SECTION_ALL_FACES;
+    m_queue.push_back(start);
+    visit(reach, camera_section_y, reach);
+
+    for (auto head { 0u }; head < m_queue.size(); head++) {
+        auto index = m_queue[head];
+        auto y = static_cast<int32_t>(index % CHUNK_SECTION_COUNT);
+        auto x = static_cast<int32_t>(index / CHUNK_SECTION_COUNT % width);
+        auto z = static_cast<int32_t>(index / CHUNK_SECTION_COUNT / width);
+        int32_t position[3] = { x - reach, y - camera_section_y, z - reach };
+
+        // the camera's own section is left through every face.
+        auto exits = index == start ? SECTION_ALL_FACES : get_exit_faces(m_window[index], m_entered[index]);
+
+        for (auto face { 0u }; face < SECTION_FACE_COUNT; face++) {
+            auto const& direction = g_face_directions[face];
+            auto axis = face / 2;
+            if (!(exits >> face & 1) || position[axis] * direction[axis] < 0)
+                continue;
+
+            auto next_x = x + direction[0];
+            auto next_y = y + direction[1];
+            auto next_z = z + direction[2];
+            if (next_x < 0 || next_x >= width || next_z < 0 || next_z >= width || next_y < 0 || next_y >= CHUNK_SECTION_COUNT)
+                continue;
+
+            auto next = get_index(next_x, next_y, next_z);
+            auto& entered = m_entered[next];
+            if (entered & SECTION_REJECTED)
+                continue;
+
+            if (entered == 0) {
+                if (is_visible && !is_visible({ origin_x + next_x, next_y, origin_z + next_z })) {
+                    entered = SECTION_REJECTED;
+                    continue;
+                }
+                visit(next_x, next_y, next_z);
+                m_queue.push_back(next);
+            }
+            entered |= 1u << (face ^ 1);
+        }
+    }
+}
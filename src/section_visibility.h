@@ -0,0 +1,80 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+#include "chunk.h"
+#include "helper.h"
+
+// one bit per pair of the six section faces (+x, -x, +y, -y, +z, -z), set when the two faces are
+// connected through non-opaque blocks inside the section.
+#define SECTION_VISIBILITY_ALL 0x7fffu
+
+// a section that never had its set computed, it is passed through but never reported as visible.
+#define SECTION_VISIBILITY_UNKNOWN 0x8000u
+
+// flood fills the non-opaque blocks, 4096 blocks at most, a row of 16 at a time.
+uint16_t compute_section_visibility(ChunkSection const& section);
+
+bool are_faces_connected(uint16_t visibility, uint32_t face_a, uint32_t face_b);
+
+struct SectionPosition {
+    int32_t x;
+    int32_t y;
+    int32_t z;
+};
+
+struct SectionVisibilityStats {
+    uint32_t column_count;
+    uint32_t visited_count;
+    uint32_t visible_count;
+};
+
+// the visibility sets of the loaded sections, walked outward from the camera every frame like the
+// "advanced cave culling" of minecraft. a section is only reached through faces its neighbors connect,
+// so sections behind solid terrain are skipped before they are drawn. changing a section only replaces
+// its own set. main thread only.
+class SectionVisibilityGraph {
+    MAKE_NON_COPYABLE(SectionVisibilityGraph);
+    MAKE_NON_MOVABLE(SectionVisibilityGraph);
+
+public:
+    SectionVisibilityGraph() = default;
+
+    // the set as computed when the section was meshed, see ChunkSectionMesh::visibility.
+    void set(ChunkPosition position, uint32_t section_index, uint16_t visibility);
+
+    // recomputes the section after blocks of it changed.
+    void update(Chunk const& chunk, uint32_t section_index);
+
+    void remove(ChunkPosition position);
+
+    void clear() { m_columns.clear(); }
+
+    // appends the sections reachable from the camera's within view_distance chunks, nearest first. a
+    // section is entered through a face only if the face it left its neighbor through connects to the
+    // one that neighbor was entered through, and never towards the camera. sections is_visible rejects
+    // are neither reported nor walked through, it may be empty.
+    void cull(
+        int32_t camera_x,
+        int32_t camera_y,
+        int32_t camera_z,
+        uint32_t view_distance,
+        std::function<bool(SectionPosition)> const& is_visible,
+        std::vector<SectionPosition>& visible);
+
+    SectionVisibilityStats get_stats() const { return m_stats; }
+
+private:
+    std::unordered_map<ChunkPosition, std::array<uint16_t, CHUNK_SECTION_COUNT>, ChunkPositionHash> m_columns;
+
+    // per cull(), indexed (z * width + x) * CHUNK_SECTION_COUNT + y within the view distance.
+    std::vector<uint16_t> m_window;
+    std::vector<uint8_t> m_entered;
+    std::vector<uint32_t> m_queue;
+
+    SectionVisibilityStats m_stats {};
+};
@@ -0,0 +1,202 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+#include "terrain_generator.h"
+
+// height offset of the terrain around sea level, in blocks.
+#define TERRAIN_HEIGHT_AMPLITUDE 56.0f
+#define TERRAIN_WARP_STRENGTH 48.0f
+
+// cave density is sampled every TERRAIN_CAVE_CELL blocks and interpolated in between.
+#define TERRAIN_CAVE_CELL 4
+#define TERRAIN_CAVE_GRID (CHUNK_SECTION_SIZE / TERRAIN_CAVE_CELL + 1)
+#define TERRAIN_CAVE_LAYERS (CHUNK_HEIGHT / TERRAIN_CAVE_CELL + 1)
+#define TERRAIN_CAVE_THRESHOLD 0.28f
+
+#define TERRAIN_DIRT_DEPTH 4
+
+void TerrainGenerator::init(TerrainGeneratorInfo const& info)
+{
+    m_jobs = info.jobs;
+    m_kernels = info.kernels ? info.kernels : &get_noise_kernels();
+
+    m_warp_x = { info.seed * 0x9e3779b9u + 1, 3, 1.0f / 512.0f };
+    m_warp_z = { info.seed * 0x9e3779b9u + 2, 3, 1.0f / 512.0f };
+    m_height = { info.seed * 0x9e3779b9u + 3, 5, 1.0f / 384.0f };
+    m_caves = { info.seed * 0x9e3779b9u + 4, 2, 1.0f / 48.0f };
+}
+
+namespace {
+
+Block get_layer_block(int32_t y, int32_t height)
+{
+    if (y >= height)
+        return y < TERRAIN_SEA_LEVEL ? Block::Water : Block::Air;
+
+    if (y == 0)
+        return Block::Bedrock;
+    if (y < height - TERRAIN_DIRT_DEPTH)
+        return Block::Stone;
+    if (height <= TERRAIN_SEA_LEVEL + 1)
+        return Block::Sand;
+    if (y < height - 1)
+        return Block::Dirt;
+    return Block::Grass;
+}
+
+}
+
+int32_t TerrainGenerator::compute_heights(float origin_x, float origin_z, float step, std::span<int32_t, TERRAIN_COLUMN_COUNT> heights) const
+{
+    std::array<float, TERRAIN_COLUMN_COUNT> x;
+    std::array<float, TERRAIN_COLUMN_COUNT> z;
+    for (auto i { 0u }; i < TERRAIN_COLUMN_COUNT; i++) {
+        x[i] = origin_x + (i & 15) * step;
+        z[i] = origin_z + (i >> 4) * step;
+    }
+
+    std::array<float, TERRAIN_COLUMN_COUNT> warp_x;
+    std::array<float, TERRAIN_COLUMN_COUNT> warp_z;
+    m_kernels->fbm2(m_warp_x, x.data(), z.data(), warp_x.data(), TERRAIN_COLUMN_COUNT);
+    m_kernels->fbm2(m_warp_z, x.data(), z.data(), warp_z.data(), TERRAIN_COLUMN_COUNT);
+    for (auto i { 0u }; i < TERRAIN_COLUMN_COUNT; i++) {
+        warp_x[i] = x[i] + warp_x[i] * TERRAIN_WARP_STRENGTH;
+        warp_z[i] = z[i] + warp_z[i] * TERRAIN_WARP_STRENGTH;
+    }
+
+    std::array<float, TERRAIN_COLUMN_COUNT> noise;
+    m_kernels->fbm2(m_height, warp_x.data(), warp_z.data(), noise.data(), TERRAIN_COLUMN_COUNT);
+
+    auto max_height { 0 };
+    for (auto i { 0u }; i < TERRAIN_COLUMN_COUNT; i++) {
+        auto height = static_cast<int32_t>(std::floor(TERRAIN_SEA_LEVEL + noise[i] * TERRAIN_HEIGHT_AMPLITUDE));
+        heights[i] = std::clamp(height, 1, CHUNK_HEIGHT - 1);
+        max_height = std::max(max_height, heights[i]);
+    }
+    return max_height;
+}
+
+void TerrainGenerator::generate(Chunk& chunk) const
+{
+    auto position = chunk.get_position();
+    auto origin_x = static_cast<float>(position.x * CHUNK_SECTION_SIZE);
+    auto origin_z = static_cast<float>(position.z * CHUNK_SECTION_SIZE);
+
+    // the number of solid blocks in every column, indexed z * 16 + x like a layer of a section.
+    std::array<int32_t, TERRAIN_COLUMN_COUNT> heights;
+    auto max_height = compute_heights(origin_x, origin_z, 1.0f, heights);
+
+    // cave density on a coarse grid up to the highest surface, caves never reach above it.
+    auto cave_layers = std::min(max_height / TERRAIN_CAVE_CELL + 2, TERRAIN_CAVE_LAYERS);
+    auto cave_count = cave_layers * TERRAIN_CAVE_GRID * TERRAIN_CAVE_GRID;
+
+    std::array<float, TERRAIN_CAVE_LAYERS * TERRAIN_CAVE_GRID * TERRAIN_CAVE_GRID> cave_x;
+    std::array<float, TERRAIN_CAVE_LAYERS * TERRAIN_CAVE_GRID * TERRAIN_CAVE_GRID> cave_y;
+    std::array<float, TERRAIN_CAVE_LAYERS * TERRAIN_CAVE_GRID * TERRAIN_CAVE_GRID> cave_z;
+    std::array<float, TERRAIN_CAVE_LAYERS * TERRAIN_CAVE_GRID * TERRAIN_CAVE_GRID> cave_density;
+    for (auto i { 0 }; i < cave_count; i++) {
+        cave_x[i] = origin_x + (i % TERRAIN_CAVE_GRID) * TERRAIN_CAVE_CELL;
+        cave_z[i] = origin_z + (i / TERRAIN_CAVE_GRID % TERRAIN_CAVE_GRID) * TERRAIN_CAVE_CELL;
+        cave_y[i] = static_cast<float>(i / (TERRAIN_CAVE_GRID * TERRAIN_CAVE_GRID) * TERRAIN_CAVE_CELL);
+    }
+    m_kernels->fbm3(m_caves, cave_x.data(), cave_y.data(), cave_z.data(), cave_density.data(), cave_count);
+
+    std::array<Block, CHUNK_SECTION_VOLUME> blocks;
+    for (auto section_index { 0 }; section_index < CHUNK_SECTION_COUNT; section_index++) {
+        auto& section = chunk.get_section(section_index);
+        auto base_y = section_index * CHUNK_SECTION_SIZE;
+        if (base_y >= max_height && base_y >= TERRAIN_SEA_LEVEL) {
+            section.fill(Block::Air);
+            continue;
+        }
+
+        // the section's grid layers, interpolated horizontally once for every column.
+        constexpr auto section_layers = CHUNK_SECTION_SIZE / TERRAIN_CAVE_CELL + 1;
+        auto first_layer = base_y / TERRAIN_CAVE_CELL;
+        std::array<float, section_layers * TERRAIN_COLUMN_COUNT> layer_density;
+        for (auto layer { 0 }; layer < section_layers; layer++) {
+            if (first_layer + layer >= cave_layers) {
+                std::fill_n(layer_density.begin() + layer * TERRAIN_COLUMN_COUNT, TERRAIN_COLUMN_COUNT, -1.0f);
+                continue;
+            }
+
+            auto grid = cave_density.data() + (first_layer + layer) * TERRAIN_CAVE_GRID * TERRAIN_CAVE_GRID;
+            for (auto i { 0u }; i < TERRAIN_COLUMN_COUNT; i++) {
+                auto cell_x = (i & 15) / TERRAIN_CAVE_CELL;
+                auto cell_z = (i >> 4) / TERRAIN_CAVE_CELL;
+                auto tx = static_cast<float>((i & 15) % TERRAIN_CAVE_CELL) / TERRAIN_CAVE_CELL;
+                auto tz = static_cast<float>((i >> 4) % TERRAIN_CAVE_CELL) / TERRAIN_CAVE_CELL;
+
+                auto d00 = grid[cell_z * TERRAIN_CAVE_GRID + cell_x];
+                auto d10 = grid[cell_z * TERRAIN_CAVE_GRID + cell_x + 1];
+                auto d01 = grid[(cell_z + 1) * TERRAIN_CAVE_GRID + cell_x];
+                auto d11 = grid[(cell_z + 1) * TERRAIN_CAVE_GRID + cell_x + 1];
+                auto d0 = d00 + (d10 - d00) * tx;
+                auto d1 = d01 + (d11 - d01) * tx;
+                layer_density[layer * TERRAIN_COLUMN_COUNT + i] = d0 + (d1 - d0) * tz;
+            }
+        }
+
+        for (auto y { 0 }; y < CHUNK_SECTION_SIZE; y++) {
+            auto world_y = base_y + y;
+            auto layer = y / TERRAIN_CAVE_CELL;
+            auto ty = static_cast<float>(y % TERRAIN_CAVE_CELL) / TERRAIN_CAVE_CELL;
+            auto below = layer_density.data() + layer * TERRAIN_COLUMN_COUNT;
+            auto above = below + TERRAIN_COLUMN_COUNT;
+
+            auto layer_blocks = blocks.data() + ChunkSection::get_block_index(0, y, 0);
+            for (auto i { 0u }; i < TERRAIN_COLUMN_COUNT; i++) {
+                auto height = heights[i];
+                layer_blocks[i] = get_layer_block(world_y, height);
+                if (world_y >= height)
+                    continue;
+
+                // caves stay sealed below water, they would have to be flooded otherwise.
+                auto density = below[i] + (above[i] - below[i]) * ty;
+                auto sealed = height <= TERRAIN_SEA_LEVEL && world_y >= height - TERRAIN_DIRT_DEPTH;
+                if (world_y > 0 && !sealed && density > TERRAIN_CAVE_THRESHOLD)
+                    layer_blocks[i] = Block::Air;
+            }
+        }
+
+        section.assign(blocks);
+    }
+}
+
+void TerrainGenerator::generate_lod(
+    int32_t origin_x,
+    int32_t origin_z,
+    uint32_t level,
+    std::span<std::array<Block, CHUNK_SECTION_VOLUME>> sections) const
+{
+    auto scale = 1 << level;
+
+    // every cell takes the height of the column at its center.
+    std::array<int32_t, TERRAIN_COLUMN_COUNT> heights;
+    auto center = static_cast<float>(scale / 2);
+    compute_heights(origin_x + center, origin_z + center, static_cast<float>(scale), heights);
+
+    for (auto section_index { 0u }; section_index < sections.size(); section_index++) {
+        auto& blocks = sections[section_index];
+        for (auto y { 0 }; y < CHUNK_SECTION_SIZE; y++) {
+            auto cell_y = static_cast<int32_t>(section_index * CHUNK_SECTION_SIZE + y) * scale;
+            auto layer_blocks = blocks.data() + ChunkSection::get_block_index(0, y, 0);
+
+            for (auto i { 0u }; i < TERRAIN_COLUMN_COUNT; i++) {
+                auto height = heights[i];
+
+                // solid when the surface lies above the cell's center, with the material of the topmost
+                // block inside, so the surface keeps its grass and sand.
+                auto solid = cell_y + scale / 2 < height;
+                auto y_top = solid ? std::min(cell_y + scale - 1, height - 1) : cell_y + scale / 2;
+                layer_blocks[i] = get_layer_block(y_top, height);
+            }
+        }
+    }
+}
+
+void TerrainGenerator::generate(std::span<Chunk* const> chunks, JobPriority priority) const
+{
+    m_jobs->parallel_for(chunks.size(), [&](uint32_t index) { generate(*chunks[index]); }, priority);
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <span>
+
+#include "chunk.h"
+#include "helper.h"
+#include "job_subsystem.h"
+#include "noise.h"
+
+#define TERRAIN_SEA_LEVEL 64
+
+#define TERRAIN_COLUMN_COUNT (CHUNK_SECTION_SIZE * CHUNK_SECTION_SIZE)
+
+struct TerrainGeneratorInfo {
+    uint32_t seed;
+    JobSubsystem* jobs;
+
+    // null picks the widest ISA the CPU supports.
+    NoiseKernels const* kernels { nullptr };
+};
+
+// a domain warped height field with stone, dirt and grass or sand layers, water up to sea level and
+// caves carved by 3d noise. columns only depend on the seed and their position, never on their neighbors.
+class TerrainGenerator {
+    MAKE_NON_COPYABLE(TerrainGenerator);
+    MAKE_NON_MOVABLE(TerrainGenerator);
+
+public:
+    TerrainGenerator() = default;
+
+    void init(TerrainGeneratorInfo const& info);
+
+    // overwrites every section. thread safe, columns may be generated concurrently.
+    void generate(Chunk& chunk) const;
+
+    // one column per job, returns once every column is done.
+    void generate(std::span<Chunk* const> chunks, JobPriority priority = JobPriority::Normal) const;
+
+    // a coarse column where every block stands for a cube of 2^level blocks, starting at block origin_x,
+    // origin_z. sections are 16^3 cells in get_block_index() order, bottom up, and should cover
+    // CHUNK_HEIGHT >> level cells. caves are left out, they are hardly visible from far away.
+    void generate_lod(
+        int32_t origin_x,
+        int32_t origin_z,
+        uint32_t level,
+        std::span<std::array<Block, CHUNK_SECTION_VOLUME>> sections) const;
+
+    CpuISA get_isa() const { return m_kernels->isa; }
+
+private:
+    // surface heights of 16x16 columns spaced step blocks apart, returns the highest.
+    int32_t compute_heights(float origin_x, float origin_z, float step, std::span<int32_t, TERRAIN_COLUMN_COUNT> heights) const;
+
+private:
+    JobSubsystem* m_jobs { nullptr };
+    NoiseKernels const* m_kernels { nullptr };
+
+    NoiseOctaves m_warp_x {};
+    NoiseOctaves m_warp_z {};
+    NoiseOctaves m_height {};
+    NoiseOctaves m_caves {};
+};
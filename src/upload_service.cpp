@@ -0,0 +1,398 @@
+#include <algorithm>
+#include <cstring>
+
+#include "upload_service.h"
+#include "vulkan_helper.h"
+
+namespace {
+
+VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+}
+
+void UploadService::init(UploadServiceInfo const& info)
+{
+    m_device = info.device;
+    m_allocator = info.allocator;
+    m_transfer_queue = info.transfer_queue;
+    m_transfer_queue_family = info.transfer_queue_family;
+    m_graphics_queue_family = info.graphics_queue_family;
+
+    VkSemaphoreTypeCreateInfo timeline_type_create_info {};
+    timeline_type_create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    timeline_type_create_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    timeline_type_create_info.initialValue = 0;
+
+    VkSemaphoreCreateInfo timeline_create_info {};
+    timeline_create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    timeline_create_info.pNext = &timeline_type_create_info;
+
+    VK_CHECK(vkCreateSemaphore(m_device, &timeline_create_info, nullptr, &m_timeline_semaphore));
+
+    auto staging_size = align_up(info.staging_size, UPLOAD_SERVICE_STAGING_ALIGNMENT);
+    m_staging = m_allocator->create_buffer(staging_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VKHMemoryUsage::CPUToGPU);
+    m_staging_data = static_cast<uint8_t*>(m_staging.allocation.mapped);
+
+    m_stats.staging_size = staging_size;
+}
+
+void UploadService::deinit()
+{
+    if (m_open_batch_recording) {
+        VK_CHECK(vkEndCommandBuffer(m_open_batch.cmd_buffer));
+        m_free_batches.push_back(m_open_batch);
+        m_open_batch_recording = false;
+    }
+
+    for (auto& batch : m_pending_batches)
+        m_free_batches.push_back(batch);
+    m_pending_batches.clear();
+
+    for (auto& batch : m_free_batches) {
+        vkFreeCommandBuffers(m_device, batch.cmd_pool, 1, &batch.cmd_buffer);
+        vkDestroyCommandPool(m_device, batch.cmd_pool, nullptr);
+    }
+    m_free_batches.clear();
+
+    m_release_buffer_barriers.clear();
+    m_release_buffer_indices.clear();
+    m_release_image_barriers.clear();
+    m_acquire_buffer_barriers.clear();
+    m_acquire_image_barriers.clear();
+
+    m_allocator->destroy_buffer(m_staging);
+    m_staging_data = nullptr;
+
+    vkDestroySemaphore(m_device, m_timeline_semaphore, nullptr);
+    m_timeline_semaphore = nullptr;
+}
+
+uint64_t UploadService::upload_buffer(VkBuffer dst, VkDeviceSize dst_offset, void const* data, VkDeviceSize size)
+{
+    if (size == 0)
+        return 0;
+
+    std::lock_guard lock(m_mutex);
+
+    auto staging_offset = reserve(size);
+    if (staging_offset == UINT64_MAX)
+        return 0;
+
+    std::memcpy(m_staging_data + staging_offset, data, size);
+
+    auto& batch = get_open_batch();
+
+    VkBufferCopy region {};
+    region.srcOffset = staging_offset;
+    region.dstOffset = dst_offset;
+    region.size = size;
+    vkCmdCopyBuffer(batch.cmd_buffer, m_staging.buffer, dst, 1, &region);
+
+    release_buffer(dst, dst_offset, size);
+
+    m_stats.uploaded_bytes += size;
+    m_stats.upload_count++;
+
+    return batch.value;
+}
+
+uint64_t UploadService::upload_image(
+    VkImage dst,
+    VkImageAspectFlags aspect,
+    VkExtent3D extent,
+    void const* data,
+    VkDeviceSize size,
+    VkImageLayout final_layout)
+{
+    if (size == 0)
+        return 0;
+
+    std::lock_guard lock(m_mutex);
+
+    auto staging_offset = reserve(size);
+    if (staging_offset == UINT64_MAX)
+        return 0;
+
+    std::memcpy(m_staging_data + staging_offset, data, size);
+
+    auto& batch = get_open_batch();
+
+    // the old contents are discarded, so earlier reads only need to finish before the copy overwrites them.
+    VkImageMemoryBarrier2 to_transfer_dst {};
+    to_transfer_dst.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+    to_transfer_dst.srcStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+    to_transfer_dst.srcAccessMask = VK_ACCESS_2_NONE;
+    to_transfer_dst.dstStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+    to_transfer_dst.dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+    to_transfer_dst.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    to_transfer_dst.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    to_transfer_dst.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    to_transfer_dst.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    to_transfer_dst.image = dst;
+    to_transfer_dst.subresourceRange = { aspect, 0, 1, 0, 1 };
+
+    VkDependencyInfo dependency_info {};
+    dependency_info.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+    dependency_info.imageMemoryBarrierCount = 1;
+    dependency_info.pImageMemoryBarriers = &to_transfer_dst;
+    vkCmdPipelineBarrier2(batch.cmd_buffer, &dependency_info);
+
+    VkBufferImageCopy region {};
+    region.bufferOffset = staging_offset;
+    region.imageSubresource = { aspect, 0, 0, 1 };
+    region.imageExtent = extent;
+    vkCmdCopyBufferToImage(batch.cmd_buffer, m_staging.buffer, dst, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+    release_image(dst, aspect, final_layout);
+
+    m_stats.uploaded_bytes += size;
+    m_stats.upload_count++;
+
+    return batch.value;
+}
+
+void UploadService::flush()
+{
+    std::lock_guard lock(m_mutex);
+
+    if (!m_open_batch_recording)
+        return;
+
+    auto& batch = m_open_batch;
+
+    // the release half of the ownership transfer, the graphics queue records the matching acquire.
+    if (has_ownership_transfer()) {
+        VkDependencyInfo dependency_info {};
+        dependency_info.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+        dependency_info.bufferMemoryBarrierCount = m_release_buffer_barriers.size();
+        dependency_info.pBufferMemoryBarriers = m_release_buffer_barriers.data();
+        dependency_info.imageMemoryBarrierCount = m_release_image_barriers.size();
+        dependency_info.pImageMemoryBarriers = m_release_image_barriers.data();
+        vkCmdPipelineBarrier2(batch.cmd_buffer, &dependency_info);
+    }
+
+    VK_CHECK(vkEndCommandBuffer(batch.cmd_buffer));
+
+    VkSemaphoreSubmitInfo signal_semaphore_info {};
+    signal_semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+    signal_semaphore_info.semaphore = m_timeline_semaphore;
+    signal_semaphore_info.value = batch.value;
+    signal_semaphore_info.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+
+    VkCommandBufferSubmitInfo command_buffer_info {};
+    command_buffer_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO;
+    command_buffer_info.commandBuffer = batch.cmd_buffer;
+
+    VkSubmitInfo2 submit_info {};
+    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
+    submit_info.signalSemaphoreInfoCount = 1;
+    submit_info.pSignalSemaphoreInfos = &signal_semaphore_info;
+    submit_info.commandBufferInfoCount = 1;
+    submit_info.pCommandBufferInfos = &command_buffer_info;
+
+    VK_CHECK(vkQueueSubmit2(m_transfer_queue, 1, &submit_info, VK_NULL_HANDLE));
+
+    // the acquire repeats the release with the source scope replaced by the semaphore wait. without an
+    // ownership transfer it is a plain barrier, ordered after the copies by submission order.
+    for (auto barrier : m_release_buffer_barriers) {
+        if (has_ownership_transfer()) {
+            barrier.srcStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+            barrier.srcAccessMask = VK_ACCESS_2_NONE;
+        }
+        barrier.dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+        barrier.dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT;
+        m_acquire_buffer_barriers.push_back(barrier);
+    }
+
+    for (auto barrier : m_release_image_barriers) {
+        if (has_ownership_transfer()) {
+            barrier.srcStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+            barrier.srcAccessMask = VK_ACCESS_2_NONE;
+        }
+        barrier.dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+        barrier.dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT;
+        m_acquire_image_barriers.push_back(barrier);
+    }
+
+    m_release_buffer_barriers.clear();
+    m_release_buffer_indices.clear();
+    m_release_image_barriers.clear();
+    m_acquire_value = batch.value;
+
+    batch.ring_head = m_ring_head;
+    m_pending_batches.push_back(batch);
+    m_open_batch_recording = false;
+    m_next_value++;
+    m_stats.batch_count++;
+}
+
+bool UploadService::is_complete(uint64_t ticket) const
+{
+    uint64_t value {};
+    VK_CHECK(vkGetSemaphoreCounterValue(m_device, m_timeline_semaphore, &value));
+    return value >= ticket;
+}
+
+void UploadService::wait(uint64_t ticket) const
+{
+    VkSemaphoreWaitInfo wait_info {};
+    wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    wait_info.semaphoreCount = 1;
+    wait_info.pSemaphores = &m_timeline_semaphore;
+    wait_info.pValues = &ticket;
+    VK_CHECK(vkWaitSemaphores(m_device, &wait_info, UINT64_MAX));
+}
+
+uint64_t UploadService::record_acquires(VkCommandBuffer cmd_buffer)
+{
+    std::lock_guard lock(m_mutex);
+
+    if (m_acquire_buffer_barriers.empty() && m_acquire_image_barriers.empty())
+        return 0;
+
+    VkDependencyInfo dependency_info {};
+    dependency_info.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+    dependency_info.bufferMemoryBarrierCount = m_acquire_buffer_barriers.size();
+    dependency_info.pBufferMemoryBarriers = m_acquire_buffer_barriers.data();
+    dependency_info.imageMemoryBarrierCount = m_acquire_image_barriers.size();
+    dependency_info.pImageMemoryBarriers = m_acquire_image_barriers.data();
+    vkCmdPipelineBarrier2(cmd_buffer, &dependency_info);
+
+    m_acquire_buffer_barriers.clear();
+    m_acquire_image_barriers.clear();
+
+    return m_acquire_value;
+}
+
+UploadServiceStats UploadService::get_stats() const
+{
+    std::lock_guard lock(m_mutex);
+
+    auto stats = m_stats;
+    stats.staging_used = m_ring_head - m_ring_tail;
+    return stats;
+}
+
+VkDeviceSize UploadService::reserve(VkDeviceSize size)
+{
+    auto capacity = m_staging.size;
+    if (size > capacity) {
+        fmt::println(stderr, "UploadService::reserve(): upload of {} bytes exceeds the staging ring!", size);
+        return UINT64_MAX;
+    }
+
+    retire();
+
+    // an upload never straddles the end of the ring, it skips to the start instead.
+    auto position = align_up(m_ring_head, UPLOAD_SERVICE_STAGING_ALIGNMENT);
+    if (position % capacity + size > capacity)
+        position = align_up(position, capacity);
+
+    if (position + size - m_ring_tail > capacity) {
+        m_stats.staging_full_count++;
+        return UINT64_MAX;
+    }
+
+    m_ring_head = position + size;
+    return position % capacity;
+}
+
+void UploadService::retire()
+{
+    if (m_pending_batches.empty())
+        return;
+
+    uint64_t completed {};
+    VK_CHECK(vkGetSemaphoreCounterValue(m_device, m_timeline_semaphore, &completed));
+
+    while (!m_pending_batches.empty() && m_pending_batches.front().value <= completed) {
+        auto batch = m_pending_batches.front();
+        m_pending_batches.pop_front();
+
+        VK_CHECK(vkResetCommandPool(m_device, batch.cmd_pool, 0));
+        m_ring_tail = batch.ring_head;
+        m_free_batches.push_back(batch);
+    }
+}
+
+UploadService::Batch& UploadService::get_open_batch()
+{
+    if (m_open_batch_recording)
+        return m_open_batch;
+
+    if (m_free_batches.empty()) {
+        Batch batch {};
+
+        VkCommandPoolCreateInfo cmd_pool_create_info {};
+        cmd_pool_create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        cmd_pool_create_info.queueFamilyIndex = m_transfer_queue_family;
+        cmd_pool_create_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        VK_CHECK(vkCreateCommandPool(m_device, &cmd_pool_create_info, nullptr, &batch.cmd_pool));
+
+        VkCommandBufferAllocateInfo cmd_buffer_allocate_info {};
+        cmd_buffer_allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        cmd_buffer_allocate_info.commandPool = batch.cmd_pool;
+        cmd_buffer_allocate_info.commandBufferCount = 1;
+        cmd_buffer_allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        VK_CHECK(vkAllocateCommandBuffers(m_device, &cmd_buffer_allocate_info, &batch.cmd_buffer));
+
+        m_free_batches.push_back(batch);
+    }
+
+    m_open_batch = m_free_batches.back();
+    m_free_batches.pop_back();
+    m_open_batch.value = m_next_value;
+    m_open_batch_recording = true;
+
+    VkCommandBufferBeginInfo begin_info {};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    VK_CHECK(vkBeginCommandBuffer(m_open_batch.cmd_buffer, &begin_info));
+
+    return m_open_batch;
+}
+
+void UploadService::release_buffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size)
+{
+    if (auto it = m_release_buffer_indices.find(buffer); it != m_release_buffer_indices.end()) {
+        auto& barrier = m_release_buffer_barriers[it->second];
+        auto end = std::max(barrier.offset + barrier.size, offset + size);
+        barrier.offset = std::min(barrier.offset, offset);
+        barrier.size = end - barrier.offset;
+        return;
+    }
+
+    VkBufferMemoryBarrier2 barrier {};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2;
+    barrier.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+    barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+    barrier.dstStageMask = VK_PIPELINE_STAGE_2_NONE;
+    barrier.dstAccessMask = VK_ACCESS_2_NONE;
+    barrier.srcQueueFamilyIndex = has_ownership_transfer() ? m_transfer_queue_family : VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = has_ownership_transfer() ? m_graphics_queue_family : VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = buffer;
+    barrier.offset = offset;
+    barrier.size = size;
+    m_release_buffer_indices.emplace(buffer, m_release_buffer_barriers.size());
+    m_release_buffer_barriers.push_back(barrier);
+}
+
+void UploadService::release_image(VkImage image, VkImageAspectFlags aspect, VkImageLayout final_layout)
+{
+    VkImageMemoryBarrier2 barrier {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+    barrier.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+    barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+    barrier.dstStageMask = VK_PIPELINE_STAGE_2_NONE;
+    barrier.dstAccessMask = VK_ACCESS_2_NONE;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = final_layout;
+    barrier.srcQueueFamilyIndex = has_ownership_transfer() ? m_transfer_queue_family : VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = has_ownership_transfer() ? m_graphics_queue_family : VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange = { aspect, 0, 1, 0, 1 };
+    m_release_image_barriers.push_back(barrier);
+}
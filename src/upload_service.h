@@ -0,0 +1,136 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "helper.h"
+#include "vulkan.h"
+#include "vulkan_allocator.h"
+
+#define UPLOAD_SERVICE_DEFAULT_STAGING_SIZE (64ull * 1024 * 1024)
+#define UPLOAD_SERVICE_STAGING_ALIGNMENT 16
+
+struct UploadServiceInfo {
+    VkDevice device;
+    VKHAllocator* allocator;
+
+    // may be the graphics queue itself when the device has no separate transfer family.
+    VkQueue transfer_queue;
+    uint32_t transfer_queue_family;
+    uint32_t graphics_queue_family;
+
+    VkDeviceSize staging_size { UPLOAD_SERVICE_DEFAULT_STAGING_SIZE };
+};
+
+struct UploadServiceStats {
+    uint64_t uploaded_bytes;
+    uint64_t upload_count;
+    uint64_t batch_count;
+    uint64_t staging_full_count;
+    VkDeviceSize staging_size;
+    VkDeviceSize staging_used;
+};
+
+// uploads go through a persistently mapped staging ring and are recorded into a batch on the transfer
+// queue. flush() submits the batch, the graphics queue then acquires ownership of everything it touched.
+class UploadService {
+    MAKE_NON_COPYABLE(UploadService);
+    MAKE_NON_MOVABLE(UploadService);
+
+public:
+    UploadService() = default;
+
+    void init(UploadServiceInfo const& info);
+
+    // every submitted batch must have completed, e.g. after vkDeviceWaitIdle.
+    void deinit();
+
+    // returns the ticket of the batch the copy lands in, or 0 when the staging ring is full and the
+    // upload has to be retried once earlier batches have retired. never waits on the GPU.
+    uint64_t upload_buffer(VkBuffer dst, VkDeviceSize dst_offset, void const* data, VkDeviceSize size);
+
+    // uploads mip 0, layer 0. the image ends up in final_layout, its previous contents are discarded.
+    // re-uploading waits for earlier reads on the transfer queue only. with a separate transfer family the
+    // caller has to make sure no frame still samples the image, e.g. by uploading into a fresh one and
+    // retiring the old one through deferred destruction.
+    uint64_t upload_image(
+        VkImage dst,
+        VkImageAspectFlags aspect,
+        VkExtent3D extent,
+        void const* data,
+        VkDeviceSize size,
+        VkImageLayout final_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+    // submits the open batch, if it recorded anything.
+    void flush();
+
+    bool is_complete(uint64_t ticket) const;
+
+    void wait(uint64_t ticket) const;
+
+    // records the ownership acquire for every flushed upload not yet acquired, returns the
+    // timeline value the graphics submission must wait on, 0 when there is nothing to wait for.
+    uint64_t record_acquires(VkCommandBuffer cmd_buffer);
+
+    VkSemaphore get_timeline_semaphore() const { return m_timeline_semaphore; }
+
+    bool has_ownership_transfer() const { return m_transfer_queue_family != m_graphics_queue_family; }
+
+    UploadServiceStats get_stats() const;
+
+private:
+    struct Batch {
+        VkCommandPool cmd_pool;
+        VkCommandBuffer cmd_buffer;
+        uint64_t value;
+        uint64_t ring_head;
+    };
+
+    // reserves staging memory, returns UINT64_MAX when the ring is full.
+    VkDeviceSize reserve(VkDeviceSize size);
+
+    void retire();
+
+    Batch& get_open_batch();
+
+    // one barrier per buffer and batch, grown to span every range the batch wrote.
+    void release_buffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size);
+
+    void release_image(VkImage image, VkImageAspectFlags aspect, VkImageLayout final_layout);
+
+private:
+    VkDevice m_device { nullptr };
+    VKHAllocator* m_allocator { nullptr };
+    VkQueue m_transfer_queue { nullptr };
+    uint32_t m_transfer_queue_family {};
+    uint32_t m_graphics_queue_family {};
+
+    VkSemaphore m_timeline_semaphore { nullptr };
+    uint64_t m_next_value { 1 };
+
+    VKHBuffer m_staging;
+    uint8_t* m_staging_data { nullptr };
+
+    // monotonic positions, the physical offset is the position modulo the staging size.
+    uint64_t m_ring_head {};
+    uint64_t m_ring_tail {};
+
+    std::vector<Batch> m_free_batches;
+    std::deque<Batch> m_pending_batches;
+    Batch m_open_batch {};
+    bool m_open_batch_recording { false };
+
+    std::vector<VkBufferMemoryBarrier2> m_release_buffer_barriers;
+    std::unordered_map<VkBuffer, size_t> m_release_buffer_indices;
+    std::vector<VkImageMemoryBarrier2> m_release_image_barriers;
+    std::vector<VkBufferMemoryBarrier2> m_acquire_buffer_barriers;
+    std::vector<VkImageMemoryBarrier2> m_acquire_image_barriers;
+    uint64_t m_acquire_value {};
+
+    UploadServiceStats m_stats {};
+
+    mutable std::mutex m_mutex;
+};
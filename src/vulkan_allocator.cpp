@@ -0,0 +1,568 @@
+#include <algorithm>
+#include <bit>
+
+#include "vulkan_allocator.h"
+#include "vulkan_helper.h"
+
+#define VKH_ALLOCATOR_INVALID_CHUNK UINT32_MAX
+
+namespace {
+
+void tlsf_mapping(VkDeviceSize size, uint32_t& fl, uint32_t& sl)
+{
+    if (size < VKH_ALLOCATOR_SL_COUNT) {
+        fl = 0;
+        sl = static_cast<uint32_t>(size);
+        return;
+    }
+
+    auto msb = static_cast<uint32_t>(std::bit_width(size)) - 1;
+    fl = msb - VKH_ALLOCATOR_SL_BITS + 1;
+    sl = static_cast<uint32_t>(size >> (msb - VKH_ALLOCATOR_SL_BITS)) - VKH_ALLOCATOR_SL_COUNT;
+}
+
+// rounds size up to the next list boundary, so any chunk found in that list is large enough.
+VkDeviceSize tlsf_round_up(VkDeviceSize size)
+{
+    if (size < VKH_ALLOCATOR_SL_COUNT)
+        return size;
+
+    auto msb = static_cast<uint32_t>(std::bit_width(size)) - 1;
+    return size + (1ull << (msb - VKH_ALLOCATOR_SL_BITS)) - 1;
+}
+
+VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+}
+
+void VKHAllocator::init(VKHAllocatorInfo const& info)
+{
+    m_device = info.device;
+    m_block_size = info.block_size;
+    vkGetPhysicalDeviceMemoryProperties(info.physical_device, &m_memory_properties);
+}
+
+void VKHAllocator::deinit()
+{
+    auto stats = get_stats();
+    fmt::println("allocator: {} blocks ({:.1f} MiB), {} dedicated ({:.1f} MiB), {:.1f} MiB used, fragmentation {:.2f}",
+        stats.block_count, stats.block_bytes / (1024.0 * 1024.0),
+        stats.dedicated_allocation_count, stats.dedicated_bytes / (1024.0 * 1024.0),
+        stats.used_bytes / (1024.0 * 1024.0), stats.fragmentation);
+
+    if (m_allocation_count > 0)
+        fmt::println(stderr, "allocator: {} allocations were never freed!", m_allocation_count);
+
+    for (auto& pool : m_pools) {
+        for (auto& block : pool.blocks) {
+            if (block)
+                destroy_block(*block);
+        }
+    }
+
+    m_pools.clear();
+    m_allocation_count = 0;
+    m_dedicated_count = 0;
+    m_dedicated_bytes = 0;
+    m_used_bytes = 0;
+}
+
+VKHAllocation VKHAllocator::allocate(VkMemoryRequirements const& requirements, VKHMemoryUsage usage, bool linear)
+{
+    return allocate_internal(requirements, usage, linear, false, nullptr, nullptr);
+}
+
+void VKHAllocator::free(VKHAllocation& allocation)
+{
+    if (!allocation)
+        return;
+
+    std::lock_guard lock(m_mutex);
+
+    m_allocation_count--;
+    m_used_bytes -= allocation.size;
+
+    if (allocation.is_dedicated()) {
+        m_dedicated_count--;
+        m_dedicated_bytes -= allocation.size;
+        vkFreeMemory(m_device, allocation.memory, nullptr);
+        allocation = {};
+        return;
+    }
+
+    auto& pool = m_pools[allocation.pool];
+    auto& block = *pool.blocks[allocation.block];
+    free_chunk(block, allocation.chunk);
+    block.allocation_count--;
+
+    // keeps one empty block per pool around so a single allocation bouncing across the boundary does not thrash.
+    if (block.allocation_count == 0) {
+        auto empty_blocks = std::count_if(pool.blocks.begin(), pool.blocks.end(), [](auto const& other) {
+            return other && other->allocation_count == 0;
+        });
+
+        if (empty_blocks > 1) {
+            destroy_block(block);
+            pool.blocks[allocation.block].reset();
+        }
+    }
+
+    allocation = {};
+}
+
+VKHBuffer VKHAllocator::create_buffer(VkDeviceSize size, VkBufferUsageFlags usage, VKHMemoryUsage memory_usage)
+{
+    VkBufferCreateInfo create_info {};
+    create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    create_info.size = size;
+    create_info.usage = usage;
+    create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VKHBuffer buffer {};
+    buffer.size = size;
+    VK_CHECK(vkCreateBuffer(m_device, &create_info, nullptr, &buffer.buffer));
+
+    VkMemoryDedicatedRequirements dedicated_requirements {};
+    dedicated_requirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+
+    VkMemoryRequirements2 requirements {};
+    requirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+    requirements.pNext = &dedicated_requirements;
+
+    VkBufferMemoryRequirementsInfo2 requirements_info {};
+    requirements_info.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_REQUIREMENTS_INFO_2;
+    requirements_info.buffer = buffer.buffer;
+    vkGetBufferMemoryRequirements2(m_device, &requirements_info, &requirements);
+
+    auto dedicated = dedicated_requirements.prefersDedicatedAllocation || dedicated_requirements.requiresDedicatedAllocation;
+    buffer.allocation = allocate_internal(requirements.memoryRequirements, memory_usage, true, dedicated, buffer.buffer, nullptr);
+    if (!buffer.allocation) {
+        vkDestroyBuffer(m_device, buffer.buffer, nullptr);
+        return {};
+    }
+
+    VK_CHECK(vkBindBufferMemory(m_device, buffer.buffer, buffer.allocation.memory, buffer.allocation.offset));
+    return buffer;
+}
+
+void VKHAllocator::destroy_buffer(VKHBuffer& buffer)
+{
+    if (buffer.buffer)
+        vkDestroyBuffer(m_device, buffer.buffer, nullptr);
+    free(buffer.allocation);
+    buffer = {};
+}
+
+VKHImage VKHAllocator::create_image(VkImageCreateInfo const& create_info, VKHMemoryUsage memory_usage)
+{
+    VKHImage image {};
+    VK_CHECK(vkCreateImage(m_device, &create_info, nullptr, &image.image));
+
+    VkMemoryDedicatedRequirements dedicated_requirements {};
+    dedicated_requirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+
+    VkMemoryRequirements2 requirements {};
+    requirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+    requirements.pNext = &dedicated_requirements;
+
+    VkImageMemoryRequirementsInfo2 requirements_info {};
+    requirements_info.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2;
+    requirements_info.image = image.image;
+    vkGetImageMemoryRequirements2(m_device, &requirements_info, &requirements);
+
+    auto dedicated = dedicated_requirements.prefersDedicatedAllocation || dedicated_requirements.requiresDedicatedAllocation;
+    auto linear = create_info.tiling == VK_IMAGE_TILING_LINEAR;
+    image.allocation = allocate_internal(requirements.memoryRequirements, memory_usage, linear, dedicated, nullptr, image.image);
+    if (!image.allocation) {
+        vkDestroyImage(m_device, image.image, nullptr);
+        return {};
+    }
+
+    VK_CHECK(vkBindImageMemory(m_device, image.image, image.allocation.memory, image.allocation.offset));
+    return image;
+}
+
+void VKHAllocator::destroy_image(VKHImage& image)
+{
+    if (image.image)
+        vkDestroyImage(m_device, image.image, nullptr);
+    free(image.allocation);
+    image = {};
+}
+
+VKHAllocatorStats VKHAllocator::get_stats() const
+{
+    std::lock_guard lock(m_mutex);
+
+    VKHAllocatorStats stats {};
+    stats.allocation_count = m_allocation_count;
+    stats.dedicated_allocation_count = m_dedicated_count;
+    stats.dedicated_bytes = m_dedicated_bytes;
+    stats.used_bytes = m_used_bytes;
+
+    VkDeviceSize largest_free_range_sum {};
+    for (auto const& pool : m_pools) {
+        for (auto const& block : pool.blocks) {
+            if (!block)
+                continue;
+
+            stats.block_count++;
+            stats.block_bytes += block->size;
+
+            VkDeviceSize block_largest_free_range {};
+            for (auto const& chunk : block->chunks) {
+                if (!chunk.free || chunk.size == 0)
+                    continue;
+
+                stats.free_bytes += chunk.size;
+                stats.free_range_count++;
+                block_largest_free_range = std::max(block_largest_free_range, chunk.size);
+            }
+
+            largest_free_range_sum += block_largest_free_range;
+            stats.largest_free_range = std::max(stats.largest_free_range, block_largest_free_range);
+        }
+    }
+
+    if (stats.free_bytes > 0)
+        stats.fragmentation = 1.0 - static_cast<double>(largest_free_range_sum) / stats.free_bytes;
+
+    return stats;
+}
+
+VKHAllocation VKHAllocator::allocate_internal(
+    VkMemoryRequirements const& requirements,
+    VKHMemoryUsage usage,
+    bool linear,
+    bool dedicated,
+    VkBuffer dedicated_buffer,
+    VkImage dedicated_image)
+{
+    auto memory_type = find_memory_type(requirements.memoryTypeBits, usage);
+    if (memory_type == UINT32_MAX) {
+        fmt::println(stderr, "VKHAllocator::allocate(): no memory type matches the requirements!");
+        return {};
+    }
+
+    auto host_visible = (m_memory_properties.memoryTypes[memory_type].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0;
+
+    std::lock_guard lock(m_mutex);
+
+    auto pool_index = find_or_create_pool(memory_type, linear);
+    auto& pool = m_pools[pool_index];
+
+    if (dedicated || requirements.size > pool.block_size / 2) {
+        VkMemoryDedicatedAllocateInfo dedicated_info {};
+        dedicated_info.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+        dedicated_info.buffer = dedicated_buffer;
+        dedicated_info.image = dedicated_image;
+
+        VkMemoryAllocateInfo allocate_info {};
+        allocate_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocate_info.pNext = (dedicated_buffer || dedicated_image) ? &dedicated_info : nullptr;
+        allocate_info.allocationSize = requirements.size;
+        allocate_info.memoryTypeIndex = memory_type;
+
+        VKHAllocation allocation {};
+        allocation.size = requirements.size;
+        VK_CHECK(vkAllocateMemory(m_device, &allocate_info, nullptr, &allocation.memory));
+
+        if (host_visible)
+            VK_CHECK(vkMapMemory(m_device, allocation.memory, 0, VK_WHOLE_SIZE, 0, &allocation.mapped));
+
+        m_allocation_count++;
+        m_dedicated_count++;
+        m_dedicated_bytes += requirements.size;
+        m_used_bytes += requirements.size;
+        return allocation;
+    }
+
+    auto alignment = std::max<VkDeviceSize>(requirements.alignment, 1);
+
+    uint32_t block_index { UINT32_MAX };
+    uint32_t chunk {};
+
+    for (uint32_t i { 0 }; i < pool.blocks.size() && block_index == UINT32_MAX; i++) {
+        if (pool.blocks[i] && allocate_from_block(*pool.blocks[i], requirements.size, alignment, chunk))
+            block_index = i;
+    }
+
+    if (block_index == UINT32_MAX) {
+        block_index = create_block(pool);
+        if (!allocate_from_block(*pool.blocks[block_index], requirements.size, alignment, chunk)) {
+            fmt::println(stderr, "VKHAllocator::allocate(): a fresh block could not hold {} bytes!", requirements.size);
+            return {};
+        }
+    }
+
+    auto& block = *pool.blocks[block_index];
+    block.allocation_count++;
+
+    VKHAllocation allocation {};
+    allocation.memory = block.memory;
+    allocation.offset = block.chunks[chunk].offset;
+    allocation.size = requirements.size;
+    allocation.mapped = block.mapped ? block.mapped + allocation.offset : nullptr;
+    allocation.pool = pool_index;
+    allocation.block = block_index;
+    allocation.chunk = chunk;
+
+    m_allocation_count++;
+    m_used_bytes += requirements.size;
+    return allocation;
+}
+
+uint32_t VKHAllocator::find_memory_type(uint32_t type_bits, VKHMemoryUsage usage) const
+{
+    VkMemoryPropertyFlags required {};
+    VkMemoryPropertyFlags preferred {};
+
+    switch (usage) {
+    case VKHMemoryUsage::GPUOnly:
+        preferred = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+        break;
+    case VKHMemoryUsage::CPUToGPU:
+        required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        break;
+    case VKHMemoryUsage::GPUToCPU:
+        required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+        preferred = VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+        break;
+    }
+
+    for (auto flags : { required | preferred, required }) {
+        for (uint32_t i { 0 }; i < m_memory_properties.memoryTypeCount; i++) {
+            if ((type_bits & (1u << i)) && (m_memory_properties.memoryTypes[i].propertyFlags & flags) == flags)
+                return i;
+        }
+    }
+
+    return UINT32_MAX;
+}
+
+uint32_t VKHAllocator::find_or_create_pool(uint32_t memory_type, bool linear)
+{
+    for (uint32_t i { 0 }; i < m_pools.size(); i++) {
+        if (m_pools[i].memory_type == memory_type && m_pools[i].linear == linear)
+            return i;
+    }
+
+    auto heap_size = m_memory_properties.memoryHeaps[m_memory_properties.memoryTypes[memory_type].heapIndex].size;
+
+    Pool pool {};
+    pool.memory_type = memory_type;
+    pool.linear = linear;
+    pool.block_size = std::min(m_block_size, heap_size / 8);
+
+    m_pools.push_back(std::move(pool));
+    return m_pools.size() - 1;
+}
+
+uint32_t VKHAllocator::create_block(Pool& pool)
+{
+    auto block = std::make_unique<Block>();
+    block->size = pool.block_size;
+
+    VkMemoryAllocateInfo allocate_info {};
+    allocate_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocate_info.allocationSize = pool.block_size;
+    allocate_info.memoryTypeIndex = pool.memory_type;
+    VK_CHECK(vkAllocateMemory(m_device, &allocate_info, nullptr, &block->memory));
+
+    if (m_memory_properties.memoryTypes[pool.memory_type].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        void* mapped { nullptr };
+        VK_CHECK(vkMapMemory(m_device, block->memory, 0, VK_WHOLE_SIZE, 0, &mapped));
+        block->mapped = static_cast<uint8_t*>(mapped);
+    }
+
+    for (auto& heads : block->free_heads)
+        std::fill(std::begin(heads), std::end(heads), VKH_ALLOCATOR_INVALID_CHUNK);
+
+    block->chunks.push_back({
+        0, block->size,
+        VKH_ALLOCATOR_INVALID_CHUNK, VKH_ALLOCATOR_INVALID_CHUNK,
+        VKH_ALLOCATOR_INVALID_CHUNK, VKH_ALLOCATOR_INVALID_CHUNK,
+        true,
+    });
+    insert_free_chunk(*block, 0);
+
+    // reuses a slot freed by an earlier empty block so allocation indices stay stable.
+    auto slot = std::find(pool.blocks.begin(), pool.blocks.end(), nullptr);
+    if (slot == pool.blocks.end()) {
+        pool.blocks.push_back(std::move(block));
+        return pool.blocks.size() - 1;
+    }
+
+    *slot = std::move(block);
+    return slot - pool.blocks.begin();
+}
+
+void VKHAllocator::destroy_block(Block& block)
+{
+    vkFreeMemory(m_device, block.memory, nullptr);
+    block.memory = nullptr;
+}
+
+bool VKHAllocator::allocate_from_block(Block& block, VkDeviceSize size, VkDeviceSize alignment, uint32_t& chunk)
+{
+    chunk = find_free_chunk(block, size);
+
+    // the head of the list may not fit once aligned, searching with the worst-case padding always does.
+    if (chunk != VKH_ALLOCATOR_INVALID_CHUNK) {
+        auto const& candidate = block.chunks[chunk];
+        if (align_up(candidate.offset, alignment) + size > candidate.offset + candidate.size)
+            chunk = find_free_chunk(block, size + alignment - 1);
+    }
+
+    if (chunk == VKH_ALLOCATOR_INVALID_CHUNK)
+        return false;
+
+    remove_free_chunk(block, chunk);
+
+    auto aligned_offset = align_up(block.chunks[chunk].offset, alignment);
+    auto padding = aligned_offset - block.chunks[chunk].offset;
+
+    // the physical predecessor is never free here, free neighbours are always merged.
+    if (padding > 0) {
+        auto front = new_chunk(block);
+        auto& current = block.chunks[chunk];
+        block.chunks[front] = {
+            current.offset, padding,
+            current.prev_phys, chunk,
+            VKH_ALLOCATOR_INVALID_CHUNK, VKH_ALLOCATOR_INVALID_CHUNK,
+            true,
+        };
+        if (current.prev_phys != VKH_ALLOCATOR_INVALID_CHUNK)
+            block.chunks[current.prev_phys].next_phys = front;
+        current.prev_phys = front;
+        current.offset = aligned_offset;
+        current.size -= padding;
+        insert_free_chunk(block, front);
+    }
+
+    if (block.chunks[chunk].size - size >= VKH_ALLOCATOR_MIN_CHUNK_SIZE) {
+        auto back = new_chunk(block);
+        auto& current = block.chunks[chunk];
+        block.chunks[back] = {
+            current.offset + size, current.size - size,
+            chunk, current.next_phys,
+            VKH_ALLOCATOR_INVALID_CHUNK, VKH_ALLOCATOR_INVALID_CHUNK,
+            true,
+        };
+        if (current.next_phys != VKH_ALLOCATOR_INVALID_CHUNK)
+            block.chunks[current.next_phys].prev_phys = back;
+        current.next_phys = back;
+        current.size = size;
+        insert_free_chunk(block, back);
+    }
+
+    block.chunks[chunk].free = false;
+    return true;
+}
+
+void VKHAllocator::free_chunk(Block& block, uint32_t chunk)
+{
+    block.chunks[chunk].free = true;
+
+    auto next = block.chunks[chunk].next_phys;
+    if (next != VKH_ALLOCATOR_INVALID_CHUNK && block.chunks[next].free) {
+        remove_free_chunk(block, next);
+        block.chunks[chunk].size += block.chunks[next].size;
+        block.chunks[chunk].next_phys = block.chunks[next].next_phys;
+        if (block.chunks[next].next_phys != VKH_ALLOCATOR_INVALID_CHUNK)
+            block.chunks[block.chunks[next].next_phys].prev_phys = chunk;
+        block.chunks[next].size = 0;
+        block.unused_chunks.push_back(next);
+    }
+
+    auto prev = block.chunks[chunk].prev_phys;
+    if (prev != VKH_ALLOCATOR_INVALID_CHUNK && block.chunks[prev].free) {
+        remove_free_chunk(block, prev);
+        block.chunks[prev].size += block.chunks[chunk].size;
+        block.chunks[prev].next_phys = block.chunks[chunk].next_phys;
+        if (block.chunks[chunk].next_phys != VKH_ALLOCATOR_INVALID_CHUNK)
+            block.chunks[block.chunks[chunk].next_phys].prev_phys = prev;
+        block.chunks[chunk].size = 0;
+        block.unused_chunks.push_back(chunk);
+        chunk = prev;
+    }
+
+    insert_free_chunk(block, chunk);
+}
+
+uint32_t VKHAllocator::find_free_chunk(Block const& block, VkDeviceSize size) const
+{
+    uint32_t fl {};
+    uint32_t sl {};
+    tlsf_mapping(tlsf_round_up(size), fl, sl);
+    if (fl >= VKH_ALLOCATOR_FL_COUNT)
+        return VKH_ALLOCATOR_INVALID_CHUNK;
+
+    auto sl_map = block.sl_bitmaps[fl] & (~0u << sl);
+    if (sl_map == 0) {
+        auto fl_map = fl + 1 < 64 ? block.fl_bitmap & (~0ull << (fl + 1)) : 0;
+        if (fl_map == 0)
+            return VKH_ALLOCATOR_INVALID_CHUNK;
+
+        fl = std::countr_zero(fl_map);
+        sl_map = block.sl_bitmaps[fl];
+    }
+
+    sl = std::countr_zero(sl_map);
+    return block.free_heads[fl][sl];
+}
+
+void VKHAllocator::insert_free_chunk(Block& block, uint32_t chunk)
+{
+    uint32_t fl {};
+    uint32_t sl {};
+    tlsf_mapping(block.chunks[chunk].size, fl, sl);
+
+    auto head = block.free_heads[fl][sl];
+    block.chunks[chunk].prev_free = VKH_ALLOCATOR_INVALID_CHUNK;
+    block.chunks[chunk].next_free = head;
+    if (head != VKH_ALLOCATOR_INVALID_CHUNK)
+        block.chunks[head].prev_free = chunk;
+
+    block.free_heads[fl][sl] = chunk;
+    block.fl_bitmap |= 1ull << fl;
+    block.sl_bitmaps[fl] |= 1u << sl;
+}
+
+void VKHAllocator::remove_free_chunk(Block& block, uint32_t chunk)
+{
+    uint32_t fl {};
+    uint32_t sl {};
+    tlsf_mapping(block.chunks[chunk].size, fl, sl);
+
+    auto prev = block.chunks[chunk].prev_free;
+    auto next = block.chunks[chunk].next_free;
+    if (prev != VKH_ALLOCATOR_INVALID_CHUNK)
+        block.chunks[prev].next_free = next;
+    if (next != VKH_ALLOCATOR_INVALID_CHUNK)
+        block.chunks[next].prev_free = prev;
+
+    if (block.free_heads[fl][sl] == chunk) {
+        block.free_heads[fl][sl] = next;
+        if (next == VKH_ALLOCATOR_INVALID_CHUNK) {
+            block.sl_bitmaps[fl] &= ~(1u << sl);
+            if (block.sl_bitmaps[fl] == 0)
+                block.fl_bitmap &= ~(1ull << fl);
+        }
+    }
+}
+
+uint32_t VKHAllocator::new_chunk(Block& block)
+{
+    if (!block.unused_chunks.empty()) {
+        auto chunk = block.unused_chunks.back();
+        block.unused_chunks.pop_back();
+        return chunk;
+    }
+
+    block.chunks.emplace_back();
+    return block.chunks.size() - 1;
+}
@@ -0,0 +1,183 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "helper.h"
+#include "vulkan.h"
+
+#define VKH_ALLOCATOR_SL_BITS 5
+#define VKH_ALLOCATOR_SL_COUNT (1u << VKH_ALLOCATOR_SL_BITS)
+#define VKH_ALLOCATOR_FL_COUNT (64 - VKH_ALLOCATOR_SL_BITS + 1)
+#define VKH_ALLOCATOR_MIN_CHUNK_SIZE 64
+#define VKH_ALLOCATOR_DEFAULT_BLOCK_SIZE (64ull * 1024 * 1024)
+
+enum class VKHMemoryUsage {
+    // device local, never mapped.
+    GPUOnly,
+    // host visible and coherent, persistently mapped. uploads and per-frame data.
+    CPUToGPU,
+    // host visible and preferably cached, persistently mapped. readbacks.
+    GPUToCPU,
+};
+
+struct VKHAllocation {
+    VkDeviceMemory memory { nullptr };
+    VkDeviceSize offset {};
+    VkDeviceSize size {};
+
+    // points at offset within the memory, null unless the memory is host visible.
+    void* mapped { nullptr };
+
+    uint32_t pool { UINT32_MAX };
+    uint32_t block {};
+    uint32_t chunk {};
+
+    bool is_dedicated() const { return pool == UINT32_MAX; }
+
+    operator bool() const { return memory != nullptr; }
+};
+
+struct VKHBuffer {
+    VkBuffer buffer { nullptr };
+    VkDeviceSize size {};
+    VKHAllocation allocation;
+
+    operator bool() const { return buffer != nullptr; }
+};
+
+struct VKHImage {
+    VkImage image { nullptr };
+    VKHAllocation allocation;
+
+    operator bool() const { return image != nullptr; }
+};
+
+struct VKHAllocatorInfo {
+    VkPhysicalDevice physical_device;
+    VkDevice device;
+
+    // capped to an eighth of the heap for small heaps, requests above half a block get their own memory.
+    VkDeviceSize block_size { VKH_ALLOCATOR_DEFAULT_BLOCK_SIZE };
+};
+
+struct VKHAllocatorStats {
+    uint32_t block_count;
+    uint32_t dedicated_allocation_count;
+    uint32_t allocation_count;
+    VkDeviceSize block_bytes;
+    VkDeviceSize dedicated_bytes;
+    VkDeviceSize used_bytes;
+    VkDeviceSize free_bytes;
+    VkDeviceSize largest_free_range;
+    uint32_t free_range_count;
+
+    // 0 while the free memory of every block is a single range, approaches 1 as it splinters.
+    double fragmentation;
+};
+
+// sub-allocates from large device memory blocks per memory type with a two-level segregated fit
+// (TLSF) allocator. buffers and optimal images never share a block, so bufferImageGranularity never applies.
+class VKHAllocator {
+    MAKE_NON_COPYABLE(VKHAllocator);
+    MAKE_NON_MOVABLE(VKHAllocator);
+
+public:
+    VKHAllocator() = default;
+
+    void init(VKHAllocatorInfo const& info);
+
+    // reports leaked allocations, then frees every block.
+    void deinit();
+
+    // linear is true for buffers and linear images, false for optimal images.
+    VKHAllocation allocate(VkMemoryRequirements const& requirements, VKHMemoryUsage usage, bool linear);
+
+    void free(VKHAllocation& allocation);
+
+    // uses a dedicated allocation when the driver prefers or requires one.
+    VKHBuffer create_buffer(VkDeviceSize size, VkBufferUsageFlags usage, VKHMemoryUsage memory_usage);
+
+    void destroy_buffer(VKHBuffer& buffer);
+
+    VKHImage create_image(VkImageCreateInfo const& create_info, VKHMemoryUsage memory_usage);
+
+    void destroy_image(VKHImage& image);
+
+    VKHAllocatorStats get_stats() const;
+
+private:
+    struct Chunk {
+        VkDeviceSize offset;
+        VkDeviceSize size;
+        uint32_t prev_phys;
+        uint32_t next_phys;
+        uint32_t prev_free;
+        uint32_t next_free;
+        bool free;
+    };
+
+    struct Block {
+        VkDeviceMemory memory { nullptr };
+        VkDeviceSize size {};
+        uint8_t* mapped { nullptr };
+        uint32_t allocation_count {};
+
+        std::vector<Chunk> chunks;
+        std::vector<uint32_t> unused_chunks;
+
+        uint64_t fl_bitmap {};
+        uint32_t sl_bitmaps[VKH_ALLOCATOR_FL_COUNT] {};
+        uint32_t free_heads[VKH_ALLOCATOR_FL_COUNT][VKH_ALLOCATOR_SL_COUNT];
+    };
+
+    struct Pool {
+        uint32_t memory_type;
+        bool linear;
+        VkDeviceSize block_size;
+        std::vector<std::unique_ptr<Block>> blocks;
+    };
+
+    VKHAllocation allocate_internal(
+        VkMemoryRequirements const& requirements,
+        VKHMemoryUsage usage,
+        bool linear,
+        bool dedicated,
+        VkBuffer dedicated_buffer,
+        VkImage dedicated_image);
+
+    uint32_t find_memory_type(uint32_t type_bits, VKHMemoryUsage usage) const;
+
+    uint32_t find_or_create_pool(uint32_t memory_type, bool linear);
+
+    uint32_t create_block(Pool& pool);
+
+    void destroy_block(Block& block);
+
+    bool allocate_from_block(Block& block, VkDeviceSize size, VkDeviceSize alignment, uint32_t& chunk);
+
+    void free_chunk(Block& block, uint32_t chunk);
+
+    uint32_t find_free_chunk(Block const& block, VkDeviceSize size) const;
+
+    void insert_free_chunk(Block& block, uint32_t chunk);
+
+    void remove_free_chunk(Block& block, uint32_t chunk);
+
+    uint32_t new_chunk(Block& block);
+
+private:
+    VkDevice m_device { nullptr };
+    VkPhysicalDeviceMemoryProperties m_memory_properties {};
+    VkDeviceSize m_block_size {};
+
+    mutable std::mutex m_mutex;
+    std::vector<Pool> m_pools;
+
+    uint32_t m_allocation_count {};
+    uint32_t m_dedicated_count {};
+    VkDeviceSize m_dedicated_bytes {};
+    VkDeviceSize m_used_bytes {};
+};
@@ -0,0 +1,239 @@
+#include <algorithm>
+
+#include "vulkan_bindless.h"
+#include "vulkan_helper.h"
+
+void VKHBindlessDescriptors::init(VKHBindlessInfo const& info)
+{
+    m_device = info.device;
+    m_defer_destroy = info.defer_destroy;
+
+    VkPhysicalDeviceVulkan12Properties vk12_properties {};
+    vk12_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+
+    VkPhysicalDeviceProperties2 properties {};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties.pNext = &vk12_properties;
+    vkGetPhysicalDeviceProperties2(info.physical_device, &properties);
+
+    m_bindings[VKH_BINDLESS_SAMPLED_IMAGE_BINDING].type = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+    m_bindings[VKH_BINDLESS_SAMPLED_IMAGE_BINDING].capacity = std::min({ info.sampled_image_count,
+        vk12_properties.maxPerStageDescriptorUpdateAfterBindSampledImages,
+        vk12_properties.maxDescriptorSetUpdateAfterBindSampledImages });
+
+    m_bindings[VKH_BINDLESS_SAMPLER_BINDING].type = VK_DESCRIPTOR_TYPE_SAMPLER;
+    m_bindings[VKH_BINDLESS_SAMPLER_BINDING].capacity = std::min({ info.sampler_count,
+        vk12_properties.maxPerStageDescriptorUpdateAfterBindSamplers,
+        vk12_properties.maxDescriptorSetUpdateAfterBindSamplers });
+
+    m_bindings[VKH_BINDLESS_STORAGE_BUFFER_BINDING].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    m_bindings[VKH_BINDLESS_STORAGE_BUFFER_BINDING].capacity = std::min({ info.storage_buffer_count,
+        vk12_properties.maxPerStageDescriptorUpdateAfterBindStorageBuffers,
+        vk12_properties.maxDescriptorSetUpdateAfterBindStorageBuffers });
+
+    m_bindings[VKH_BINDLESS_STORAGE_IMAGE_BINDING].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    m_bindings[VKH_BINDLESS_STORAGE_IMAGE_BINDING].capacity = std::min({ info.storage_image_count,
+        vk12_properties.maxPerStageDescriptorUpdateAfterBindStorageImages,
+        vk12_properties.maxDescriptorSetUpdateAfterBindStorageImages });
+
+    // partially bound so unused slots may stay unwritten, update unused while pending so new
+    // resources can be added while earlier frames that never touch them are still executing.
+    VkDescriptorBindingFlags binding_flags[VKH_BINDLESS_BINDING_COUNT];
+    VkDescriptorSetLayoutBinding bindings[VKH_BINDLESS_BINDING_COUNT] {};
+    VkDescriptorPoolSize pool_sizes[VKH_BINDLESS_BINDING_COUNT] {};
+    for (auto i { 0 }; i < VKH_BINDLESS_BINDING_COUNT; i++) {
+        binding_flags[i] = VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT
+            | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT
+            | VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT;
+
+        bindings[i].binding = i;
+        bindings[i].descriptorType = m_bindings[i].type;
+        bindings[i].descriptorCount = m_bindings[i].capacity;
+        bindings[i].stageFlags = VK_SHADER_STAGE_ALL;
+
+        pool_sizes[i].type = m_bindings[i].type;
+        pool_sizes[i].descriptorCount = m_bindings[i].capacity;
+    }
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfo binding_flags_create_info {};
+    binding_flags_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+    binding_flags_create_info.bindingCount = VKH_BINDLESS_BINDING_COUNT;
+    binding_flags_create_info.pBindingFlags = binding_flags;
+
+    VkDescriptorSetLayoutCreateInfo set_layout_create_info {};
+    set_layout_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    set_layout_create_info.pNext = &binding_flags_create_info;
+    set_layout_create_info.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+    set_layout_create_info.bindingCount = VKH_BINDLESS_BINDING_COUNT;
+    set_layout_create_info.pBindings = bindings;
+    VK_CHECK(vkCreateDescriptorSetLayout(m_device, &set_layout_create_info, nullptr, &m_set_layout));
+
+    VkDescriptorPoolCreateInfo pool_create_info {};
+    pool_create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    pool_create_info.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+    pool_create_info.maxSets = 1;
+    pool_create_info.poolSizeCount = VKH_BINDLESS_BINDING_COUNT;
+    pool_create_info.pPoolSizes = pool_sizes;
+    VK_CHECK(vkCreateDescriptorPool(m_device, &pool_create_info, nullptr, &m_pool));
+
+    VkDescriptorSetAllocateInfo set_allocate_info {};
+    set_allocate_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    set_allocate_info.descriptorPool = m_pool;
+    set_allocate_info.descriptorSetCount = 1;
+    set_allocate_info.pSetLayouts = &m_set_layout;
+    VK_CHECK(vkAllocateDescriptorSets(m_device, &set_allocate_info, &m_set));
+
+    // owned by the registry, so builders asking for the same set and range get this very layout.
+    auto push_constant_range = get_push_constant_range();
+    m_pipeline_layout = info.registry->get_pipeline_layout({ &m_set_layout, 1 }, { &push_constant_range, 1 });
+}
+
+void VKHBindlessDescriptors::deinit()
+{
+    vkDestroyDescriptorPool(m_device, m_pool, nullptr);
+    vkDestroyDescriptorSetLayout(m_device, m_set_layout, nullptr);
+
+    m_pool = nullptr;
+    m_set = nullptr;
+    m_set_layout = nullptr;
+    m_pipeline_layout = nullptr;
+
+    for (auto& binding : m_bindings) {
+        binding.next = 0;
+        binding.free_indices.clear();
+    }
+}
+
+uint32_t VKHBindlessDescriptors::add_sampled_image(VkImageView image_view, VkImageLayout layout)
+{
+    auto index = allocate_index(VKH_BINDLESS_SAMPLED_IMAGE_BINDING);
+    if (index == VKH_BINDLESS_INVALID_INDEX)
+        return index;
+
+    VkDescriptorImageInfo image_info {};
+    image_info.imageView = image_view;
+    image_info.imageLayout = layout;
+    write(VKH_BINDLESS_SAMPLED_IMAGE_BINDING, index, &image_info, nullptr);
+    return index;
+}
+
+uint32_t VKHBindlessDescriptors::add_sampler(VkSampler sampler)
+{
+    auto index = allocate_index(VKH_BINDLESS_SAMPLER_BINDING);
+    if (index == VKH_BINDLESS_INVALID_INDEX)
+        return index;
+
+    VkDescriptorImageInfo image_info {};
+    image_info.sampler = sampler;
+    write(VKH_BINDLESS_SAMPLER_BINDING, index, &image_info, nullptr);
+    return index;
+}
+
+uint32_t VKHBindlessDescriptors::add_storage_buffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+{
+    auto index = allocate_index(VKH_BINDLESS_STORAGE_BUFFER_BINDING);
+    if (index == VKH_BINDLESS_INVALID_INDEX)
+        return index;
+
+    VkDescriptorBufferInfo buffer_info {};
+    buffer_info.buffer = buffer;
+    buffer_info.offset = offset;
+    buffer_info.range = range;
+    write(VKH_BINDLESS_STORAGE_BUFFER_BINDING, index, nullptr, &buffer_info);
+    return index;
+}
+
+uint32_t VKHBindlessDescriptors::add_storage_image(VkImageView image_view)
+{
+    auto index = allocate_index(VKH_BINDLESS_STORAGE_IMAGE_BINDING);
+    if (index == VKH_BINDLESS_INVALID_INDEX)
+        return index;
+
+    VkDescriptorImageInfo image_info {};
+    image_info.imageView = image_view;
+    image_info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+    write(VKH_BINDLESS_STORAGE_IMAGE_BINDING, index, &image_info, nullptr);
+    return index;
+}
+
+void VKHBindlessDescriptors::remove_sampled_image(uint32_t index)
+{
+    release_index(VKH_BINDLESS_SAMPLED_IMAGE_BINDING, index);
+}
+
+void VKHBindlessDescriptors::remove_sampler(uint32_t index)
+{
+    release_index(VKH_BINDLESS_SAMPLER_BINDING, index);
+}
+
+void VKHBindlessDescriptors::remove_storage_buffer(uint32_t index)
+{
+    release_index(VKH_BINDLESS_STORAGE_BUFFER_BINDING, index);
+}
+
+void VKHBindlessDescriptors::remove_storage_image(uint32_t index)
+{
+    release_index(VKH_BINDLESS_STORAGE_IMAGE_BINDING, index);
+}
+
+void VKHBindlessDescriptors::bind(VkCommandBuffer cmd_buffer) const
+{
+    vkCmdBindDescriptorSets(cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline_layout, 0, 1, &m_set, 0, nullptr);
+    vkCmdBindDescriptorSets(cmd_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline_layout, 0, 1, &m_set, 0, nullptr);
+}
+
+void VKHBindlessDescriptors::push_constants(VkCommandBuffer cmd_buffer, void const* data, uint32_t size, uint32_t offset) const
+{
+    vkCmdPushConstants(cmd_buffer, m_pipeline_layout, VK_SHADER_STAGE_ALL, offset, size, data);
+}
+
+uint32_t VKHBindlessDescriptors::allocate_index(uint32_t binding)
+{
+    std::lock_guard lock(m_mutex);
+
+    auto& state = m_bindings[binding];
+    if (!state.free_indices.empty()) {
+        auto index = state.free_indices.back();
+        state.free_indices.pop_back();
+        return index;
+    }
+
+    if (state.next == state.capacity) {
+        fmt::println(stderr, "VKHBindlessDescriptors::allocate_index(): binding {} is full ({} descriptors)!", binding, state.capacity);
+        return VKH_BINDLESS_INVALID_INDEX;
+    }
+
+    return state.next++;
+}
+
+void VKHBindlessDescriptors::release_index(uint32_t binding, uint32_t index)
+{
+    if (index == VKH_BINDLESS_INVALID_INDEX)
+        return;
+
+    m_defer_destroy([this, binding, index] {
+        std::lock_guard lock(m_mutex);
+        m_bindings[binding].free_indices.push_back(index);
+    });
+}
+
+void VKHBindlessDescriptors::write(
+    uint32_t binding,
+    uint32_t index,
+    VkDescriptorImageInfo const* image_info,
+    VkDescriptorBufferInfo const* buffer_info)
+{
+    VkWriteDescriptorSet write {};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = m_set;
+    write.dstBinding = binding;
+    write.dstArrayElement = index;
+    write.descriptorCount = 1;
+    write.descriptorType = m_bindings[binding].type;
+    write.pImageInfo = image_info;
+    write.pBufferInfo = buffer_info;
+
+    // the set itself needs external synchronization even though its descriptors are update-after-bind.
+    std::lock_guard lock(m_mutex);
+    vkUpdateDescriptorSets(m_device, 1, &write, 0, nullptr);
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include "helper.h"
+#include "vulkan.h"
+
+#define VKH_BINDLESS_SAMPLED_IMAGE_BINDING 0
+#define VKH_BINDLESS_SAMPLER_BINDING 1
+#define VKH_BINDLESS_STORAGE_BUFFER_BINDING 2
+#define VKH_BINDLESS_STORAGE_IMAGE_BINDING 3
+#define VKH_BINDLESS_BINDING_COUNT 4
+
+// the minimum maxPushConstantsSize every implementation guarantees.
+#define VKH_BINDLESS_PUSH_CONSTANT_SIZE 128
+
+#define VKH_BINDLESS_INVALID_INDEX UINT32_MAX
+
+class VKHPipelineRegistry;
+
+struct VKHBindlessInfo {
+    VkPhysicalDevice physical_device;
+    VkDevice device;
+    VKHPipelineRegistry* registry;
+
+    // releases an index once every frame that may still read it has completed.
+    std::function<void(std::function<void()>)> defer_destroy;
+
+    // clamped to the device's update-after-bind limits.
+    uint32_t sampled_image_count { 16384 };
+    uint32_t sampler_count { 256 };
+    uint32_t storage_buffer_count { 16384 };
+    uint32_t storage_image_count { 1024 };
+};
+
+// one global descriptor set of update-after-bind arrays, bound once per command buffer. shaders
+// address resources by the indices handed out here, passed through push constants or buffers.
+class VKHBindlessDescriptors {
+    MAKE_NON_COPYABLE(VKHBindlessDescriptors);
+    MAKE_NON_MOVABLE(VKHBindlessDescriptors);
+
+public:
+    VKHBindlessDescriptors() = default;
+
+    void init(VKHBindlessInfo const& info);
+
+    // the device must be idle.
+    void deinit();
+
+    uint32_t add_sampled_image(VkImageView image_view, VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+    uint32_t add_sampler(VkSampler sampler);
+
+    uint32_t add_storage_buffer(VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+
+    uint32_t add_storage_image(VkImageView image_view);
+
+    // the descriptor is left in place, the index is only handed out again once in-flight frames are done with it.
+    void remove_sampled_image(uint32_t index);
+
+    void remove_sampler(uint32_t index);
+
+    void remove_storage_buffer(uint32_t index);
+
+    void remove_storage_image(uint32_t index);
+
+    // binds the set for graphics and compute, every pipeline using get_pipeline_layout() is compatible with it.
+    void bind(VkCommandBuffer cmd_buffer) const;
+
+    void push_constants(VkCommandBuffer cmd_buffer, void const* data, uint32_t size, uint32_t offset = 0) const;
+
+    VkDescriptorSetLayout get_set_layout() const { return m_set_layout; }
+
+    // set 0 is the bindless set, followed by VKH_BINDLESS_PUSH_CONSTANT_SIZE bytes of push constants for all stages.
+    VkPipelineLayout get_pipeline_layout() const { return m_pipeline_layout; }
+
+    VkPushConstantRange get_push_constant_range() const { return { VK_SHADER_STAGE_ALL, 0, VKH_BINDLESS_PUSH_CONSTANT_SIZE }; }
+
+    uint32_t get_capacity(uint32_t binding) const { return m_bindings[binding].capacity; }
+
+private:
+    struct Binding {
+        VkDescriptorType type;
+        uint32_t capacity;
+        uint32_t next;
+        std::vector<uint32_t> free_indices;
+    };
+
+    uint32_t allocate_index(uint32_t binding);
+
+    void release_index(uint32_t binding, uint32_t index);
+
+    void write(uint32_t binding, uint32_t index, VkDescriptorImageInfo const* image_info, VkDescriptorBufferInfo const* buffer_info);
+
+private:
+    VkDevice m_device { nullptr };
+    std::function<void(std::function<void()>)> m_defer_destroy;
+
+    VkDescriptorSetLayout m_set_layout { nullptr };
+    VkDescriptorPool m_pool { nullptr };
+    VkDescriptorSet m_set { nullptr };
+    VkPipelineLayout m_pipeline_layout { nullptr };
+
+    std::mutex m_mutex;
+    Binding m_bindings[VKH_BINDLESS_BINDING_COUNT] {};
+};
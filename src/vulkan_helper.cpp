@@ -1,5 +1,83 @@
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#include "vulkan_bindless.h"
 #include "vulkan_helper.h"
 
+namespace {
+
+constexpr uint32_t PIPELINE_CACHE_MAGIC = 0x43504B56; // "VKPC"
+constexpr uint32_t PIPELINE_CACHE_VERSION = 1;
+
+struct PipelineCacheFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vendor_id;
+    uint32_t device_id;
+    uint32_t driver_version;
+    uint8_t pipeline_cache_uuid[VK_UUID_SIZE];
+    uint8_t driver_uuid[VK_UUID_SIZE];
+    uint64_t data_size;
+    uint64_t data_hash;
+};
+
+uint64_t hash_bytes(uint8_t const* data, size_t size)
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t i { 0 }; i < size; i++) {
+        hash ^= data[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+template<typename T>
+requires std::is_trivially_copyable_v<T>
+void append_key(std::string& key, T const& value)
+{
+    key.append(reinterpret_cast<char const*>(&value), sizeof(T));
+}
+
+void append_key(std::string& key, char const* value)
+{
+    auto length = value ? std::strlen(value) : 0;
+    append_key(key, static_cast<uint32_t>(length));
+    key.append(value ? value : "", length);
+}
+
+}
+
+VKHShaderModule vkh_create_shader_module(VkDevice device, std::string const& path)
+{
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file) {
+        fmt::println(stderr, "vkh_create_shader_module(): failed to open '{}'!", path);
+        return {};
+    }
+
+    auto size = static_cast<size_t>(file.tellg());
+    if (size == 0 || size % sizeof(uint32_t) != 0) {
+        fmt::println(stderr, "vkh_create_shader_module(): '{}' is not SPIR-V!", path);
+        return {};
+    }
+
+    std::vector<uint32_t> code(size / sizeof(uint32_t));
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(code.data()), size);
+
+    VkShaderModuleCreateInfo create_info {};
+    create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    create_info.codeSize = size;
+    create_info.pCode = code.data();
+
+    VKHShaderModule module;
+    VK_CHECK(vkCreateShaderModule(device, &create_info, nullptr, &module.module));
+    module.code_hash = hash_bytes(reinterpret_cast<uint8_t const*>(code.data()), size);
+    return module;
+}
+
 VKHVertexLayoutBuilder& VKHVertexLayoutBuilder::push_binding(
     uint32_t binding,
     uint32_t stride,
@@ -35,8 +113,288 @@ VKHVertexLayout VKHVertexLayoutBuilder::build()
     return { std::move(m_binding_descs), std::move(m_attribute_descs) };
 }
 
-VKHGraphicsPipelineBuilder::VKHGraphicsPipelineBuilder(VkDevice device)
-    : m_device(device)
+void VKHPipelineCache::init(VKHPipelineCacheInfo const& info)
+{
+    m_device = info.device;
+    m_path = info.path;
+
+    VkPhysicalDeviceIDProperties id_properties {};
+    id_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+
+    VkPhysicalDeviceProperties2 properties {};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties.pNext = &id_properties;
+    vkGetPhysicalDeviceProperties2(info.physical_device, &properties);
+
+    m_vendor_id = properties.properties.vendorID;
+    m_device_id = properties.properties.deviceID;
+    m_driver_version = properties.properties.driverVersion;
+    std::memcpy(m_pipeline_cache_uuid, properties.properties.pipelineCacheUUID, VK_UUID_SIZE);
+    std::memcpy(m_driver_uuid, id_properties.driverUUID, VK_UUID_SIZE);
+
+    auto start = std::chrono::steady_clock::now();
+    auto data = load();
+    auto load_time = std::chrono::steady_clock::now() - start;
+
+    VkPipelineCacheCreateInfo create_info {};
+    create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    create_info.initialDataSize = data.size();
+    create_info.pInitialData = data.empty() ? nullptr : data.data();
+
+    if (vkCreatePipelineCache(m_device, &create_info, nullptr, &m_cache) != VK_SUCCESS) {
+        // the driver rejected the blob despite a matching header, start cold instead.
+        create_info.initialDataSize = 0;
+        create_info.pInitialData = nullptr;
+        data.clear();
+        VK_CHECK(vkCreatePipelineCache(m_device, &create_info, nullptr, &m_cache));
+    }
+
+    m_warm = !data.empty();
+
+    if (m_warm) {
+        fmt::println("pipeline cache: warm start, loaded {} bytes from '{}' in {:.3f} ms",
+            data.size(), m_path, std::chrono::duration<double, std::milli>(load_time).count());
+    } else {
+        fmt::println("pipeline cache: cold start");
+    }
+}
+
+void VKHPipelineCache::deinit()
+{
+    if (!m_cache)
+        return;
+
+    auto compile_count = m_compile_count.load();
+    auto compile_time_ms = m_compile_time_ns.load() / 1e6;
+    fmt::println("pipeline cache: {} start, {} pipelines compiled in {:.3f} ms ({:.3f} ms avg)",
+        m_warm ? "warm" : "cold", compile_count, compile_time_ms,
+        compile_count ? compile_time_ms / compile_count : 0.0);
+
+    save();
+
+    vkDestroyPipelineCache(m_device, m_cache, nullptr);
+    m_cache = nullptr;
+}
+
+void VKHPipelineCache::merge(std::span<VkPipelineCache const> caches)
+{
+    if (caches.empty())
+        return;
+
+    VK_CHECK(vkMergePipelineCaches(m_device, m_cache, caches.size(), caches.data()));
+}
+
+void VKHPipelineCache::record_compile_time(std::chrono::nanoseconds duration)
+{
+    m_compile_count.fetch_add(1, std::memory_order_relaxed);
+    m_compile_time_ns.fetch_add(duration.count(), std::memory_order_relaxed);
+}
+
+std::vector<uint8_t> VKHPipelineCache::load() const
+{
+    if (m_path.empty())
+        return {};
+
+    std::ifstream file(m_path, std::ios::binary);
+    if (!file)
+        return {};
+
+    PipelineCacheFileHeader header {};
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)))
+        return {};
+
+    if (header.magic != PIPELINE_CACHE_MAGIC
+        || header.version != PIPELINE_CACHE_VERSION
+        || header.vendor_id != m_vendor_id
+        || header.device_id != m_device_id
+        || header.driver_version != m_driver_version
+        || std::memcmp(header.pipeline_cache_uuid, m_pipeline_cache_uuid, VK_UUID_SIZE) != 0
+        || std::memcmp(header.driver_uuid, m_driver_uuid, VK_UUID_SIZE) != 0) {
+        fmt::println(stderr, "pipeline cache: '{}' was written by a different device or driver, ignoring it", m_path);
+        return {};
+    }
+
+    // the size is checked against the file before allocating, a corrupt one must not throw at startup.
+    auto data_start = file.tellg();
+    file.seekg(0, std::ios::end);
+    auto remaining = static_cast<uint64_t>(file.tellg() - data_start);
+    file.seekg(data_start);
+    if (header.data_size != remaining) {
+        fmt::println(stderr, "pipeline cache: '{}' is truncated or corrupt, ignoring it", m_path);
+        return {};
+    }
+
+    std::vector<uint8_t> data(header.data_size);
+    if (!file.read(reinterpret_cast<char*>(data.data()), data.size())
+        || hash_bytes(data.data(), data.size()) != header.data_hash) {
+        fmt::println(stderr, "pipeline cache: '{}' is truncated or corrupt, ignoring it", m_path);
+        return {};
+    }
+
+    return data;
+}
+
+void VKHPipelineCache::save() const
+{
+    if (m_path.empty())
+        return;
+
+    size_t data_size {};
+    VK_CHECK(vkGetPipelineCacheData(m_device, m_cache, &data_size, nullptr));
+    std::vector<uint8_t> data(data_size);
+    VK_CHECK(vkGetPipelineCacheData(m_device, m_cache, &data_size, data.data()));
+    data.resize(data_size);
+
+    PipelineCacheFileHeader header {};
+    header.magic = PIPELINE_CACHE_MAGIC;
+    header.version = PIPELINE_CACHE_VERSION;
+    header.vendor_id = m_vendor_id;
+    header.device_id = m_device_id;
+    header.driver_version = m_driver_version;
+    std::memcpy(header.pipeline_cache_uuid, m_pipeline_cache_uuid, VK_UUID_SIZE);
+    std::memcpy(header.driver_uuid, m_driver_uuid, VK_UUID_SIZE);
+    header.data_size = data.size();
+    header.data_hash = hash_bytes(data.data(), data.size());
+
+    auto temp_path = m_path + ".tmp";
+    {
+        std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+        if (!file
+            || !file.write(reinterpret_cast<char const*>(&header), sizeof(header))
+            || !file.write(reinterpret_cast<char const*>(data.data()), data.size())) {
+            fmt::println(stderr, "pipeline cache: failed to write '{}'", temp_path);
+            return;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temp_path, m_path, error);
+    if (error)
+        fmt::println(stderr, "pipeline cache: failed to replace '{}': {}", m_path, error.message());
+}
+
+VKHPipeline VKHPipelineFuture::wait() const
+{
+    if (!m_state)
+        return {};
+
+    std::unique_lock lock(m_state->mutex);
+    m_state->condition.wait(lock, [this] { return m_state->ready.load(std::memory_order_acquire); });
+    return m_state->pipeline;
+}
+
+void VKHPipelineFuture::fulfill(VKHPipeline pipeline) const
+{
+    {
+        std::lock_guard lock(m_state->mutex);
+        m_state->pipeline = pipeline;
+        m_state->ready.store(true, std::memory_order_release);
+    }
+    m_state->condition.notify_all();
+}
+
+void VKHPipelineRegistry::init(VkDevice device, VKHPipelineCache* cache, JobSubsystem* jobs)
+{
+    m_device = device;
+    m_cache = cache;
+    m_jobs = jobs;
+}
+
+void VKHPipelineRegistry::deinit()
+{
+    wait_idle();
+
+    std::lock_guard lock(m_mutex);
+
+    for (auto const& [key, future] : m_pipelines)
+        vkDestroyPipeline(m_device, future.get().pipeline, nullptr);
+
+    for (auto const& [key, layout] : m_layouts)
+        vkDestroyPipelineLayout(m_device, layout, nullptr);
+
+    m_pipelines.clear();
+    m_layouts.clear();
+}
+
+void VKHPipelineRegistry::wait_idle()
+{
+    std::vector<VKHPipelineFuture> futures;
+    {
+        std::lock_guard lock(m_mutex);
+        futures.reserve(m_pipelines.size());
+        for (auto const& [key, future] : m_pipelines)
+            futures.push_back(future);
+    }
+
+    for (auto const& future : futures)
+        future.wait();
+}
+
+size_t VKHPipelineRegistry::get_pipeline_count() const
+{
+    std::lock_guard lock(m_mutex);
+    return m_pipelines.size();
+}
+
+size_t VKHPipelineRegistry::get_layout_count() const
+{
+    std::lock_guard lock(m_mutex);
+    return m_layouts.size();
+}
+
+VkPipelineLayout VKHPipelineRegistry::get_pipeline_layout(
+    std::span<VkDescriptorSetLayout const> set_layouts,
+    std::span<VkPushConstantRange const> push_constant_ranges)
+{
+    std::string key;
+    append_key(key, static_cast<uint32_t>(set_layouts.size()));
+    for (auto set_layout : set_layouts)
+        append_key(key, set_layout);
+
+    append_key(key, static_cast<uint32_t>(push_constant_ranges.size()));
+    for (auto const& range : push_constant_ranges) {
+        append_key(key, range.stageFlags);
+        append_key(key, range.offset);
+        append_key(key, range.size);
+    }
+
+    std::lock_guard lock(m_mutex);
+
+    if (auto it = m_layouts.find(key); it != m_layouts.end())
+        return it->second;
+
+    VkPipelineLayoutCreateInfo create_info {};
+    create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    create_info.setLayoutCount = set_layouts.size();
+    create_info.pSetLayouts = set_layouts.data();
+    create_info.pushConstantRangeCount = push_constant_ranges.size();
+    create_info.pPushConstantRanges = push_constant_ranges.data();
+
+    VkPipelineLayout layout;
+    VK_CHECK(vkCreatePipelineLayout(m_device, &create_info, nullptr, &layout));
+
+    m_layouts.emplace(std::move(key), layout);
+    return layout;
+}
+
+VKHPipelineFuture VKHPipelineRegistry::find_or_reserve(std::string key, bool& created)
+{
+    std::lock_guard lock(m_mutex);
+
+    if (auto it = m_pipelines.find(key); it != m_pipelines.end()) {
+        m_hit_count.fetch_add(1, std::memory_order_relaxed);
+        created = false;
+        return it->second;
+    }
+
+    VKHPipelineFuture future(std::make_shared<VKHPipelineFuture::State>());
+    m_pipelines.emplace(std::move(key), future);
+    created = true;
+    return future;
+}
+
+VKHGraphicsPipelineBuilder::VKHGraphicsPipelineBuilder(VKHPipelineRegistry* registry)
+    : m_registry(registry)
 {
 }
 
@@ -61,25 +419,28 @@ VKHGraphicsPipelineBuilder& VKHGraphicsPipelineBuilder::set_rendering_format(
 }
 
 VKHGraphicsPipelineBuilder& VKHGraphicsPipelineBuilder::set_vertex_and_fragment(
-    VkShaderModule vertex,
+    VKHShaderModule const& vertex,
     char const* vertex_entry_point,
-    VkShaderModule fragment,
+    VKHShaderModule const& fragment,
     char const* fragment_entry_point)
 {
     m_shader_stage_done = true;
 
     m_stages[VKH_SHADER_STAGE_VERTEX].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     m_stages[VKH_SHADER_STAGE_VERTEX].stage = VK_SHADER_STAGE_VERTEX_BIT;
-    m_stages[VKH_SHADER_STAGE_VERTEX].module = vertex;
+    m_stages[VKH_SHADER_STAGE_VERTEX].module = vertex.module;
     m_stages[VKH_SHADER_STAGE_VERTEX].pName = vertex_entry_point;
     m_stages[VKH_SHADER_STAGE_VERTEX].flags = 0;
 
     m_stages[VKH_SHADER_STAGE_FRAGMENT].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     m_stages[VKH_SHADER_STAGE_FRAGMENT].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-    m_stages[VKH_SHADER_STAGE_FRAGMENT].module = fragment;
+    m_stages[VKH_SHADER_STAGE_FRAGMENT].module = fragment.module;
     m_stages[VKH_SHADER_STAGE_FRAGMENT].pName = fragment_entry_point;
     m_stages[VKH_SHADER_STAGE_FRAGMENT].flags = 0;
 
+    m_stage_code_hashes[VKH_SHADER_STAGE_VERTEX] = vertex.code_hash;
+    m_stage_code_hashes[VKH_SHADER_STAGE_FRAGMENT] = fragment.code_hash;
+
     return *this;
 }
 
@@ -145,26 +506,86 @@ VKHGraphicsPipelineBuilder& VKHGraphicsPipelineBuilder::enable_color_blending()
     return *this;
 }
 
-VkPipeline VKHGraphicsPipelineBuilder::build()
+VKHGraphicsPipelineBuilder& VKHGraphicsPipelineBuilder::add_descriptor_set_layout(VkDescriptorSetLayout set_layout)
+{
+    m_set_layouts.push_back(set_layout);
+    return *this;
+}
+
+VKHGraphicsPipelineBuilder& VKHGraphicsPipelineBuilder::add_push_constant_range(VkShaderStageFlags stages, uint32_t offset, uint32_t size)
+{
+    m_push_constant_ranges.push_back({ stages, offset, size });
+    return *this;
+}
+
+VKHGraphicsPipelineBuilder& VKHGraphicsPipelineBuilder::use_bindless(VKHBindlessDescriptors const& bindless)
+{
+    if (!m_set_layouts.empty())
+        fmt::println(stderr, "VKHGraphicsPipelineBuilder::use_bindless(): the bindless set has to be set 0!");
+
+    m_set_layouts.insert(m_set_layouts.begin(), bindless.get_set_layout());
+    m_push_constant_ranges.push_back(bindless.get_push_constant_range());
+    return *this;
+}
+
+VKHPipeline VKHGraphicsPipelineBuilder::build()
+{
+    if (!prepare())
+        return {};
+
+    bool created { false };
+    auto future = m_registry->find_or_reserve(make_key(), created);
+    if (!created)
+        return future.wait();
+
+    auto pipeline = compile();
+    future.fulfill(pipeline);
+    return pipeline;
+}
+
+VKHPipelineFuture VKHGraphicsPipelineBuilder::build_async()
+{
+    if (!prepare())
+        return {};
+
+    bool created { false };
+    auto future = m_registry->find_or_reserve(make_key(), created);
+    if (!created)
+        return future;
+
+    if (!m_registry->m_jobs) {
+        future.fulfill(compile());
+        return future;
+    }
+
+    auto builder = std::make_shared<VKHGraphicsPipelineBuilder>(*this);
+    m_registry->m_jobs->submit([builder, future] {
+        future.fulfill(builder->compile());
+    });
+
+    return future;
+}
+
+bool VKHGraphicsPipelineBuilder::prepare()
 {
     if (!m_pipeline_rendering_info_done) {
         fmt::println(stderr, "VKHGraphicsPipelineBuilder::build(): rendering format is not specified!");
-        return nullptr;
+        return false;
     }
 
     if (!m_shader_stage_done) {
         fmt::println(stderr, "VKHGraphicsPipelineBuilder::build(): shader stage is not specified!");
-        return nullptr;
+        return false;
     }
 
     if (!m_vertex_layout_done) {
         fmt::println(stderr, "VKHGraphicsPipelineBuilder::build(): vertex layout is not specified!");
-        return nullptr;
+        return false;
     }
 
     if (!m_input_assembly_done) {
         fmt::println(stderr, "VKHGraphicsPipelineBuilder::build(): input assembly is not specified!");
-        return nullptr;
+        return false;
     }
 
     set_standard_viewport();
@@ -172,7 +593,91 @@ VkPipeline VKHGraphicsPipelineBuilder::build()
     set_standard_multisample();
     set_standard_depth_testing();
     set_standard_color_blending();
-    set_standard_pipeline_layout();
+
+    return true;
+}
+
+void VKHGraphicsPipelineBuilder::fixup_pointers()
+{
+    // the create infos point into the builder itself, a copied builder has to re-point them.
+    m_pipeline_rendering_info.pColorAttachmentFormats = &m_color_format;
+
+    m_vertex_input_state.vertexAttributeDescriptionCount = m_vertex_layout.attribute_descs.size();
+    m_vertex_input_state.pVertexAttributeDescriptions = m_vertex_layout.attribute_descs.data();
+    m_vertex_input_state.vertexBindingDescriptionCount = m_vertex_layout.binding_descs.size();
+    m_vertex_input_state.pVertexBindingDescriptions = m_vertex_layout.binding_descs.data();
+
+    m_color_blend_state.pAttachments = &m_color_attachment_state;
+
+    m_dynamic_state.dynamicStateCount = m_dynamic_states.size();
+    m_dynamic_state.pDynamicStates = m_dynamic_states.data();
+}
+
+std::string VKHGraphicsPipelineBuilder::make_key() const
+{
+    std::string key;
+
+    append_key(key, m_color_format);
+    append_key(key, m_depth_format);
+    append_key(key, m_stencil_format);
+
+    for (auto i { 0u }; i < VKH_SHADER_STAGE_COUNT; i++) {
+        append_key(key, m_stages[i].stage);
+        append_key(key, m_stage_code_hashes[i]);
+        append_key(key, m_stages[i].pName);
+    }
+
+    append_key(key, static_cast<uint32_t>(m_vertex_layout.binding_descs.size()));
+    for (auto const& binding : m_vertex_layout.binding_descs) {
+        append_key(key, binding.binding);
+        append_key(key, binding.stride);
+        append_key(key, binding.inputRate);
+    }
+
+    append_key(key, static_cast<uint32_t>(m_vertex_layout.attribute_descs.size()));
+    for (auto const& attribute : m_vertex_layout.attribute_descs) {
+        append_key(key, attribute.binding);
+        append_key(key, attribute.location);
+        append_key(key, attribute.offset);
+        append_key(key, attribute.format);
+    }
+
+    append_key(key, m_input_assembly_state.topology);
+    append_key(key, m_input_assembly_state.primitiveRestartEnable);
+
+    append_key(key, m_rasterization_state.polygonMode);
+    append_key(key, m_rasterization_state.cullMode);
+    append_key(key, m_rasterization_state.frontFace);
+
+    append_key(key, m_use_depth);
+    append_key(key, m_use_stencil);
+    append_key(key, m_use_color_blending);
+
+    auto dynamic_states = m_dynamic_states;
+    std::sort(dynamic_states.begin(), dynamic_states.end());
+    append_key(key, static_cast<uint32_t>(dynamic_states.size()));
+    for (auto state : dynamic_states)
+        append_key(key, state);
+
+    append_key(key, static_cast<uint32_t>(m_set_layouts.size()));
+    for (auto set_layout : m_set_layouts)
+        append_key(key, set_layout);
+
+    append_key(key, static_cast<uint32_t>(m_push_constant_ranges.size()));
+    for (auto const& range : m_push_constant_ranges) {
+        append_key(key, range.stageFlags);
+        append_key(key, range.offset);
+        append_key(key, range.size);
+    }
+
+    return key;
+}
+
+VKHPipeline VKHGraphicsPipelineBuilder::compile()
+{
+    fixup_pointers();
+
+    auto layout = m_registry->get_pipeline_layout(m_set_layouts, m_push_constant_ranges);
 
     VkGraphicsPipelineCreateInfo create_info {};
     create_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
@@ -187,11 +692,18 @@ VkPipeline VKHGraphicsPipelineBuilder::build()
     create_info.pDepthStencilState = &m_depthstencil_state;
     create_info.pColorBlendState = &m_color_blend_state;
     create_info.pDynamicState = &m_dynamic_state;
-    create_info.layout = m_pipeline_layout;
+    create_info.layout = layout;
+
+    auto cache = m_registry->get_cache();
+    auto start = std::chrono::steady_clock::now();
 
     VkPipeline pipeline;
-    VK_CHECK(vkCreateGraphicsPipelines(m_device, VK_NULL_HANDLE, 1, &create_info, nullptr, &pipeline));
-    return pipeline;
+    VK_CHECK(vkCreateGraphicsPipelines(m_registry->get_device(), cache ? cache->get_handle() : VK_NULL_HANDLE, 1, &create_info, nullptr, &pipeline));
+
+    if (cache)
+        cache->record_compile_time(std::chrono::steady_clock::now() - start);
+
+    return { pipeline, layout };
 }
 
 void VKHGraphicsPipelineBuilder::set_standard_viewport()
@@ -267,12 +779,130 @@ void VKHGraphicsPipelineBuilder::set_standard_color_blending()
     m_color_blend_state.pAttachments = &m_color_attachment_state;
 }
 
-void VKHGraphicsPipelineBuilder::set_standard_pipeline_layout()
+VKHComputePipelineBuilder::VKHComputePipelineBuilder(VKHPipelineRegistry* registry)
+    : m_registry(registry)
 {
-    VkPipelineLayoutCreateInfo create_info {};
-    create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    create_info.setLayoutCount = 0;
-    create_info.pushConstantRangeCount = 0;
+}
+
+VKHComputePipelineBuilder& VKHComputePipelineBuilder::set_shader(VKHShaderModule const& module, char const* entry_point)
+{
+    m_module = module;
+    m_entry_point = entry_point;
+    return *this;
+}
+
+VKHComputePipelineBuilder& VKHComputePipelineBuilder::add_descriptor_set_layout(VkDescriptorSetLayout set_layout)
+{
+    m_set_layouts.push_back(set_layout);
+    return *this;
+}
+
+VKHComputePipelineBuilder& VKHComputePipelineBuilder::add_push_constant_range(VkShaderStageFlags stages, uint32_t offset, uint32_t size)
+{
+    m_push_constant_ranges.push_back({ stages, offset, size });
+    return *this;
+}
+
+VKHComputePipelineBuilder& VKHComputePipelineBuilder::use_bindless(VKHBindlessDescriptors const& bindless)
+{
+    if (!m_set_layouts.empty())
+        fmt::println(stderr, "VKHComputePipelineBuilder::use_bindless(): the bindless set has to be set 0!");
+
+    m_set_layouts.insert(m_set_layouts.begin(), bindless.get_set_layout());
+    m_push_constant_ranges.push_back(bindless.get_push_constant_range());
+    return *this;
+}
+
+VKHPipeline VKHComputePipelineBuilder::build()
+{
+    if (!prepare())
+        return {};
+
+    bool created { false };
+    auto future = m_registry->find_or_reserve(make_key(), created);
+    if (!created)
+        return future.wait();
+
+    auto pipeline = compile();
+    future.fulfill(pipeline);
+    return pipeline;
+}
+
+VKHPipelineFuture VKHComputePipelineBuilder::build_async()
+{
+    if (!prepare())
+        return {};
+
+    bool created { false };
+    auto future = m_registry->find_or_reserve(make_key(), created);
+    if (!created)
+        return future;
+
+    if (!m_registry->m_jobs) {
+        future.fulfill(compile());
+        return future;
+    }
+
+    m_registry->m_jobs->submit([builder = *this, future] {
+        future.fulfill(builder.compile());
+    });
+
+    return future;
+}
+
+bool VKHComputePipelineBuilder::prepare() const
+{
+    if (!m_module) {
+        fmt::println(stderr, "VKHComputePipelineBuilder::build(): shader is not specified!");
+        return false;
+    }
+
+    return true;
+}
+
+VKHPipeline VKHComputePipelineBuilder::compile() const
+{
+    auto layout = m_registry->get_pipeline_layout(m_set_layouts, m_push_constant_ranges);
+
+    VkComputePipelineCreateInfo create_info {};
+    create_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    create_info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    create_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    create_info.stage.module = m_module.module;
+    create_info.stage.pName = m_entry_point;
+    create_info.layout = layout;
+
+    auto cache = m_registry->get_cache();
+    auto start = std::chrono::steady_clock::now();
+
+    VkPipeline pipeline;
+    VK_CHECK(vkCreateComputePipelines(m_registry->get_device(), cache ? cache->get_handle() : VK_NULL_HANDLE, 1, &create_info, nullptr, &pipeline));
+
+    if (cache)
+        cache->record_compile_time(std::chrono::steady_clock::now() - start);
+
+    return { pipeline, layout };
+}
+
+std::string VKHComputePipelineBuilder::make_key() const
+{
+    std::string key;
+
+    // keeps compute keys apart from graphics keys, which start with a color format.
+    append_key(key, VK_PIPELINE_BIND_POINT_COMPUTE);
+    append_key(key, m_module.code_hash);
+    append_key(key, m_entry_point);
+
+    append_key(key, static_cast<uint32_t>(m_set_layouts.size()));
+    for (auto set_layout : m_set_layouts)
+        append_key(key, set_layout);
+
+    append_key(key, static_cast<uint32_t>(m_push_constant_ranges.size()));
+    for (auto const& range : m_push_constant_ranges) {
+        append_key(key, range.stageFlags);
+        append_key(key, range.offset);
+        append_key(key, range.size);
+    }
 
-    VK_CHECK(vkCreatePipelineLayout(m_device, &create_info, nullptr, &m_pipeline_layout));
+    return key;
 }
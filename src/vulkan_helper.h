@@ -2,10 +2,20 @@
 
 #include <fmt/base.h>
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
+#include "helper.h"
+#include "job_subsystem.h"
 #include "vulkan.h"
 
 #define VKH_SHADER_STAGE_VERTEX 0
@@ -48,9 +58,164 @@ private:
     std::vector<VkVertexInputAttributeDescription> m_attribute_descs;
 };
 
+struct VKHPipelineCacheInfo {
+    VkPhysicalDevice physical_device;
+    VkDevice device;
+    std::string path;
+};
+
+class VKHPipelineCache {
+    MAKE_NON_COPYABLE(VKHPipelineCache);
+    MAKE_NON_MOVABLE(VKHPipelineCache);
+
+public:
+    VKHPipelineCache() = default;
+
+    // loads the cache blob from disk when it was written by the same device and driver,
+    // otherwise starts cold. an empty path disables persistence.
+    void init(VKHPipelineCacheInfo const& info);
+
+    // writes the cache back through a temporary file and a rename, then destroys it.
+    void deinit();
+
+    void merge(std::span<VkPipelineCache const> caches);
+
+    void record_compile_time(std::chrono::nanoseconds duration);
+
+    VkPipelineCache get_handle() const { return m_cache; }
+
+    bool is_warm() const { return m_warm; }
+
+private:
+    std::vector<uint8_t> load() const;
+
+    void save() const;
+
+private:
+    VkDevice m_device { nullptr };
+    VkPipelineCache m_cache { nullptr };
+    std::string m_path;
+
+    uint32_t m_vendor_id {};
+    uint32_t m_device_id {};
+    uint32_t m_driver_version {};
+    uint8_t m_pipeline_cache_uuid[VK_UUID_SIZE] {};
+    uint8_t m_driver_uuid[VK_UUID_SIZE] {};
+
+    bool m_warm { false };
+    std::atomic<uint64_t> m_compile_count { 0 };
+    std::atomic<uint64_t> m_compile_time_ns { 0 };
+};
+
+class VKHBindlessDescriptors;
+
+// pipelines are keyed on code_hash, the driver may hand out a destroyed module's handle again.
+struct VKHShaderModule {
+    VkShaderModule module { nullptr };
+    uint64_t code_hash {};
+
+    operator bool() const { return module != nullptr; }
+};
+
+// reads a SPIR-V file, returns an empty module when it is missing or malformed.
+VKHShaderModule vkh_create_shader_module(VkDevice device, std::string const& path);
+
+struct VKHPipeline {
+    VkPipeline pipeline { nullptr };
+    VkPipelineLayout layout { nullptr };
+
+    operator bool() const { return pipeline != nullptr; }
+};
+
+class VKHPipelineFuture {
+public:
+    VKHPipelineFuture() = default;
+
+    bool is_valid() const { return m_state != nullptr; }
+
+    bool is_ready() const { return m_state && m_state->ready.load(std::memory_order_acquire); }
+
+    // empty while the pipeline is still compiling, so draw code can skip or fall back.
+    VKHPipeline get() const { return is_ready() ? m_state->pipeline : VKHPipeline {}; }
+
+    VKHPipeline get_or(VKHPipeline fallback) const { return is_ready() ? m_state->pipeline : fallback; }
+
+    VKHPipeline wait() const;
+
+private:
+    friend class VKHPipelineRegistry;
+    friend class VKHGraphicsPipelineBuilder;
+    friend class VKHComputePipelineBuilder;
+
+    struct State {
+        std::mutex mutex;
+        std::condition_variable condition;
+        std::atomic<bool> ready { false };
+        VKHPipeline pipeline;
+    };
+
+    explicit VKHPipelineFuture(std::shared_ptr<State> state)
+        : m_state(std::move(state))
+    {
+    }
+
+    void fulfill(VKHPipeline pipeline) const;
+
+private:
+    std::shared_ptr<State> m_state;
+};
+
+class VKHPipelineRegistry {
+    MAKE_NON_COPYABLE(VKHPipelineRegistry);
+    MAKE_NON_MOVABLE(VKHPipelineRegistry);
+
+public:
+    VKHPipelineRegistry() = default;
+
+    // async builds run as jobs, or inline when jobs is null.
+    void init(VkDevice device, VKHPipelineCache* cache, JobSubsystem* jobs);
+
+    // waits for pending compiles, then destroys every pipeline and layout handed out. the device must be idle.
+    void deinit();
+
+    void wait_idle();
+
+    // layouts are shared between every pipeline with the same descriptor set layouts and push constant ranges.
+    VkPipelineLayout get_pipeline_layout(
+        std::span<VkDescriptorSetLayout const> set_layouts,
+        std::span<VkPushConstantRange const> push_constant_ranges);
+
+    VkDevice get_device() const { return m_device; }
+
+    VKHPipelineCache* get_cache() const { return m_cache; }
+
+    size_t get_pipeline_count() const;
+
+    size_t get_layout_count() const;
+
+    uint64_t get_hit_count() const { return m_hit_count.load(std::memory_order_relaxed); }
+
+private:
+    friend class VKHGraphicsPipelineBuilder;
+    friend class VKHComputePipelineBuilder;
+
+    // returns the future already registered for key, or registers a pending one and sets created.
+    VKHPipelineFuture find_or_reserve(std::string key, bool& created);
+
+private:
+    VkDevice m_device { nullptr };
+    VKHPipelineCache* m_cache { nullptr };
+    JobSubsystem* m_jobs { nullptr };
+
+    mutable std::mutex m_mutex;
+    std::unordered_map<std::string, VKHPipelineFuture> m_pipelines;
+    std::unordered_map<std::string, VkPipelineLayout> m_layouts;
+    std::atomic<uint64_t> m_hit_count { 0 };
+};
+
 class VKHGraphicsPipelineBuilder {
 public:
-    explicit VKHGraphicsPipelineBuilder(VkDevice device);
+    explicit VKHGraphicsPipelineBuilder(VKHPipelineRegistry* registry);
 
     VKHGraphicsPipelineBuilder& set_rendering_format(
         VkFormat color_format,
@@ -58,9 +223,9 @@ public:
         VkFormat stencil_format = VK_FORMAT_UNDEFINED);
 
     VKHGraphicsPipelineBuilder& set_vertex_and_fragment(
-        VkShaderModule vertex,
+        VKHShaderModule const& vertex,
         char const* vertex_entry_point,
-        VkShaderModule fragment,
+        VKHShaderModule const& fragment,
         char const* fragment_entry_point);
 
     VKHGraphicsPipelineBuilder& set_vertex_layout(VKHVertexLayout layout);
@@ -80,6 +245,13 @@ public:
 
     VKHGraphicsPipelineBuilder& enable_color_blending();
 
+    VKHGraphicsPipelineBuilder& add_descriptor_set_layout(VkDescriptorSetLayout set_layout);
+
+    VKHGraphicsPipelineBuilder& add_push_constant_range(VkShaderStageFlags stages, uint32_t offset, uint32_t size);
+
+    // the bindless set at set 0 and its push constant range, must come before any other set layout.
+    VKHGraphicsPipelineBuilder& use_bindless(VKHBindlessDescriptors const& bindless);
+
     template<typename... Args>
     requires(std::is_same_v<Args, VkDynamicState> && ...)
     VKHGraphicsPipelineBuilder& set_dynamic_states(Args&&... args)
@@ -96,9 +268,19 @@ public:
         return *this;
     }
 
-    VkPipeline build();
+    // returns the registry's pipeline when an identical one was already built, the registry owns the handles.
+    VKHPipeline build();
+
+    // compiles on the registry's thread pool, the shader modules must stay alive until the future is ready.
+    VKHPipelineFuture build_async();
 
 private:
+    bool prepare();
+
+    void fixup_pointers();
+
+    VKHPipeline compile();
+
     void set_standard_viewport();
 
     void set_standard_rasterization();
@@ -109,10 +291,10 @@ private:
 
     void set_standard_color_blending();
 
-    void set_standard_pipeline_layout();
+    std::string make_key() const;
 
 private:
-    VkDevice m_device { nullptr };
+    VKHPipelineRegistry* m_registry { nullptr };
 
     VkFormat m_color_format;
     VkFormat m_depth_format;
@@ -121,6 +303,7 @@ private:
     bool m_pipeline_rendering_info_done { false };
 
     VkPipelineShaderStageCreateInfo m_stages[VKH_SHADER_STAGE_COUNT] {};
+    uint64_t m_stage_code_hashes[VKH_SHADER_STAGE_COUNT] {};
     bool m_shader_stage_done { false };
 
     VkPipelineVertexInputStateCreateInfo m_vertex_input_state {};
@@ -148,5 +331,42 @@ private:
     VkPipelineDynamicStateCreateInfo m_dynamic_state {};
     std::vector<VkDynamicState> m_dynamic_states;
 
-    VkPipelineLayout m_pipeline_layout {};
+    std::vector<VkDescriptorSetLayout> m_set_layouts;
+    std::vector<VkPushConstantRange> m_push_constant_ranges;
+};
+
+class VKHComputePipelineBuilder {
+public:
+    explicit VKHComputePipelineBuilder(VKHPipelineRegistry* registry);
+
+    VKHComputePipelineBuilder& set_shader(VKHShaderModule const& module, char const* entry_point);
+
+    VKHComputePipelineBuilder& add_descriptor_set_layout(VkDescriptorSetLayout set_layout);
+
+    VKHComputePipelineBuilder& add_push_constant_range(VkShaderStageFlags stages, uint32_t offset, uint32_t size);
+
+    // the bindless set at set 0 and its push constant range, must come before any other set layout.
+    VKHComputePipelineBuilder& use_bindless(VKHBindlessDescriptors const& bindless);
+
+    // returns the registry's pipeline when an identical one was already built, the registry owns the handles.
+    VKHPipeline build();
+
+    // compiles on the registry's thread pool, the shader module must stay alive until the future is ready.
+    VKHPipelineFuture build_async();
+
+private:
+    bool prepare() const;
+
+    VKHPipeline compile() const;
+
+    std::string make_key() const;
+
+private:
+    VKHPipelineRegistry* m_registry { nullptr };
+
+    VKHShaderModule m_module {};
+    char const* m_entry_point { nullptr };
+
+    std::vector<VkDescriptorSetLayout> m_set_layouts;
+    std::vector<VkPushConstantRange> m_push_constant_ranges;
 };